@@ -1166,6 +1166,11 @@ static int rx_macro_digital_mute(struct snd_soc_dai *dai, int mute)
 	if (!rx_macro_get_data(component, &rx_dev, &rx_priv, __func__))
 		return -EINVAL;
 
+	/* use case is set up, apply any port connects still held back */
+	if (rx_priv->swr_ctrl_data)
+		swrm_wcd_notify(rx_priv->swr_ctrl_data[0].rx_swr_pdev,
+				SWR_PORT_CFG_COMMIT, NULL);
+
 	switch (dai->id) {
 	case RX_MACRO_AIF1_PB:
 	case RX_MACRO_AIF2_PB:
@@ -60,6 +60,8 @@ static int tx_macro_hw_params(struct snd_pcm_substream *substream,
 static int tx_macro_get_channel_map(struct snd_soc_dai *dai,
 				unsigned int *tx_num, unsigned int *tx_slot,
 				unsigned int *rx_num, unsigned int *rx_slot);
+static int tx_macro_mute_stream(struct snd_soc_dai *dai, int mute,
+				int stream);
 
 #define TX_MACRO_SWR_STRING_LEN 80
 #define TX_MACRO_CHILD_DEVICES_MAX 3
@@ -1166,9 +1168,33 @@ static int tx_macro_get_channel_map(struct snd_soc_dai *dai,
 	return 0;
 }
 
+/*
+ * Capture has no digital mute, so the unmute at the end of prepare is
+ * where the use case is set up and held back port connects are applied.
+ */
+static int tx_macro_mute_stream(struct snd_soc_dai *dai, int mute,
+				int stream)
+{
+	struct snd_soc_component *component = dai->component;
+	struct device *tx_dev = NULL;
+	struct tx_macro_priv *tx_priv = NULL;
+
+	if (mute || stream != SNDRV_PCM_STREAM_CAPTURE)
+		return 0;
+
+	if (!tx_macro_get_data(component, &tx_dev, &tx_priv, __func__))
+		return -EINVAL;
+
+	if (tx_priv->swr_ctrl_data)
+		swrm_wcd_notify(tx_priv->swr_ctrl_data[0].tx_swr_pdev,
+				SWR_PORT_CFG_COMMIT, NULL);
+	return 0;
+}
+
 static struct snd_soc_dai_ops tx_macro_dai_ops = {
 	.hw_params = tx_macro_hw_params,
 	.get_channel_map = tx_macro_get_channel_map,
+	.mute_stream = tx_macro_mute_stream,
 };
 
 static struct snd_soc_dai_driver tx_macro_dai[] = {
@@ -1566,9 +1566,33 @@ static int va_macro_get_channel_map(struct snd_soc_dai *dai,
 	return 0;
 }
 
+/*
+ * Capture has no digital mute, so the unmute at the end of prepare is
+ * where the use case is set up and held back port connects are applied.
+ */
+static int va_macro_mute_stream(struct snd_soc_dai *dai, int mute,
+				int stream)
+{
+	struct snd_soc_component *component = dai->component;
+	struct device *va_dev = NULL;
+	struct va_macro_priv *va_priv = NULL;
+
+	if (mute || stream != SNDRV_PCM_STREAM_CAPTURE)
+		return 0;
+
+	if (!va_macro_get_data(component, &va_dev, &va_priv, __func__))
+		return -EINVAL;
+
+	if (va_priv->swr_ctrl_data)
+		swrm_wcd_notify(va_priv->swr_ctrl_data[0].va_swr_pdev,
+				SWR_PORT_CFG_COMMIT, NULL);
+	return 0;
+}
+
 static struct snd_soc_dai_ops va_macro_dai_ops = {
 	.hw_params = va_macro_hw_params,
 	.get_channel_map = va_macro_get_channel_map,
+	.mute_stream = va_macro_mute_stream,
 };
 
 static struct snd_soc_dai_driver va_macro_dai[] = {
@@ -853,6 +853,11 @@ static int wsa_macro_digital_mute(struct snd_soc_dai *dai, int mute)
 	if (!wsa_macro_get_data(component, &wsa_dev, &wsa_priv, __func__))
 		return -EINVAL;
 
+	/* use case is set up, apply any port connects still held back */
+	if (wsa_priv->swr_ctrl_data)
+		swrm_wcd_notify(wsa_priv->swr_ctrl_data[0].wsa_swr_pdev,
+				SWR_PORT_CFG_COMMIT, NULL);
+
 	switch (dai->id) {
 	case WSA_MACRO_AIF1_PB:
 	case WSA_MACRO_AIF_MIX1_PB:
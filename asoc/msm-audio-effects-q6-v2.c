@@ -128,7 +128,7 @@ int msm_audio_effects_virtualizer_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -270,7 +270,7 @@ int msm_audio_effects_virtualizer_handler(struct audio_client *ac,
 	else
 		pr_debug("%s: did not send pp params\n", __func__);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	return rc;
 }
 EXPORT_SYMBOL(msm_audio_effects_virtualizer_handler);
@@ -307,7 +307,7 @@ int msm_audio_effects_reverb_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -705,7 +705,7 @@ int msm_audio_effects_reverb_handler(struct audio_client *ac,
 	else
 		pr_debug("%s: did not send pp params\n", __func__);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	return rc;
 }
 EXPORT_SYMBOL(msm_audio_effects_reverb_handler);
@@ -742,7 +742,7 @@ int msm_audio_effects_bass_boost_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -859,7 +859,7 @@ int msm_audio_effects_bass_boost_handler(struct audio_client *ac,
 	else
 		pr_debug("%s: did not send pp params\n", __func__);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	return rc;
 }
 EXPORT_SYMBOL(msm_audio_effects_bass_boost_handler);
@@ -899,7 +899,7 @@ int msm_audio_effects_pbe_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -1049,7 +1049,7 @@ int msm_audio_effects_pbe_handler(struct audio_client *ac,
 	if (params_length && (rc == 0))
 		q6asm_set_pp_params(ac, NULL, params, params_length);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	return rc;
 }
 EXPORT_SYMBOL(msm_audio_effects_pbe_handler);
@@ -1089,7 +1089,7 @@ int msm_audio_effects_popless_eq_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -1310,7 +1310,7 @@ int msm_audio_effects_popless_eq_handler(struct audio_client *ac,
 	else
 		pr_debug("%s: did not send pp params\n", __func__);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	kfree(eq_config_data);
 	return rc;
 }
@@ -1347,7 +1347,7 @@ static int __msm_audio_effects_volume_handler(struct audio_client *ac,
 		pr_err("%s: cannot set audio effects\n", __func__);
 		return -EINVAL;
 	}
-	params = kzalloc(MAX_INBAND_PARAM_SZ, GFP_KERNEL);
+	params = q6common_pkt_alloc(MAX_INBAND_PARAM_SZ);
 	if (!params) {
 		pr_err("%s, params memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -1450,7 +1450,7 @@ static int __msm_audio_effects_volume_handler(struct audio_client *ac,
 	if (params_length && (rc == 0))
 		q6asm_set_pp_params(ac, NULL, params, params_length);
 invalid_config:
-	kfree(params);
+	q6common_pkt_free(params);
 	return rc;
 }
 
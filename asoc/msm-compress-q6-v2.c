@@ -13,6 +13,7 @@
 #include <linux/mutex.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
 #include <sound/core.h>
 #include <sound/soc.h>
 #include <sound/soc-dapm.h>
@@ -65,6 +66,24 @@
 #define COMPR_PLAYBACK_MAX_NUM_FRAGMENTS (16 * 4)
 
 #define COMPRESSED_LR_VOL_MAX_STEPS	0x2000
+
+/*
+ * Upper bound on fragments merged into one ASM write. 0 or 1 keeps the
+ * one write per fragment behaviour.
+ */
+static unsigned int compr_write_coalesce_max;
+module_param(compr_write_coalesce_max, uint, 0664);
+MODULE_PARM_DESC(compr_write_coalesce_max,
+		 "Max playback fragments merged into one DSP write");
+
+struct msm_compr_write_stats {
+	atomic64_t single;
+	atomic64_t coalesced;
+	atomic64_t coalesced_frags;
+};
+
+static struct msm_compr_write_stats compr_write_stats;
+static struct dentry *debugfs_compr_write_stats;
 const DECLARE_TLV_DB_LINEAR(msm_compr_vol_gain, 0,
 				COMPRESSED_LR_VOL_MAX_STEPS);
 
@@ -473,6 +492,31 @@ static int msm_compr_send_ddp_cfg(struct audio_client *ac,
 	return 0;
 }
 
+/*
+ * Number of fragments to send in the next write. Fragments are merged
+ * only while at least twice as many are ready, so that the DSP keeps
+ * running on one write while userspace refills the rest; closer to an
+ * underrun every fragment goes out on its own.
+ */
+static uint32_t msm_compr_write_coalesce_frags(struct msm_compr_audio *prtd,
+					       uint64_t bytes_available)
+{
+	uint32_t frag_size = prtd->codec_param.buffer.fragment_size;
+	uint64_t nr_frags;
+
+	/* Timestamps are per fragment and drain marks a single last one */
+	if (compr_write_coalesce_max <= 1 || prtd->ts_header_offset ||
+	    prtd->last_buffer || atomic_read(&prtd->drain))
+		return 1;
+
+	nr_frags = div_u64(bytes_available, frag_size) / 2;
+	nr_frags = min_t(uint64_t, nr_frags, compr_write_coalesce_max);
+	/* The caller still trims the write at the buffer wrap point */
+	nr_frags = min_t(uint64_t, nr_frags, prtd->buffer_size / frag_size);
+
+	return nr_frags > 1 ? nr_frags : 1;
+}
+
 static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 {
 	int buffer_length;
@@ -504,6 +548,9 @@ static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 	bytes_available = prtd->bytes_received - prtd->copied_total;
 	if (bytes_available < prtd->codec_param.buffer.fragment_size)
 		buffer_length = bytes_available;
+	else
+		buffer_length *= msm_compr_write_coalesce_frags(prtd,
+							bytes_available);
 
 	if (prtd->byte_offset + buffer_length > prtd->buffer_size) {
 		buffer_length = (prtd->buffer_size - prtd->byte_offset);
@@ -543,6 +590,14 @@ static int msm_compr_send_buffer(struct msm_compr_audio *prtd)
 	if (q6asm_async_write(prtd->audio_client, &param) < 0) {
 		pr_err("%s:q6asm_async_write failed\n", __func__);
 	} else {
+		if (buffer_length > prtd->codec_param.buffer.fragment_size) {
+			atomic64_inc(&compr_write_stats.coalesced);
+			atomic64_add(DIV_ROUND_UP(buffer_length,
+				prtd->codec_param.buffer.fragment_size),
+				&compr_write_stats.coalesced_frags);
+		} else {
+			atomic64_inc(&compr_write_stats.single);
+		}
 		prtd->bytes_sent += buffer_length;
 		if (prtd->first_buffer)
 			prtd->first_buffer = 0;
@@ -5593,14 +5648,51 @@ static struct platform_driver msm_compr_driver = {
 	.remove = msm_compr_remove,
 };
 
+static ssize_t msm_compr_write_stats_read(struct file *filp,
+					  char __user *ubuf,
+					  size_t cnt, loff_t *ppos)
+{
+	char buf[128];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf),
+			"single %lld\ncoalesced %lld\ncoalesced_frags %lld\n",
+			atomic64_read(&compr_write_stats.single),
+			atomic64_read(&compr_write_stats.coalesced),
+			atomic64_read(&compr_write_stats.coalesced_frags));
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t msm_compr_write_stats_write(struct file *filp,
+					   const char __user *ubuf,
+					   size_t cnt, loff_t *ppos)
+{
+	atomic64_set(&compr_write_stats.single, 0);
+	atomic64_set(&compr_write_stats.coalesced, 0);
+	atomic64_set(&compr_write_stats.coalesced_frags, 0);
+
+	return cnt;
+}
+
+static const struct file_operations msm_compr_write_stats_ops = {
+	.read = msm_compr_write_stats_read,
+	.write = msm_compr_write_stats_write,
+};
+
 int __init msm_compress_dsp_init(void)
 {
+	debugfs_compr_write_stats = debugfs_create_file(
+				"msm_compr_write_stats", 0644, NULL, NULL,
+				&msm_compr_write_stats_ops);
+
 	return platform_driver_register(&msm_compr_driver);
 }
 
 void msm_compress_dsp_exit(void)
 {
 	platform_driver_unregister(&msm_compr_driver);
+	debugfs_remove(debugfs_compr_write_stats);
 }
 
 MODULE_DESCRIPTION("Compress Offload platform driver");
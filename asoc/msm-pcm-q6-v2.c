@@ -258,7 +258,7 @@ static void event_handler(uint32_t opcode,
 	case APR_BASIC_RSP_RESULT: {
 		switch (payload[0]) {
 		case ASM_SESSION_CMD_RUN_V2:
-			if (substream->stream
+			if (prtd->shared_io || substream->stream
 				!= SNDRV_PCM_STREAM_PLAYBACK) {
 				atomic_set(&prtd->start, 1);
 				break;
@@ -313,6 +313,249 @@ static void event_handler(uint32_t opcode,
 	}
 }
 
+static enum hrtimer_restart msm_pcm_shared_io_hrtimer_cb(struct hrtimer *hrt)
+{
+	struct msm_audio *prtd = container_of(hrt, struct msm_audio, hrt);
+
+	if (!atomic_read(&prtd->start))
+		return HRTIMER_NORESTART;
+
+	snd_pcm_period_elapsed(prtd->substream);
+	hrtimer_forward_now(hrt, ns_to_ktime(prtd->period_ns));
+
+	return HRTIMER_RESTART;
+}
+
+static int msm_pcm_shared_io_hw_params(struct snd_pcm_substream *substream,
+				       struct snd_pcm_hw_params *params)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_soc_pcm_runtime *soc_prtd = substream->private_data;
+	struct snd_soc_component *component =
+			snd_soc_rtdcom_lookup(soc_prtd, DRV_NAME);
+	struct msm_audio *prtd = runtime->private_data;
+	struct snd_dma_buffer *dma_buf = &substream->dma_buffer;
+	struct msm_plat_data *pdata;
+	struct msm_pcm_routing_evt event;
+	struct shared_io_config config;
+	struct audio_buffer *buf;
+	int dir = (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) ? IN : OUT;
+	int ret;
+
+	if (!component) {
+		pr_err("%s: component is NULL\n", __func__);
+		return -EINVAL;
+	}
+
+	pdata = (struct msm_plat_data *)
+		dev_get_drvdata(component->dev);
+	if (!pdata) {
+		pr_err("%s: platform data not populated\n", __func__);
+		return -EINVAL;
+	}
+	if (!prtd || !prtd->audio_client) {
+		pr_err("%s: private data null or audio client freed\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	if (prtd->enabled != IDLE)
+		return 0;
+
+	switch (params_format(params)) {
+	case SNDRV_PCM_FORMAT_S24_LE:
+		config.bits_per_sample = 24;
+		config.sample_word_size = 32;
+		break;
+	case SNDRV_PCM_FORMAT_S24_3LE:
+		config.bits_per_sample = 24;
+		config.sample_word_size = 24;
+		break;
+	case SNDRV_PCM_FORMAT_S16_LE:
+		config.bits_per_sample = 16;
+		config.sample_word_size = 16;
+		break;
+	default:
+		pr_err("%s: format %d not supported in shared IO mode\n",
+			__func__, params_format(params));
+		return -EINVAL;
+	}
+
+	/* push mode does not support ULL */
+	prtd->audio_client->perf_mode = (dir == IN) ? pdata->perf_mode :
+					LOW_LATENCY_PCM_MODE;
+
+	config.format = FORMAT_LINEAR_PCM;
+	config.rate = params_rate(params);
+	config.channels = params_channels(params);
+	config.bufsz = params_period_bytes(params);
+	config.bufcnt = params_periods(params);
+
+	ret = q6asm_open_shared_io(prtd->audio_client, &config, dir,
+				   !prtd->set_channel_map, prtd->channel_map);
+	if (ret) {
+		pr_err("%s: q6asm_open_shared_io failed ret: %d\n",
+		       __func__, ret);
+		return ret;
+	}
+
+	buf = q6asm_shared_io_buf(prtd->audio_client, dir);
+	if (buf == NULL || buf->data == NULL)
+		return -ENOMEM;
+
+	dma_buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	dma_buf->dev.dev = substream->pcm->card->dev;
+	dma_buf->private_data = NULL;
+	dma_buf->area = buf->data;
+	dma_buf->addr = buf->phys;
+	dma_buf->bytes = params_buffer_bytes(params);
+	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
+
+	pr_debug("%s: session ID %d, perf %d\n", __func__,
+		 prtd->audio_client->session, prtd->audio_client->perf_mode);
+	prtd->session_id = prtd->audio_client->session;
+
+	if (dir == IN) {
+		ret = msm_pcm_routing_reg_phy_stream(soc_prtd->dai_link->id,
+				prtd->audio_client->perf_mode,
+				prtd->session_id, substream->stream);
+	} else {
+		event.event_func = msm_pcm_route_event_handler;
+		event.priv_data = (void *) prtd;
+		ret = msm_pcm_routing_reg_phy_stream_v2(
+				soc_prtd->dai_link->id,
+				prtd->audio_client->perf_mode,
+				prtd->session_id, substream->stream,
+				event);
+	}
+	if (ret) {
+		pr_err("%s: stream reg failed ret:%d\n", __func__, ret);
+		return ret;
+	}
+
+	prtd->pcm_size = params_buffer_bytes(params);
+	prtd->pcm_count = params_period_bytes(params);
+	prtd->pcm_irq_pos = 0;
+	prtd->samp_rate = params_rate(params);
+	prtd->channel_mode = params_channels(params);
+	prtd->period_ns = div_u64((u64)params_period_size(params) *
+				  NSEC_PER_SEC, params_rate(params));
+	prtd->enabled = RUNNING;
+
+	return 0;
+}
+
+static int msm_pcm_shared_io_prepare(struct snd_pcm_substream *substream)
+{
+	struct msm_audio *prtd = substream->runtime->private_data;
+
+	if (!prtd || !prtd->audio_client) {
+		pr_err("%s: private data null or audio client freed\n",
+			__func__);
+		return -EINVAL;
+	}
+
+	/* Rewind the DSP read/write index to match the reset hw_ptr */
+	if (prtd->enabled == STOPPED) {
+		q6asm_cmd(prtd->audio_client, CMD_FLUSH);
+		prtd->enabled = RUNNING;
+	}
+	prtd->pcm_irq_pos = 0;
+
+	return 0;
+}
+
+static int msm_pcm_shared_io_trigger(struct snd_pcm_substream *substream,
+				     int cmd)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct msm_audio *prtd = runtime->private_data;
+	int ret = 0;
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		pr_debug("%s: Trigger start\n", __func__);
+		ret = q6asm_run_nowait(prtd->audio_client, 0, 0, 0);
+		if (ret)
+			break;
+		atomic_set(&prtd->start, 1);
+		hrtimer_start(&prtd->hrt, ns_to_ktime(prtd->period_ns),
+			      HRTIMER_MODE_REL);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+		pr_debug("%s: SNDRV_PCM_TRIGGER_STOP\n", __func__);
+		atomic_set(&prtd->start, 0);
+		hrtimer_try_to_cancel(&prtd->hrt);
+		prtd->enabled = STOPPED;
+		ret = q6asm_cmd_nowait(prtd->audio_client, CMD_PAUSE);
+		/* Don't let the DSP replay stale samples after a restart */
+		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			memset(runtime->dma_area, 0, runtime->dma_bytes);
+		break;
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		pr_debug("%s: SNDRV_PCM_TRIGGER_PAUSE\n", __func__);
+		atomic_set(&prtd->start, 0);
+		hrtimer_try_to_cancel(&prtd->hrt);
+		ret = q6asm_cmd_nowait(prtd->audio_client, CMD_PAUSE);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	return ret;
+}
+
+static snd_pcm_uframes_t msm_pcm_shared_io_pointer(
+				struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct msm_audio *prtd = runtime->private_data;
+	uint32_t read_index, wall_clk_msw, wall_clk_lsw;
+	int retries = 10;
+	int ret;
+
+	do {
+		ret = q6asm_get_shared_pos(prtd->audio_client,
+					   &read_index, &wall_clk_msw,
+					   &wall_clk_lsw);
+	} while (ret == -EAGAIN && --retries);
+
+	/* On a torn read keep reporting the last good position */
+	if (!ret && read_index < prtd->pcm_size)
+		prtd->pcm_irq_pos = read_index;
+
+	return bytes_to_frames(runtime, prtd->pcm_irq_pos);
+}
+
+static int msm_pcm_shared_io_copy(struct snd_pcm_substream *substream,
+	unsigned long hwoff, void __user *buf, unsigned long fbytes)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct msm_audio *prtd = runtime->private_data;
+	char *hwbuf = runtime->dma_area + hwoff;
+
+	if (prtd->reset_event) {
+		pr_err("%s: In SSR return ENETRESET\n", __func__);
+		return -ENETRESET;
+	}
+
+	if (hwoff + fbytes > runtime->dma_bytes)
+		return -EINVAL;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		if (copy_from_user(hwbuf, buf, fbytes))
+			return -EFAULT;
+	} else if (copy_to_user(buf, hwbuf, fbytes)) {
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
@@ -322,6 +565,7 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 	struct msm_audio *prtd = runtime->private_data;
 	struct msm_plat_data *pdata;
 	struct snd_pcm_hw_params *params;
+	struct q6asm_write_setup setup;
 	int ret;
 	uint32_t fmt_type = FORMAT_LINEAR_PCM;
 	uint16_t bits_per_sample;
@@ -389,15 +633,24 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 			prtd->audio_client = NULL;
 			return -ENOMEM;
 		}
-	} else {
-		if ((q6core_get_avcs_api_version_per_service(
+	} else if ((q6core_get_avcs_api_version_per_service(
 				APRV2_IDS_SERVICE_ID_ADSP_ASM_V) >=
-				ADSP_ASM_API_VERSION_V2))
-			ret = q6asm_open_write_v5(prtd->audio_client,
-				fmt_type, bits_per_sample);
-		else
-			ret = q6asm_open_write_v4(prtd->audio_client,
-				fmt_type, bits_per_sample);
+				ADSP_ASM_API_VERSION_V2)) {
+		/* open and stream cal in one round trip */
+		memset(&setup, 0, sizeof(setup));
+		setup.bits_per_sample = bits_per_sample;
+		setup.send_cal = true;
+		ret = q6asm_open_write_batch(prtd->audio_client, &setup);
+		if (ret < 0) {
+			pr_err("%s: q6asm_open_write failed (%d)\n",
+			__func__, ret);
+			q6asm_audio_client_free(prtd->audio_client);
+			prtd->audio_client = NULL;
+			return -ENOMEM;
+		}
+	} else {
+		ret = q6asm_open_write_v4(prtd->audio_client,
+			fmt_type, bits_per_sample);
 
 		if (ret < 0) {
 			pr_err("%s: q6asm_open_write failed (%d)\n",
@@ -633,6 +886,9 @@ static int msm_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct msm_audio *prtd = runtime->private_data;
 
+	if (prtd->shared_io)
+		return msm_pcm_shared_io_trigger(substream, cmd);
+
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
@@ -774,6 +1030,11 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 	prtd->dsp_cnt = 0;
 	prtd->set_channel_map = false;
 	prtd->reset_event = false;
+	prtd->shared_io = pdata->shared_io;
+	if (prtd->shared_io) {
+		hrtimer_init(&prtd->hrt, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		prtd->hrt.function = msm_pcm_shared_io_hrtimer_cb;
+	}
 	runtime->private_data = prtd;
 
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
@@ -940,9 +1201,14 @@ static int msm_pcm_playback_close(struct snd_pcm_substream *substream)
 		if (!ret)
 			pr_err("%s: CMD_EOS failed, cmd_pending 0x%lx\n",
 			       __func__, prtd->cmd_pending);
+		if (prtd->shared_io)
+			hrtimer_cancel(&prtd->hrt);
 		q6asm_cmd(prtd->audio_client, CMD_CLOSE);
-		q6asm_audio_client_buf_free_contiguous(dir,
-					prtd->audio_client);
+		if (prtd->shared_io)
+			q6asm_shared_io_free(prtd->audio_client, dir);
+		else
+			q6asm_audio_client_buf_free_contiguous(dir,
+						prtd->audio_client);
 		q6asm_audio_client_free(prtd->audio_client);
 	}
 	msm_pcm_routing_dereg_phy_stream(soc_prtd->dai_link->id,
@@ -1062,9 +1328,14 @@ static int msm_pcm_capture_close(struct snd_pcm_substream *substream)
 
 	mutex_lock(&pdata->lock);
 	if (prtd->audio_client) {
+		if (prtd->shared_io)
+			hrtimer_cancel(&prtd->hrt);
 		q6asm_cmd(prtd->audio_client, CMD_CLOSE);
-		q6asm_audio_client_buf_free_contiguous(dir,
-				prtd->audio_client);
+		if (prtd->shared_io)
+			q6asm_shared_io_free(prtd->audio_client, dir);
+		else
+			q6asm_audio_client_buf_free_contiguous(dir,
+					prtd->audio_client);
 		q6asm_audio_client_free(prtd->audio_client);
 	}
 
@@ -1079,8 +1350,12 @@ static int msm_pcm_capture_close(struct snd_pcm_substream *substream)
 static int msm_pcm_copy(struct snd_pcm_substream *substream, int a,
 	 unsigned long hwoff, void __user *buf, unsigned long fbytes)
 {
+	struct msm_audio *prtd = substream->runtime->private_data;
 	int ret = 0;
 
+	if (prtd->shared_io)
+		return msm_pcm_shared_io_copy(substream, hwoff, buf, fbytes);
+
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 		ret = msm_pcm_playback_copy(substream, a, hwoff, buf, fbytes);
 	else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
@@ -1101,8 +1376,12 @@ static int msm_pcm_close(struct snd_pcm_substream *substream)
 
 static int msm_pcm_prepare(struct snd_pcm_substream *substream)
 {
+	struct msm_audio *prtd = substream->runtime->private_data;
 	int ret = 0;
 
+	if (prtd && prtd->shared_io)
+		return msm_pcm_shared_io_prepare(substream);
+
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 		ret = msm_pcm_playback_prepare(substream);
 	else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
@@ -1116,6 +1395,9 @@ static snd_pcm_uframes_t msm_pcm_pointer(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct msm_audio *prtd = runtime->private_data;
 
+	if (prtd->shared_io)
+		return msm_pcm_shared_io_pointer(substream);
+
 	if (prtd->pcm_irq_pos >= prtd->pcm_size)
 		prtd->pcm_irq_pos = 0;
 
@@ -1153,6 +1435,9 @@ static int msm_pcm_hw_params(struct snd_pcm_substream *substream,
 	struct audio_buffer *buf;
 	int dir, ret;
 
+	if (prtd->shared_io)
+		return msm_pcm_shared_io_hw_params(substream, params);
+
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 		dir = IN;
 	else
@@ -2868,6 +3153,16 @@ static int msm_pcm_probe(struct platform_device *pdev)
 	} else {
 		pdata->perf_mode = LEGACY_PCM_MODE;
 	}
+
+	if (of_property_read_bool(pdev->dev.of_node,
+				"qcom,msm-pcm-shared-io")) {
+		/* Pull/push mode sessions are low latency only */
+		if (pdata->perf_mode == LEGACY_PCM_MODE)
+			dev_err(&pdev->dev, "%s: shared IO needs a low latency device, ignoring\n",
+				__func__);
+		else
+			pdata->shared_io = true;
+	}
 	mutex_init(&pdata->lock);
 	dev_set_drvdata(&pdev->dev, pdata);
 
@@ -7,6 +7,7 @@
 
 #ifndef _MSM_PCM_H
 #define _MSM_PCM_H
+#include <linux/hrtimer.h>
 #include <dsp/apr_audio-v2.h>
 #include <dsp/q6asm-v2.h>
 #include "msm-pcm-routing-v2.h"
@@ -99,6 +100,14 @@ struct msm_audio {
 	bool meta_data_mode;
 	uint32_t volume;
 	bool compress_enable;
+	/*
+	 * In shared IO mode the ALSA buffer is the DSP circular buffer.
+	 * Positions are read from the shared position buffer and period
+	 * wakeups come from hrt instead of per-period write/read done events.
+	 */
+	bool shared_io;
+	struct hrtimer hrt;
+	u64 period_ns;
 	/* array of frame info */
 	struct msm_audio_in_frame_info in_frame_info[CAPTURE_MAX_NUM_PERIODS];
 };
@@ -113,6 +122,7 @@ struct output_meta_data_st {
 
 struct msm_plat_data {
 	int perf_mode;
+	bool shared_io;
 	struct snd_pcm *pcm;
 	struct msm_pcm_ch_map *ch_map[MSM_FRONTEND_DAI_MAX];
 	struct snd_pcm *pcm_device[MSM_FRONTEND_DAI_MM_SIZE];
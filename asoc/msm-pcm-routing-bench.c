@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* Copyright (c) 2019 The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Routing control plane benchmark. Built only with the loopback APR
+ * transport, which answers the ADM, ASM, AFE and voice commands the
+ * scenarios below cost. Each scenario is run from the
+ * msm_routing_bench debugfs file:
+ *
+ *   echo "switch <iterations>" > msm_routing_bench
+ *   echo "streams <iterations> <streams>" > msm_routing_bench
+ *   echo "voice <iterations>" > msm_routing_bench
+ *   cat msm_routing_bench
+ *
+ * and reports the wall time, ADM commands and routing lock hold time of
+ * its last run. Loopback latency and jitter are set through the
+ * lb_latency_us and lb_jitter_us parameters of the APR module.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <sound/pcm.h>
+#include <dsp/q6adm-v2.h>
+#include "msm-pcm-routing-v2.h"
+#include "platform_init.h"
+
+#define BENCH_RX_BE_A MSM_BACKEND_DAI_PRI_MI2S_RX
+#define BENCH_RX_BE_B MSM_BACKEND_DAI_SECONDARY_MI2S_RX
+#define BENCH_TX_BE MSM_BACKEND_DAI_PRI_MI2S_TX
+#define BENCH_VOICE_FE MSM_FRONTEND_DAI_VOICEMMODE1
+#define BENCH_RATE 48000
+#define BENCH_CHANNELS 2
+/* MultiMedia1 to MultiMedia8 */
+#define BENCH_STREAMS_MAX 8
+#define BENCH_ITERATIONS_MAX 10000
+#define BENCH_BUF_SIZE 512
+
+enum {
+	BENCH_DEVICE_SWITCH,
+	BENCH_CONCURRENT_STREAMS,
+	BENCH_VOICE_CALL,
+	BENCH_MAX,
+};
+
+struct msm_routing_bench_result {
+	u32 iterations;
+	u32 streams;
+	u32 errors;
+	u64 wall_ns;
+	u64 adm_cmds;
+	u64 lock_hold_ns;
+};
+
+static const char * const bench_names[BENCH_MAX] = {
+	"switch", "streams", "voice",
+};
+static struct msm_routing_bench_result bench_results[BENCH_MAX];
+/* one scenario at a time, they share the BEs and FEs below */
+static DEFINE_MUTEX(bench_lock);
+static struct dentry *debugfs_routing_bench;
+
+static int msm_routing_bench_be_up(int be_id, int stream)
+{
+	return msm_routing_bench_be_start(be_id, stream, BENCH_RATE,
+					  BENCH_CHANNELS,
+					  SNDRV_PCM_FORMAT_S16_LE);
+}
+
+static int msm_routing_bench_stream_up(int fe_id, int be_id, int session)
+{
+	msm_routing_bench_route(be_id, fe_id, true);
+	return msm_pcm_routing_reg_phy_stream(fe_id, LEGACY_PCM_MODE, session,
+					      SNDRV_PCM_STREAM_PLAYBACK);
+}
+
+static void msm_routing_bench_stream_down(int fe_id, int be_id)
+{
+	msm_pcm_routing_dereg_phy_stream(fe_id, SNDRV_PCM_STREAM_PLAYBACK);
+	msm_routing_bench_route(be_id, fe_id, false);
+}
+
+/*
+ * One playback stream moved back and forth between two RX devices: the
+ * new device is routed and started before the old one is torn down.
+ */
+static int msm_routing_bench_switch(int iterations, int streams,
+				    struct msm_routing_bench_result *res)
+{
+	int fe_id = MSM_FRONTEND_DAI_MULTIMEDIA1;
+	int cur = BENCH_RX_BE_A, next = BENCH_RX_BE_B;
+	int i, errors = 0;
+	ktime_t start;
+
+	if (msm_routing_bench_be_up(cur, SNDRV_PCM_STREAM_PLAYBACK) ||
+	    msm_routing_bench_stream_up(fe_id, cur, 1))
+		errors++;
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		msm_routing_bench_route(next, fe_id, true);
+		if (msm_routing_bench_be_up(next, SNDRV_PCM_STREAM_PLAYBACK))
+			errors++;
+		msm_routing_bench_route(cur, fe_id, false);
+		if (msm_routing_bench_be_stop(cur, SNDRV_PCM_STREAM_PLAYBACK))
+			errors++;
+		swap(cur, next);
+	}
+	res->wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	msm_routing_bench_stream_down(fe_id, cur);
+	msm_routing_bench_be_stop(cur, SNDRV_PCM_STREAM_PLAYBACK);
+	return errors;
+}
+
+/* @streams playback streams started and stopped on one running device */
+static int msm_routing_bench_streams(int iterations, int streams,
+				     struct msm_routing_bench_result *res)
+{
+	int fe_id = MSM_FRONTEND_DAI_MULTIMEDIA1;
+	int i, j, errors = 0;
+	ktime_t start;
+
+	if (msm_routing_bench_be_up(BENCH_RX_BE_A, SNDRV_PCM_STREAM_PLAYBACK))
+		errors++;
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < streams; j++)
+			if (msm_routing_bench_stream_up(fe_id + j,
+							BENCH_RX_BE_A, j + 1))
+				errors++;
+		for (j = 0; j < streams; j++)
+			msm_routing_bench_stream_down(fe_id + j,
+						      BENCH_RX_BE_A);
+	}
+	res->wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	msm_routing_bench_be_stop(BENCH_RX_BE_A, SNDRV_PCM_STREAM_PLAYBACK);
+	return errors;
+}
+
+/* Voice call device setup and teardown on an RX and a TX device */
+static int msm_routing_bench_voice(int iterations, int streams,
+				   struct msm_routing_bench_result *res)
+{
+	int i, errors = 0;
+	ktime_t start;
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		msm_routing_bench_route_voice(BENCH_RX_BE_A, BENCH_VOICE_FE,
+					      true);
+		msm_routing_bench_route_voice(BENCH_TX_BE, BENCH_VOICE_FE,
+					      true);
+		if (msm_routing_bench_be_up(BENCH_RX_BE_A,
+					    SNDRV_PCM_STREAM_PLAYBACK) ||
+		    msm_routing_bench_be_up(BENCH_TX_BE,
+					    SNDRV_PCM_STREAM_CAPTURE))
+			errors++;
+		msm_routing_bench_route_voice(BENCH_TX_BE, BENCH_VOICE_FE,
+					      false);
+		msm_routing_bench_route_voice(BENCH_RX_BE_A, BENCH_VOICE_FE,
+					      false);
+		msm_routing_bench_be_stop(BENCH_TX_BE,
+					  SNDRV_PCM_STREAM_CAPTURE);
+		msm_routing_bench_be_stop(BENCH_RX_BE_A,
+					  SNDRV_PCM_STREAM_PLAYBACK);
+	}
+	res->wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return errors;
+}
+
+static int (* const bench_fns[BENCH_MAX])(int, int,
+					 struct msm_routing_bench_result *) = {
+	msm_routing_bench_switch,
+	msm_routing_bench_streams,
+	msm_routing_bench_voice,
+};
+
+static void msm_routing_bench_run(int type, int iterations, int streams)
+{
+	struct msm_routing_bench_result res;
+	u64 adm_cmds, hold_ns;
+
+	memset(&res, 0, sizeof(res));
+	res.iterations = iterations;
+	res.streams = streams;
+
+	mutex_lock(&bench_lock);
+	adm_cmds = adm_get_cmd_count();
+	hold_ns = msm_routing_bench_lock_hold_ns();
+	res.errors = bench_fns[type](iterations, streams, &res);
+	res.adm_cmds = adm_get_cmd_count() - adm_cmds;
+	/* a reset of msm_routing_lock_stats during the run loses this */
+	res.lock_hold_ns = msm_routing_bench_lock_hold_ns() - hold_ns;
+	bench_results[type] = res;
+	mutex_unlock(&bench_lock);
+
+	pr_debug("%s: %s done, %u errors\n", __func__, bench_names[type],
+		 res.errors);
+}
+
+static ssize_t msm_routing_bench_read(struct file *filp, char __user *ubuf,
+				      size_t cnt, loff_t *ppos)
+{
+	struct msm_routing_bench_result *res;
+	char buf[BENCH_BUF_SIZE];
+	int i, len = 0;
+
+	mutex_lock(&bench_lock);
+	for (i = 0; i < BENCH_MAX; i++) {
+		res = &bench_results[i];
+		len += scnprintf(buf + len, sizeof(buf) - len,
+				 "%s iterations %u streams %u errors %u wall_ns %llu adm_cmds %llu lock_hold_ns %llu\n",
+				 bench_names[i], res->iterations,
+				 res->streams, res->errors, res->wall_ns,
+				 res->adm_cmds, res->lock_hold_ns);
+	}
+	mutex_unlock(&bench_lock);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t msm_routing_bench_write(struct file *filp,
+				       const char __user *ubuf,
+				       size_t cnt, loff_t *ppos)
+{
+	char buf[32], name[16];
+	int iterations, streams = 1;
+	int i, n;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, cnt))
+		return -EFAULT;
+	buf[cnt] = '\0';
+
+	n = sscanf(buf, "%15s %d %d", name, &iterations, &streams);
+	if (n < 2 || iterations <= 0 || iterations > BENCH_ITERATIONS_MAX ||
+	    streams <= 0 || streams > BENCH_STREAMS_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < BENCH_MAX; i++)
+		if (!strcmp(name, bench_names[i]))
+			break;
+	if (i == BENCH_MAX)
+		return -EINVAL;
+
+	msm_routing_bench_run(i, iterations, streams);
+	return cnt;
+}
+
+static const struct file_operations msm_routing_bench_ops = {
+	.read = msm_routing_bench_read,
+	.write = msm_routing_bench_write,
+};
+
+int __init msm_routing_bench_init(void)
+{
+	debugfs_routing_bench = debugfs_create_file("msm_routing_bench", 0644,
+						    NULL, NULL,
+						    &msm_routing_bench_ops);
+	return 0;
+}
+
+void msm_routing_bench_exit(void)
+{
+	debugfs_remove(debugfs_routing_bench);
+}
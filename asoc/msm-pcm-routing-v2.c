@@ -9,6 +9,10 @@
 #include <linux/platform_device.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
 #include <linux/of_device.h>
 #include <linux/slab.h>
 #include <sound/core.h>
@@ -50,7 +54,311 @@
 #define DS2_ADM_COPP_TOPOLOGY_ID 0xFFFFFFFF
 #endif
 
-static struct mutex routing_lock;
+/*
+ * Routing locks, outermost first:
+ *
+ *   routing_txn_lock
+ *   routing_lock
+ *   fe_dai_lock[fedai_id]
+ *   be_dai_lock[be_id]
+ *   q6adm port, command and cal_data locks
+ *
+ * Controls that walk or change state of many sessions take routing_lock
+ * for write and need nothing else. Stream setup (FE register/deregister,
+ * audio mixer put, BE hw_params/prepare/close) takes it for read, then
+ * the lock of the FE it works on, then one BE lock at a time. The FE lock
+ * covers fe_dai_map[], the session_copp_map[] row and the FE bit in each
+ * msm_bedais[].fe_sessions; the BE lock covers the rest of msm_bedais[].
+ * At most one FE and one BE lock are held together, so sessions on
+ * different front and back ends are set up in parallel.
+ */
+static DECLARE_RWSEM(routing_lock);
+static struct mutex fe_dai_lock[MSM_FRONTEND_DAI_MAX];
+static struct mutex be_dai_lock[MSM_BACKEND_DAI_MAX];
+
+enum {
+	ROUTING_LOCK_GLOBAL,
+	ROUTING_LOCK_SHARED,
+	ROUTING_LOCK_FE,
+	ROUTING_LOCK_BE,
+	ROUTING_LOCK_MAX,
+};
+
+/* Hold times are not tracked for the shared lock, it has many holders */
+struct msm_routing_lock_stat {
+	atomic64_t acquired;
+	atomic64_t contended;
+	atomic64_t wait_ns;
+	atomic64_t max_wait_ns;
+	atomic64_t hold_ns;
+	atomic64_t max_hold_ns;
+};
+
+static const char * const routing_lock_names[ROUTING_LOCK_MAX] = {
+	"global", "shared", "fe", "be",
+};
+static struct msm_routing_lock_stat routing_lock_stats[ROUTING_LOCK_MAX];
+static struct dentry *debugfs_routing_lock_stats;
+static ktime_t routing_lock_since;
+static ktime_t fe_lock_since[MSM_FRONTEND_DAI_MAX];
+static ktime_t be_lock_since[MSM_BACKEND_DAI_MAX];
+
+static void msm_routing_stat_max(atomic64_t *max, s64 val)
+{
+	s64 cur = atomic64_read(max);
+	s64 old;
+
+	while (val > cur) {
+		old = atomic64_cmpxchg(max, cur, val);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+}
+
+static void msm_routing_lock_contended(int type, ktime_t start)
+{
+	struct msm_routing_lock_stat *stat = &routing_lock_stats[type];
+	s64 wait_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	atomic64_inc(&stat->contended);
+	atomic64_add(wait_ns, &stat->wait_ns);
+	msm_routing_stat_max(&stat->max_wait_ns, wait_ns);
+}
+
+/* Called by the holder right before it releases a lock of @type */
+static void msm_routing_lock_held(int type, ktime_t since)
+{
+	struct msm_routing_lock_stat *stat = &routing_lock_stats[type];
+	s64 hold_ns = ktime_to_ns(ktime_sub(ktime_get(), since));
+
+	atomic64_add(hold_ns, &stat->hold_ns);
+	msm_routing_stat_max(&stat->max_hold_ns, hold_ns);
+}
+
+/* Exclusive: no stream setup runs while held */
+static void msm_routing_lock(void)
+{
+	ktime_t start;
+
+	atomic64_inc(&routing_lock_stats[ROUTING_LOCK_GLOBAL].acquired);
+	if (!down_write_trylock(&routing_lock)) {
+		start = ktime_get();
+		down_write(&routing_lock);
+		msm_routing_lock_contended(ROUTING_LOCK_GLOBAL, start);
+	}
+	routing_lock_since = ktime_get();
+}
+
+static void msm_routing_unlock(void)
+{
+	msm_routing_lock_held(ROUTING_LOCK_GLOBAL, routing_lock_since);
+	up_write(&routing_lock);
+}
+
+static void msm_routing_lock_shared(void)
+{
+	ktime_t start;
+
+	atomic64_inc(&routing_lock_stats[ROUTING_LOCK_SHARED].acquired);
+	if (down_read_trylock(&routing_lock))
+		return;
+	start = ktime_get();
+	down_read(&routing_lock);
+	msm_routing_lock_contended(ROUTING_LOCK_SHARED, start);
+}
+
+static void msm_routing_unlock_shared(void)
+{
+	up_read(&routing_lock);
+}
+
+static void msm_routing_mutex_lock(struct mutex *lock, int type)
+{
+	ktime_t start;
+
+	atomic64_inc(&routing_lock_stats[type].acquired);
+	if (mutex_trylock(lock))
+		return;
+	start = ktime_get();
+	mutex_lock(lock);
+	msm_routing_lock_contended(type, start);
+}
+
+/* Caller holds routing_lock shared */
+static void msm_routing_lock_fe(int fedai_id)
+{
+	msm_routing_mutex_lock(&fe_dai_lock[fedai_id], ROUTING_LOCK_FE);
+	fe_lock_since[fedai_id] = ktime_get();
+}
+
+static void msm_routing_unlock_fe(int fedai_id)
+{
+	msm_routing_lock_held(ROUTING_LOCK_FE, fe_lock_since[fedai_id]);
+	mutex_unlock(&fe_dai_lock[fedai_id]);
+}
+
+/* Caller holds routing_lock shared and, if any, only an FE lock */
+static void msm_routing_lock_be(int be_id)
+{
+	msm_routing_mutex_lock(&be_dai_lock[be_id], ROUTING_LOCK_BE);
+	be_lock_since[be_id] = ktime_get();
+}
+
+static void msm_routing_unlock_be(int be_id)
+{
+	msm_routing_lock_held(ROUTING_LOCK_BE, be_lock_since[be_id]);
+	mutex_unlock(&be_dai_lock[be_id]);
+}
+
+static ssize_t msm_routing_lock_stats_read(struct file *filp,
+					   char __user *ubuf,
+					   size_t cnt, loff_t *ppos)
+{
+	struct msm_routing_lock_stat *stat;
+	char buf[1024];
+	int i, len = 0;
+
+	for (i = 0; i < ROUTING_LOCK_MAX; i++) {
+		stat = &routing_lock_stats[i];
+		len += scnprintf(buf + len, sizeof(buf) - len,
+				 "%s acquired %lld contended %lld wait_ns %lld max_wait_ns %lld hold_ns %lld max_hold_ns %lld\n",
+				 routing_lock_names[i],
+				 atomic64_read(&stat->acquired),
+				 atomic64_read(&stat->contended),
+				 atomic64_read(&stat->wait_ns),
+				 atomic64_read(&stat->max_wait_ns),
+				 atomic64_read(&stat->hold_ns),
+				 atomic64_read(&stat->max_hold_ns));
+	}
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t msm_routing_lock_stats_write(struct file *filp,
+					    const char __user *ubuf,
+					    size_t cnt, loff_t *ppos)
+{
+	struct msm_routing_lock_stat *stat;
+	int i;
+
+	for (i = 0; i < ROUTING_LOCK_MAX; i++) {
+		stat = &routing_lock_stats[i];
+		atomic64_set(&stat->acquired, 0);
+		atomic64_set(&stat->contended, 0);
+		atomic64_set(&stat->wait_ns, 0);
+		atomic64_set(&stat->max_wait_ns, 0);
+		atomic64_set(&stat->hold_ns, 0);
+		atomic64_set(&stat->max_hold_ns, 0);
+	}
+
+	return cnt;
+}
+
+static const struct file_operations msm_routing_lock_stats_ops = {
+	.read = msm_routing_lock_stats_read,
+	.write = msm_routing_lock_stats_write,
+};
+
+/*
+ * Wall time and ADM commands of the routing control plane operations a
+ * device switch, stream start or voice call setup is made of. Scenario
+ * scripts reset msm_routing_op_stats, msm_routing_lock_stats and
+ * msm_adm_cmd_stats, run, and read all three back. adm_cmds is the ADM
+ * command count delta over the operation, so operations overlapping in
+ * time also count each other's commands.
+ */
+enum {
+	ROUTING_OP_REG_PHY_STREAM,
+	ROUTING_OP_DEREG_PHY_STREAM,
+	ROUTING_OP_AUDIO_MIXER,
+	ROUTING_OP_AUDIO_MIXER_TXN,
+	ROUTING_OP_VOICE_MIXER,
+	ROUTING_OP_BE_PREPARE,
+	ROUTING_OP_BE_CLOSE,
+	ROUTING_OP_MAX,
+};
+
+struct msm_routing_op_stat {
+	atomic64_t count;
+	atomic64_t total_ns;
+	atomic64_t max_ns;
+	atomic64_t adm_cmds;
+};
+
+struct msm_routing_op {
+	ktime_t start;
+	u64 adm_cmds;
+};
+
+static const char * const routing_op_names[ROUTING_OP_MAX] = {
+	"reg_phy_stream", "dereg_phy_stream", "audio_mixer", "audio_mixer_txn",
+	"voice_mixer", "be_prepare", "be_close",
+};
+static struct msm_routing_op_stat routing_op_stats[ROUTING_OP_MAX];
+static struct dentry *debugfs_routing_op_stats;
+
+static void msm_routing_op_begin(struct msm_routing_op *op)
+{
+	op->adm_cmds = adm_get_cmd_count();
+	op->start = ktime_get();
+}
+
+static void msm_routing_op_end(int type, struct msm_routing_op *op)
+{
+	struct msm_routing_op_stat *stat = &routing_op_stats[type];
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), op->start));
+
+	atomic64_inc(&stat->count);
+	atomic64_add(ns, &stat->total_ns);
+	msm_routing_stat_max(&stat->max_ns, ns);
+	atomic64_add(adm_get_cmd_count() - op->adm_cmds, &stat->adm_cmds);
+}
+
+static ssize_t msm_routing_op_stats_read(struct file *filp,
+					 char __user *ubuf,
+					 size_t cnt, loff_t *ppos)
+{
+	struct msm_routing_op_stat *stat;
+	char buf[1024];
+	int i, len = 0;
+
+	for (i = 0; i < ROUTING_OP_MAX; i++) {
+		stat = &routing_op_stats[i];
+		len += scnprintf(buf + len, sizeof(buf) - len,
+				 "%s count %lld total_ns %lld max_ns %lld adm_cmds %lld\n",
+				 routing_op_names[i],
+				 atomic64_read(&stat->count),
+				 atomic64_read(&stat->total_ns),
+				 atomic64_read(&stat->max_ns),
+				 atomic64_read(&stat->adm_cmds));
+	}
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t msm_routing_op_stats_write(struct file *filp,
+					  const char __user *ubuf,
+					  size_t cnt, loff_t *ppos)
+{
+	struct msm_routing_op_stat *stat;
+	int i;
+
+	for (i = 0; i < ROUTING_OP_MAX; i++) {
+		stat = &routing_op_stats[i];
+		atomic64_set(&stat->count, 0);
+		atomic64_set(&stat->total_ns, 0);
+		atomic64_set(&stat->max_ns, 0);
+		atomic64_set(&stat->adm_cmds, 0);
+	}
+
+	return cnt;
+}
+
+static const struct file_operations msm_routing_op_stats_ops = {
+	.read = msm_routing_op_stats_read,
+	.write = msm_routing_op_stats_write,
+};
 
 static struct cal_type_data *cal_data[MAX_ROUTING_CAL_TYPES];
 
@@ -858,6 +1166,34 @@ static struct msm_pcm_routing_fdai_data
 
 static unsigned long session_copp_map[MSM_FRONTEND_DAI_MAX][2]
 				     [MSM_BACKEND_DAI_MAX];
+/*
+ * Reverse index of msm_bedais[].fe_sessions: the BEs each FE is routed
+ * to, split by AFE port type. Only changed through
+ * msm_pcm_routing_set_route()/clear_route(), under the same locks.
+ */
+static unsigned long fe_be_routes[MSM_FRONTEND_DAI_MAX]
+				 [MSM_AFE_PORT_TYPE_TX + 1]
+				 [BITS_TO_LONGS(MSM_BACKEND_DAI_MAX)];
+
+#define for_each_fe_route(be_id, fe_id, port_type) \
+	for_each_set_bit(be_id, fe_be_routes[fe_id][port_type], \
+			 MSM_BACKEND_DAI_MAX)
+
+static void msm_pcm_routing_set_route(int be_id, int fe_id)
+{
+	int port_type = afe_get_port_type(msm_bedais[be_id].port_id);
+
+	set_bit(fe_id, &msm_bedais[be_id].fe_sessions[0]);
+	set_bit(be_id, fe_be_routes[fe_id][port_type]);
+}
+
+static void msm_pcm_routing_clear_route(int be_id, int fe_id)
+{
+	int port_type = afe_get_port_type(msm_bedais[be_id].port_id);
+
+	clear_bit(fe_id, &msm_bedais[be_id].fe_sessions[0]);
+	clear_bit(be_id, fe_be_routes[fe_id][port_type]);
+}
 static struct msm_pcm_routing_app_type_data app_type_cfg[MAX_APP_TYPES];
 static struct msm_pcm_routing_app_type_data lsm_app_type_cfg[MAX_APP_TYPES];
 static struct msm_pcm_stream_app_type_cfg
@@ -885,12 +1221,12 @@ void msm_pcm_routing_get_fedai_info(int fe_idx, int sess_type,
 
 void msm_pcm_routing_acquire_lock(void)
 {
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 }
 
 void msm_pcm_routing_release_lock(void)
 {
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 }
 
 static int msm_pcm_routing_get_app_type_idx(int app_type)
@@ -967,7 +1303,7 @@ int msm_pcm_routing_send_chmix_cfg(int fe_id, int ip_channel_cnt,
 {
 
 	int rc = 0, idx = 0;
-	int be_index = 0, port_id;
+	int be_index = 0, port_id, port_type;
 	unsigned int session_id = 0;
 
 	pr_debug("%s:fe_id[%d] ip_ch[%d] op_ch[%d] sess_type [%d], stream_type[%d]",
@@ -985,10 +1321,12 @@ int msm_pcm_routing_send_chmix_cfg(int fe_id, int ip_channel_cnt,
 		return -EINVAL;
 	}
 
-	for (be_index = 0; be_index < MSM_BACKEND_DAI_MAX; be_index++) {
+	port_type = (session_type == SESSION_TYPE_RX) ?
+		MSM_AFE_PORT_TYPE_RX : MSM_AFE_PORT_TYPE_TX;
+
+	for_each_fe_route(be_index, fe_id, port_type) {
 		port_id = msm_bedais[be_index].port_id;
-		if (!msm_bedais[be_index].active ||
-		    !test_bit(fe_id, &msm_bedais[be_index].fe_sessions[0]))
+		if (!msm_bedais[be_index].active)
 			continue;
 
 		session_id = fe_dai_map[fe_id][session_type].strm_id;
@@ -1295,9 +1633,15 @@ static uint8_t is_be_dai_extproc(int be_dai)
 		return 0;
 }
 
+/*
+ * Called with the lock of @fedai_id held, or routing_lock exclusive and
+ * @held_be negative. A BE lock the caller holds is passed in @held_be;
+ * it is dropped while the BEs are read one at a time and the map is
+ * sent, and taken again before returning.
+ */
 static void msm_pcm_routing_build_matrix(int fedai_id, int sess_type,
 					 int path_type, int perf_mode,
-					 uint32_t passthr_mode)
+					 uint32_t passthr_mode, int held_be)
 {
 	int i, port_type, j, num_copps = 0;
 	struct route_payload payload;
@@ -1306,11 +1650,13 @@ static void msm_pcm_routing_build_matrix(int fedai_id, int sess_type,
 		      path_type == ADM_PATH_COMPRESSED_RX) ?
 		MSM_AFE_PORT_TYPE_RX : MSM_AFE_PORT_TYPE_TX);
 
-	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++) {
-		if (!is_be_dai_extproc(i) &&
-		   (afe_get_port_type(msm_bedais[i].port_id) == port_type) &&
-		   (msm_bedais[i].active) &&
-		   (test_bit(fedai_id, &msm_bedais[i].fe_sessions[0]))) {
+	if (held_be >= 0)
+		msm_routing_unlock_be(held_be);
+	for_each_fe_route(i, fedai_id, port_type) {
+		if (is_be_dai_extproc(i))
+			continue;
+		msm_routing_lock_be(i);
+		if (msm_bedais[i].active) {
 			int port_id = get_port_id(msm_bedais[i].port_id);
 			for (j = 0; j < MAX_COPPS_PER_PORT; j++) {
 				unsigned long copp =
@@ -1334,6 +1680,7 @@ static void msm_pcm_routing_build_matrix(int fedai_id, int sess_type,
 				}
 			}
 		}
+		msm_routing_unlock_be(i);
 	}
 
 	if (num_copps) {
@@ -1342,6 +1689,8 @@ static void msm_pcm_routing_build_matrix(int fedai_id, int sess_type,
 		adm_matrix_map(path_type, payload, perf_mode, passthr_mode);
 		msm_pcm_routng_cfg_matrix_map_pp(payload, path_type, perf_mode);
 	}
+	if (held_be >= 0)
+		msm_routing_lock_be(held_be);
 }
 
 void msm_pcm_routing_reg_psthr_stream(int fedai_id, int dspst_id,
@@ -1366,21 +1715,25 @@ void msm_pcm_routing_reg_psthr_stream(int fedai_id, int dspst_id,
 		port_type = MSM_AFE_PORT_TYPE_TX;
 	}
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
+	msm_routing_lock_fe(fedai_id);
 
 	fe_dai_map[fedai_id][session_type].strm_id = dspst_id;
-	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++) {
-		if (!is_be_dai_extproc(i) &&
-		    (afe_get_port_type(msm_bedais[i].port_id) == port_type) &&
-		    (msm_bedais[i].active) &&
-		    (test_bit(fedai_id, &msm_bedais[i].fe_sessions[0]))) {
+	for_each_fe_route(i, fedai_id, port_type) {
+		if (is_be_dai_extproc(i))
+			continue;
+		msm_routing_lock_be(i);
+		if (msm_bedais[i].active) {
 			mode = afe_get_port_type(msm_bedais[i].port_id);
 			adm_connect_afe_port(mode, dspst_id,
 					     msm_bedais[i].port_id);
+			msm_routing_unlock_be(i);
 			break;
 		}
+		msm_routing_unlock_be(i);
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_fe(fedai_id);
+	msm_routing_unlock_shared();
 }
 
 static bool route_check_fe_id_adm_support(int fe_id)
@@ -1476,7 +1829,8 @@ int msm_pcm_routing_reg_phy_compr_stream(int fe_id, int perf_mode,
 
 	is_lsm = (fe_id >= MSM_FRONTEND_DAI_LSM1) &&
 			 (fe_id <= MSM_FRONTEND_DAI_LSM8);
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
+	msm_routing_lock_fe(fe_id);
 
 	fe_dai_map[fe_id][session_type].strm_id = dspst_id;
 	fe_dai_map[fe_id][session_type].perf_mode = perf_mode;
@@ -1484,19 +1838,19 @@ int msm_pcm_routing_reg_phy_compr_stream(int fe_id, int perf_mode,
 	if (!route_check_fe_id_adm_support(fe_id)) {
 		/* ignore adm open if not supported for fe_id */
 		pr_debug("%s: No ADM support for fe id %d\n", __func__, fe_id);
-		mutex_unlock(&routing_lock);
+		msm_routing_unlock_fe(fe_id);
+		msm_routing_unlock_shared();
 		return 0;
 	}
 
 	payload.num_copps = 0; /* only RX needs to use payload */
 	/* re-enable EQ if active */
 	msm_qti_pp_send_eq_values(fe_id);
-	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++) {
-		if (!is_be_dai_extproc(i) &&
-			(afe_get_port_type(msm_bedais[i].port_id) ==
-			port_type) &&
-			(msm_bedais[i].active) &&
-			(test_bit(fe_id, &msm_bedais[i].fe_sessions[0]))) {
+	for_each_fe_route(i, fe_id, port_type) {
+		if (is_be_dai_extproc(i))
+			continue;
+		msm_routing_lock_be(i);
+		if (msm_bedais[i].active) {
 			int app_type, app_type_idx, copp_idx, acdb_dev_id;
 			int port_id = get_port_id(msm_bedais[i].port_id);
 
@@ -1563,7 +1917,9 @@ int msm_pcm_routing_reg_phy_compr_stream(int fe_id, int perf_mode,
 				(copp_idx >= MAX_COPPS_PER_PORT)) {
 				pr_err("%s:adm open failed coppid:%d\n",
 				__func__, copp_idx);
-				mutex_unlock(&routing_lock);
+				msm_routing_unlock_be(i);
+				msm_routing_unlock_fe(fe_id);
+				msm_routing_unlock_shared();
 				return -EINVAL;
 			}
 			pr_debug("%s: set idx bit of fe:%d, type: %d, be:%d\n",
@@ -1604,6 +1960,7 @@ int msm_pcm_routing_reg_phy_compr_stream(int fe_id, int perf_mode,
 				msm_routing_send_device_pp_params(port_id,
 				copp_idx, fe_id);
 		}
+		msm_routing_unlock_be(i);
 	}
 	if (num_copps) {
 		payload.num_copps = num_copps;
@@ -1611,7 +1968,8 @@ int msm_pcm_routing_reg_phy_compr_stream(int fe_id, int perf_mode,
 		adm_matrix_map(path_type, payload, perf_mode, passthr_mode);
 		msm_pcm_routng_cfg_matrix_map_pp(payload, path_type, perf_mode);
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_fe(fe_id);
+	msm_routing_unlock_shared();
 	return 0;
 }
 
@@ -1824,14 +2182,26 @@ int msm_pcm_routing_set_channel_mixer_runtime(int be_id, int session_id,
 }
 EXPORT_SYMBOL(msm_pcm_routing_set_channel_mixer_runtime);
 
-int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
-					int dspst_id, int stream_type)
+/* BE state a COPP was opened against in msm_pcm_routing_reg_phy_stream() */
+struct msm_pcm_routing_be_open {
+	int be_id;
+	unsigned int sample_rate;
+	unsigned int channel;
+	unsigned int format;
+};
+
+static int __msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
+					    int dspst_id, int stream_type)
 {
-	int i, j, session_type, path_type, port_type, topology, num_copps = 0;
+	int i, j, k, session_type, path_type, port_type, topology;
+	int num_copps = 0, num_opens = 0;
+	struct msm_pcm_routing_be_open *opens = NULL;
+	struct adm_open_req *reqs = NULL;
 	struct route_payload payload;
 	u32 channels, sample_rate;
 	uint16_t bits_per_sample = 16, be_bit_width;
 	uint32_t passthr_mode = LEGACY_PCM;
+	bool open_failed = false;
 	int ret = 0;
 
 	if (fedai_id > MSM_FRONTEND_DAI_MM_MAX_ID) {
@@ -1850,7 +2220,8 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 		port_type = MSM_AFE_PORT_TYPE_TX;
 	}
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
+	msm_routing_lock_fe(fedai_id);
 
 	payload.num_copps = 0; /* only RX needs to use payload */
 	fe_dai_map[fedai_id][session_type].strm_id = dspst_id;
@@ -1859,12 +2230,29 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 
 	/* re-enable EQ if active */
 	msm_qti_pp_send_eq_values(fedai_id);
-	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++) {
-		if (!is_be_dai_extproc(i) &&
-		   (afe_get_port_type(msm_bedais[i].port_id) == port_type) &&
-		   (msm_bedais[i].active) &&
-		   (test_bit(fedai_id, &msm_bedais[i].fe_sessions[0]))) {
-			int app_type, app_type_idx, copp_idx, acdb_dev_id;
+
+	k = bitmap_weight(fe_be_routes[fedai_id][port_type],
+			  MSM_BACKEND_DAI_MAX);
+	if (k) {
+		opens = kcalloc(k, sizeof(*opens), GFP_KERNEL);
+		reqs = kcalloc(k, sizeof(*reqs), GFP_KERNEL);
+		if (!opens || !reqs) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+
+	/*
+	 * Gather the COPPs to open one BE lock at a time, open them all
+	 * in one batch so the DSP works on them in parallel, then attach
+	 * each to its BE if the BE did not change in the meantime.
+	 */
+	for_each_fe_route(i, fedai_id, port_type) {
+		if (is_be_dai_extproc(i))
+			continue;
+		msm_routing_lock_be(i);
+		if (msm_bedais[i].active && num_opens < k) {
+			int app_type, app_type_idx, acdb_dev_id;
 			int port_id = get_port_id(msm_bedais[i].port_id);
 
 			/*
@@ -1906,55 +2294,100 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 				&& be_bit_width == 32)
 				bits_per_sample = msm_routing_get_bit_width(
 							SNDRV_PCM_FORMAT_S32_LE);
-			copp_idx = adm_open(port_id, path_type,
-					    sample_rate, channels, topology,
-					    perf_mode, bits_per_sample,
-					    app_type, acdb_dev_id,
-					    session_type, passthr_mode);
-			if ((copp_idx < 0) ||
-				(copp_idx >= MAX_COPPS_PER_PORT)) {
-				pr_err("%s: adm open failed copp_idx:%d\n",
-				       __func__, copp_idx);
-				mutex_unlock(&routing_lock);
-				return -EINVAL;
-			}
-			pr_debug("%s: setting idx bit of fe:%d, type: %d, be:%d\n",
-				 __func__, fedai_id, session_type, i);
-			set_bit(copp_idx,
-				&session_copp_map[fedai_id][session_type][i]);
 
-			if (msm_is_resample_needed(
-				sample_rate,
-				msm_bedais[i].sample_rate))
-				adm_copp_mfc_cfg(port_id, copp_idx,
-					msm_bedais[i].sample_rate);
+			opens[num_opens].be_id = i;
+			opens[num_opens].sample_rate = msm_bedais[i].sample_rate;
+			opens[num_opens].channel = msm_bedais[i].channel;
+			opens[num_opens].format = msm_bedais[i].format;
+			reqs[num_opens] = (struct adm_open_req) {
+				.port_id = port_id,
+				.path = path_type,
+				.rate = sample_rate,
+				.channel_mode = channels,
+				.topology = topology,
+				.perf_mode = perf_mode,
+				.bit_width = bits_per_sample,
+				.app_type = app_type,
+				.acdb_id = acdb_dev_id,
+				.session_type = session_type,
+				.passthr_mode = passthr_mode,
+			};
+			num_opens++;
+		}
+		msm_routing_unlock_be(i);
+	}
 
-			for (j = 0; j < MAX_COPPS_PER_PORT; j++) {
-				unsigned long copp =
-				    session_copp_map[fedai_id][session_type][i];
-				if (test_bit(j, &copp)) {
-					payload.port_id[num_copps] = port_id;
-					payload.copp_idx[num_copps] = j;
-					payload.app_type[num_copps] =
-						fe_dai_app_type_cfg
-							[fedai_id][session_type]
-							[i].app_type;
-					payload.acdb_dev_id[num_copps] =
-						fe_dai_app_type_cfg
-							[fedai_id][session_type]
-							[i].acdb_dev_id;
-					payload.sample_rate[num_copps] =
-						fe_dai_app_type_cfg
-							[fedai_id][session_type]
-							[i].sample_rate;
-					num_copps++;
-				}
+	if (num_opens)
+		adm_open_batch(reqs, num_opens);
+
+	for (k = 0; k < num_opens; k++) {
+		int copp_idx = reqs[k].copp_idx;
+		int port_id = reqs[k].port_id;
+
+		i = opens[k].be_id;
+		if ((copp_idx < 0) || (copp_idx >= MAX_COPPS_PER_PORT)) {
+			pr_err("%s: adm open failed copp_idx:%d\n",
+			       __func__, copp_idx);
+			open_failed = true;
+			continue;
+		}
+
+		msm_routing_lock_be(i);
+		if (!msm_bedais[i].active ||
+		    msm_bedais[i].sample_rate != opens[k].sample_rate ||
+		    msm_bedais[i].channel != opens[k].channel ||
+		    msm_bedais[i].format != opens[k].format) {
+			/* closed or reconfigured, prepare opens its own */
+			pr_debug("%s: be:%d changed during open\n",
+				 __func__, i);
+			adm_close(port_id, perf_mode, copp_idx);
+			msm_routing_unlock_be(i);
+			continue;
+		}
+
+		pr_debug("%s: setting idx bit of fe:%d, type: %d, be:%d\n",
+			 __func__, fedai_id, session_type, i);
+		set_bit(copp_idx,
+			&session_copp_map[fedai_id][session_type][i]);
+
+		if (msm_is_resample_needed(
+			reqs[k].rate,
+			msm_bedais[i].sample_rate))
+			adm_copp_mfc_cfg(port_id, copp_idx,
+				msm_bedais[i].sample_rate);
+
+		for (j = 0; j < MAX_COPPS_PER_PORT; j++) {
+			unsigned long copp =
+			    session_copp_map[fedai_id][session_type][i];
+			if (test_bit(j, &copp)) {
+				payload.port_id[num_copps] = port_id;
+				payload.copp_idx[num_copps] = j;
+				payload.app_type[num_copps] =
+					fe_dai_app_type_cfg
+						[fedai_id][session_type]
+						[i].app_type;
+				payload.acdb_dev_id[num_copps] =
+					fe_dai_app_type_cfg
+						[fedai_id][session_type]
+						[i].acdb_dev_id;
+				payload.sample_rate[num_copps] =
+					fe_dai_app_type_cfg
+						[fedai_id][session_type]
+						[i].sample_rate;
+				num_copps++;
 			}
-			if (perf_mode == LEGACY_PCM_MODE)
-				msm_pcm_routing_cfg_pp(port_id, copp_idx,
-						       topology, channels);
 		}
+		if (perf_mode == LEGACY_PCM_MODE)
+			msm_pcm_routing_cfg_pp(port_id, copp_idx,
+					       reqs[k].topology,
+					       reqs[k].channel_mode);
+		msm_routing_unlock_be(i);
 	}
+	if (open_failed) {
+		ret = -EINVAL;
+		goto done;
+	}
+
 	if (num_copps) {
 		payload.num_copps = num_copps;
 		payload.session_id = fe_dai_map[fedai_id][session_type].strm_id;
@@ -1964,7 +2397,24 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 
 	ret = msm_pcm_routing_channel_mixer(fedai_id, perf_mode,
 				dspst_id, stream_type);
-	mutex_unlock(&routing_lock);
+done:
+	kfree(reqs);
+	kfree(opens);
+	msm_routing_unlock_fe(fedai_id);
+	msm_routing_unlock_shared();
+	return ret;
+}
+
+int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
+					int dspst_id, int stream_type)
+{
+	struct msm_routing_op op;
+	int ret;
+
+	msm_routing_op_begin(&op);
+	ret = __msm_pcm_routing_reg_phy_stream(fedai_id, perf_mode, dspst_id,
+					       stream_type);
+	msm_routing_op_end(ROUTING_OP_REG_PHY_STREAM, &op);
 	return ret;
 }
 
@@ -1985,7 +2435,7 @@ int msm_pcm_routing_reg_phy_stream_v2(int fedai_id, int perf_mode,
 	return 0;
 }
 
-void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
+static void __msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
 {
 	int i, port_type, session_type, path_type, topology, port_id;
 	struct msm_pcm_routing_fdai_data *fdai;
@@ -2006,12 +2456,17 @@ void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
 		path_type = ADM_PATH_LIVE_REC;
 	}
 
-	mutex_lock(&routing_lock);
-	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++) {
-		if (!is_be_dai_extproc(i) &&
-		   (afe_get_port_type(msm_bedais[i].port_id) == port_type) &&
-		   (msm_bedais[i].active) &&
-		   (test_bit(fedai_id, &msm_bedais[i].fe_sessions[0]))) {
+	msm_routing_lock_shared();
+	msm_routing_lock_fe(fedai_id);
+	for_each_fe_route(i, fedai_id, port_type) {
+		if (is_be_dai_extproc(i))
+			continue;
+		/*
+		 * Key on the copp bit, not on BE active: a racing BE
+		 * close clears active before it reaches this FE.
+		 */
+		msm_routing_lock_be(i);
+		if (session_copp_map[fedai_id][session_type][i]) {
 			int idx;
 			unsigned long copp =
 				session_copp_map[fedai_id][session_type][i];
@@ -2021,11 +2476,6 @@ void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
 				if (test_bit(idx, &copp))
 					break;
 
-			if (idx >= MAX_COPPS_PER_PORT || idx < 0) {
-				pr_debug("%s: copp idx is invalid, exiting\n",
-								__func__);
-				continue;
-			}
 			port_id = get_port_id(msm_bedais[i].port_id);
 			topology = adm_get_topology_for_port_copp_idx(
 					port_id, idx);
@@ -2041,11 +2491,22 @@ void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
 			    (fdai->passthr_mode == LEGACY_PCM))
 				msm_pcm_routing_deinit_pp(port_id, topology);
 		}
+		msm_routing_unlock_be(i);
 	}
 
 	fe_dai_map[fedai_id][session_type].strm_id = INVALID_SESSION;
 	fe_dai_map[fedai_id][session_type].be_srate = 0;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_fe(fedai_id);
+	msm_routing_unlock_shared();
+}
+
+void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
+{
+	struct msm_routing_op op;
+
+	msm_routing_op_begin(&op);
+	__msm_pcm_routing_dereg_phy_stream(fedai_id, stream_type);
+	msm_routing_op_end(ROUTING_OP_DEREG_PHY_STREAM, &op);
 }
 
 /* Check if FE/BE route is set */
@@ -2065,7 +2526,14 @@ static bool msm_pcm_routing_route_is_set(u16 be_id, u16 fe_id)
 	return rc;
 }
 
-static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
+/*
+ * Apply one FE/BE audio mixer change with the FE and BE locks, or
+ * routing_lock for write, held. When @map is false the matrix is not
+ * rebuilt and true is returned if the caller has to do it for this FE
+ * once all of its changes are applied.
+ */
+static bool __msm_pcm_routing_process_audio(u16 reg, u16 val, int set,
+					    bool map)
 {
 	int session_type, path_type, topology;
 	u32 channels, sample_rate;
@@ -2073,6 +2541,7 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 	struct msm_pcm_routing_fdai_data *fdai;
 	uint32_t passthr_mode;
 	bool is_lsm;
+	bool remap = false;
 
 	pr_debug("%s: reg %x val %x set %x\n", __func__, reg, val, set);
 
@@ -2085,17 +2554,17 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 	} else if (!is_mm_lsm_fe_id(val)) {
 		/* recheck FE ID in the mixer control defined in this file */
 		pr_err("%s: bad MM ID\n", __func__);
-		return;
+		return false;
 	}
 
 	if (!route_check_fe_id_adm_support(val)) {
 		/* ignore adm open if not supported for fe_id */
 		pr_debug("%s: No ADM support for fe id %d\n", __func__, val);
 		if (set)
-			set_bit(val, &msm_bedais[reg].fe_sessions[0]);
+			msm_pcm_routing_set_route(reg, val);
 		else
-			clear_bit(val, &msm_bedais[reg].fe_sessions[0]);
-		return;
+			msm_pcm_routing_clear_route(reg, val);
+		return false;
 	}
 
 	session_type =
@@ -2117,14 +2586,13 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 	is_lsm = (val >= MSM_FRONTEND_DAI_LSM1) &&
 			 (val <= MSM_FRONTEND_DAI_LSM8);
 
-	mutex_lock(&routing_lock);
 	if (set) {
 		if (!test_bit(val, &msm_bedais[reg].fe_sessions[0]) &&
 			((msm_bedais[reg].port_id == VOICE_PLAYBACK_TX) ||
 			(msm_bedais[reg].port_id == VOICE2_PLAYBACK_TX)))
 			voc_start_playback(set, msm_bedais[reg].port_id);
 
-		set_bit(val, &msm_bedais[reg].fe_sessions[0]);
+		msm_pcm_routing_set_route(reg, val);
 		if (msm_bedais[reg].active && fdai->strm_id !=
 			INVALID_SESSION) {
 			int app_type, app_type_idx, copp_idx, acdb_dev_id;
@@ -2195,8 +2663,7 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			if ((copp_idx < 0) ||
 			    (copp_idx >= MAX_COPPS_PER_PORT)) {
 				pr_err("%s: adm open failed\n", __func__);
-				mutex_unlock(&routing_lock);
-				return;
+				return false;
 			}
 			pr_debug("%s: setting idx bit of fe:%d, type: %d, be:%d\n",
 				 __func__, val, session_type, reg);
@@ -2215,10 +2682,13 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 					MSM_PCM_RT_EVT_DEVSWITCH,
 					fdai->event_info.priv_data);
 
-			msm_pcm_routing_build_matrix(val, session_type,
-						     path_type,
-						     fdai->perf_mode,
-						     passthr_mode);
+			if (map)
+				msm_pcm_routing_build_matrix(val, session_type,
+							     path_type,
+							     fdai->perf_mode,
+							     passthr_mode, reg);
+			else
+				remap = true;
 			if ((fdai->perf_mode == LEGACY_PCM_MODE) &&
 				(passthr_mode == LEGACY_PCM))
 				msm_pcm_routing_cfg_pp(port_id, copp_idx,
@@ -2229,7 +2699,7 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			((msm_bedais[reg].port_id == VOICE_PLAYBACK_TX) ||
 			(msm_bedais[reg].port_id == VOICE2_PLAYBACK_TX)))
 			voc_start_playback(set, msm_bedais[reg].port_id);
-		clear_bit(val, &msm_bedais[reg].fe_sessions[0]);
+		msm_pcm_routing_clear_route(reg, val);
 		if (msm_bedais[reg].active && fdai->strm_id !=
 			INVALID_SESSION) {
 			int idx;
@@ -2243,8 +2713,7 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			if (idx >= MAX_COPPS_PER_PORT) {
 				pr_debug("%s: copp idx is invalid, exiting\n",
 								__func__);
-				mutex_unlock(&routing_lock);
-				return;
+				return false;
 			}
 			port_id = get_port_id(msm_bedais[reg].port_id);
 			topology = adm_get_topology_for_port_copp_idx(port_id,
@@ -2261,30 +2730,318 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			    (fdai->perf_mode == LEGACY_PCM_MODE) &&
 			    (passthr_mode == LEGACY_PCM))
 				msm_pcm_routing_deinit_pp(port_id, topology);
-			msm_pcm_routing_build_matrix(val, session_type,
-						     path_type,
-						     fdai->perf_mode,
-						     passthr_mode);
+			if (map)
+				msm_pcm_routing_build_matrix(val, session_type,
+							     path_type,
+							     fdai->perf_mode,
+							     passthr_mode, reg);
+			else
+				remap = true;
 		}
 	}
 	if ((msm_bedais[reg].port_id == VOICE_RECORD_RX)
 			|| (msm_bedais[reg].port_id == VOICE_RECORD_TX))
 		voc_start_record(msm_bedais[reg].port_id, set, voc_session_id);
 
-	mutex_unlock(&routing_lock);
+	return remap;
+}
+
+static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
+{
+	struct msm_routing_op op;
+
+	if (reg >= MSM_BACKEND_DAI_MAX || val >= MSM_FRONTEND_DAI_MAX) {
+		pr_err("%s: invalid BE %d or FE %d\n", __func__, reg, val);
+		return;
+	}
+
+	msm_routing_op_begin(&op);
+	msm_routing_lock_shared();
+	msm_routing_lock_fe(val);
+	msm_routing_lock_be(reg);
+	__msm_pcm_routing_process_audio(reg, val, set, true);
+	msm_routing_unlock_be(reg);
+	msm_routing_unlock_fe(val);
+	msm_routing_unlock_shared();
+	msm_routing_op_end(ROUTING_OP_AUDIO_MIXER, &op);
+}
+
+/*
+ * Audio mixer transaction. Between "Audio Mixer Transaction" 1 and 0
+ * the audio mixer puts only record the requested FE/BE state. Commit
+ * drops changes that net out, applies the rest under one routing_lock
+ * hold and rebuilds the matrix once per affected FE session. The
+ * transaction is shared by all clients, so one left open by a client
+ * that went away is committed after MSM_ROUTING_TXN_TIMEOUT_MS.
+ */
+#define MSM_ROUTING_TXN_MAX	64
+#define MSM_ROUTING_TXN_TIMEOUT_MS	2000
+
+struct msm_routing_txn_entry {
+	struct snd_kcontrol *kcontrol;
+	u16 be_id;
+	u16 fe_id;
+	int set;
+};
+
+struct msm_routing_txn {
+	bool active;
+	/* bumped on every open, tells a timeout which transaction it is for */
+	u32 seq;
+	unsigned long deadline;
+	int count;
+	struct msm_routing_txn_entry entry[MSM_ROUTING_TXN_MAX];
+};
+
+static DEFINE_MUTEX(routing_txn_lock);
+static struct msm_routing_txn routing_txn;
+
+static struct msm_routing_txn_entry *msm_routing_txn_find(u16 be_id,
+							  u16 fe_id)
+{
+	int i;
+
+	for (i = 0; i < routing_txn.count; i++)
+		if (routing_txn.entry[i].be_id == be_id &&
+		    routing_txn.entry[i].fe_id == fe_id)
+			return &routing_txn.entry[i];
+
+	return NULL;
+}
+
+/* Returns false if the change has to be applied right away */
+static bool msm_routing_txn_stage(struct snd_kcontrol *kcontrol,
+				  u16 be_id, u16 fe_id, int set)
+{
+	struct msm_routing_txn_entry *e;
+	bool staged = false;
+
+	mutex_lock(&routing_txn_lock);
+	if (!routing_txn.active)
+		goto done;
+
+	e = msm_routing_txn_find(be_id, fe_id);
+	if (!e) {
+		if (routing_txn.count >= MSM_ROUTING_TXN_MAX) {
+			pr_warn_ratelimited("%s: transaction full, be %d fe %d applied now\n",
+					    __func__, be_id, fe_id);
+			goto done;
+		}
+		e = &routing_txn.entry[routing_txn.count++];
+		e->kcontrol = kcontrol;
+		e->be_id = be_id;
+		e->fe_id = fe_id;
+	}
+	e->set = set;
+	staged = true;
+done:
+	mutex_unlock(&routing_txn_lock);
+	return staged;
+}
+
+/* Commits transaction @seq, if it is still the open one */
+static void msm_routing_txn_commit(u32 seq)
+{
+	unsigned long remap[SESSION_TYPE_TX + 1]
+			   [BITS_TO_LONGS(MSM_FRONTEND_DAI_MAX)] = { { 0 } };
+	struct msm_routing_txn_entry *e;
+	struct msm_pcm_routing_fdai_data *fdai;
+	struct snd_soc_dapm_widget *widget;
+	int i, fe_id, session_type, path_type;
+
+	mutex_lock(&routing_txn_lock);
+	if (!routing_txn.active || routing_txn.seq != seq) {
+		mutex_unlock(&routing_txn_lock);
+		return;
+	}
+	routing_txn.active = false;
+
+	/* Drop entries that ended up where they started */
+	for (i = 0; i < routing_txn.count; ) {
+		e = &routing_txn.entry[i];
+		if (!!e->set == msm_pcm_routing_route_is_set(e->be_id,
+							     e->fe_id))
+			*e = routing_txn.entry[--routing_txn.count];
+		else
+			i++;
+	}
+	pr_debug("%s: applying %d mixer changes\n", __func__,
+		 routing_txn.count);
+
+	msm_routing_lock();
+	/* Closes first so that COPPs are released before new opens */
+	for (i = 0; i < routing_txn.count; i++) {
+		e = &routing_txn.entry[i];
+		if (e->set)
+			continue;
+		session_type = (afe_get_port_type(msm_bedais[e->be_id].port_id)
+				== MSM_AFE_PORT_TYPE_RX) ?
+				SESSION_TYPE_RX : SESSION_TYPE_TX;
+		if (__msm_pcm_routing_process_audio(e->be_id, e->fe_id, 0,
+						    false))
+			set_bit(e->fe_id, remap[session_type]);
+	}
+	for (i = 0; i < routing_txn.count; i++) {
+		e = &routing_txn.entry[i];
+		if (!e->set)
+			continue;
+		session_type = (afe_get_port_type(msm_bedais[e->be_id].port_id)
+				== MSM_AFE_PORT_TYPE_RX) ?
+				SESSION_TYPE_RX : SESSION_TYPE_TX;
+		if (__msm_pcm_routing_process_audio(e->be_id, e->fe_id, 1,
+						    false))
+			set_bit(e->fe_id, remap[session_type]);
+	}
+
+	for (session_type = SESSION_TYPE_RX; session_type <= SESSION_TYPE_TX;
+	     session_type++) {
+		for_each_set_bit(fe_id, remap[session_type],
+				 MSM_FRONTEND_DAI_MAX) {
+			fdai = &fe_dai_map[fe_id][session_type];
+			if (session_type == SESSION_TYPE_RX) {
+				if (fdai->passthr_mode != LEGACY_PCM)
+					path_type = ADM_PATH_COMPRESSED_RX;
+				else
+					path_type = ADM_PATH_PLAYBACK;
+			} else {
+				if ((fdai->passthr_mode != LEGACY_PCM) &&
+				    (fdai->passthr_mode != LISTEN))
+					path_type = ADM_PATH_COMPRESSED_TX;
+				else
+					path_type = ADM_PATH_LIVE_REC;
+			}
+			msm_pcm_routing_build_matrix(fe_id, session_type,
+						     path_type,
+						     fdai->perf_mode,
+						     fdai->passthr_mode, -1);
+		}
+	}
+	msm_routing_unlock();
+
+	/* DAPM may start BEs, which takes routing_lock again */
+	for (i = 0; i < routing_txn.count; i++) {
+		e = &routing_txn.entry[i];
+		widget = snd_soc_dapm_kcontrol_widget(e->kcontrol);
+		snd_soc_dapm_mixer_update_power(widget->dapm, e->kcontrol,
+						e->set, NULL);
+	}
+	routing_txn.count = 0;
+	mutex_unlock(&routing_txn_lock);
+}
+
+static void msm_routing_txn_timeout(struct work_struct *work);
+static DECLARE_DELAYED_WORK(routing_txn_work, msm_routing_txn_timeout);
+
+/* Arms the timeout for the open transaction, routing_txn_lock held */
+static void msm_routing_txn_arm(void)
+{
+	long left = (long)(routing_txn.deadline - jiffies);
+
+	mod_delayed_work(system_wq, &routing_txn_work, max(left, 0L));
+}
+
+static void msm_routing_txn_timeout(struct work_struct *work)
+{
+	struct msm_routing_op op;
+	u32 seq;
+
+	mutex_lock(&routing_txn_lock);
+	if (!routing_txn.active) {
+		mutex_unlock(&routing_txn_lock);
+		return;
+	}
+	/* a later transaction reused the work before its time was up */
+	if (time_before(jiffies, routing_txn.deadline)) {
+		msm_routing_txn_arm();
+		mutex_unlock(&routing_txn_lock);
+		return;
+	}
+	seq = routing_txn.seq;
+	mutex_unlock(&routing_txn_lock);
+
+	pr_warn("%s: transaction open for %d ms, committing\n", __func__,
+		MSM_ROUTING_TXN_TIMEOUT_MS);
+	msm_routing_op_begin(&op);
+	msm_routing_txn_commit(seq);
+	msm_routing_op_end(ROUTING_OP_AUDIO_MIXER_TXN, &op);
+}
+
+static int msm_routing_get_audio_mixer_txn(struct snd_kcontrol *kcontrol,
+					   struct snd_ctl_elem_value *ucontrol)
+{
+	mutex_lock(&routing_txn_lock);
+	ucontrol->value.integer.value[0] = routing_txn.active;
+	mutex_unlock(&routing_txn_lock);
+	return 0;
+}
+
+static int msm_routing_put_audio_mixer_txn(struct snd_kcontrol *kcontrol,
+					   struct snd_ctl_elem_value *ucontrol)
+{
+	struct msm_routing_op op;
+	u32 seq;
+
+	mutex_lock(&routing_txn_lock);
+	if (ucontrol->value.integer.value[0]) {
+		if (!routing_txn.active) {
+			routing_txn.active = true;
+			routing_txn.seq++;
+			routing_txn.deadline = jiffies +
+				msecs_to_jiffies(MSM_ROUTING_TXN_TIMEOUT_MS);
+			msm_routing_txn_arm();
+		}
+		mutex_unlock(&routing_txn_lock);
+		return 0;
+	}
+	if (!routing_txn.active) {
+		mutex_unlock(&routing_txn_lock);
+		return 0;
+	}
+	seq = routing_txn.seq;
+	mutex_unlock(&routing_txn_lock);
+
+	/* a timeout already running commits it first, then ours is a no-op */
+	cancel_delayed_work_sync(&routing_txn_work);
+	msm_routing_op_begin(&op);
+	msm_routing_txn_commit(seq);
+	msm_routing_op_end(ROUTING_OP_AUDIO_MIXER_TXN, &op);
+
+	/* the cancel may have hit the timeout of a newer transaction */
+	mutex_lock(&routing_txn_lock);
+	if (routing_txn.active)
+		msm_routing_txn_arm();
+	mutex_unlock(&routing_txn_lock);
+
+	return 0;
 }
 
+static const struct snd_kcontrol_new audio_mixer_txn_controls[] = {
+	SOC_SINGLE_EXT("Audio Mixer Transaction", SND_SOC_NOPM, 0,
+		1, 0, msm_routing_get_audio_mixer_txn,
+		msm_routing_put_audio_mixer_txn),
+};
+
 static int msm_routing_get_audio_mixer(struct snd_kcontrol *kcontrol,
 				struct snd_ctl_elem_value *ucontrol)
 {
 	struct soc_mixer_control *mc =
 	(struct soc_mixer_control *)kcontrol->private_value;
+	struct msm_routing_txn_entry *e;
 
 	if (test_bit(mc->rshift, &msm_bedais[mc->shift].fe_sessions[0]))
 		ucontrol->value.integer.value[0] = 1;
 	else
 		ucontrol->value.integer.value[0] = 0;
 
+	/* Report the staged state while a transaction is open */
+	mutex_lock(&routing_txn_lock);
+	if (routing_txn.active) {
+		e = msm_routing_txn_find(mc->shift, mc->rshift);
+		if (e)
+			ucontrol->value.integer.value[0] = !!e->set;
+	}
+	mutex_unlock(&routing_txn_lock);
+
 	pr_debug("%s: shift %x rshift %x val %ld\n", __func__, mc->shift, mc->rshift,
 	ucontrol->value.integer.value[0]);
 
@@ -2300,6 +3057,10 @@ static int msm_routing_put_audio_mixer(struct snd_kcontrol *kcontrol,
 		(struct soc_mixer_control *)kcontrol->private_value;
 	struct snd_soc_dapm_update *update = NULL;
 
+	if (msm_routing_txn_stage(kcontrol, mc->shift, mc->rshift,
+				  !!ucontrol->value.integer.value[0]))
+		return 1;
+
 	if (ucontrol->value.integer.value[0] &&
 	   msm_pcm_routing_route_is_set(mc->shift, mc->rshift) == false) {
 		msm_pcm_routing_process_audio(mc->shift, mc->rshift, 1);
@@ -2359,7 +3120,7 @@ static int msm_routing_put_listen_mixer(struct snd_kcontrol *kcontrol,
 	return 1;
 }
 
-static void msm_pcm_routing_process_voice(u16 reg, u16 val, int set)
+static void __msm_pcm_routing_process_voice(u16 reg, u16 val, int set)
 {
 	u32 session_id = 0;
 	u16 path_type;
@@ -2372,12 +3133,12 @@ static void msm_pcm_routing_process_voice(u16 reg, u16 val, int set)
 	pr_debug("%s: FE DAI 0x%x session_id 0x%x\n",
 		__func__, val, session_id);
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 
 	if (set)
-		set_bit(val, &msm_bedais[reg].fe_sessions[0]);
+		msm_pcm_routing_set_route(reg, val);
 	else
-		clear_bit(val, &msm_bedais[reg].fe_sessions[0]);
+		msm_pcm_routing_clear_route(reg, val);
 
 	if (val == MSM_FRONTEND_DAI_DTMF_RX &&
 	    afe_get_port_type(msm_bedais[reg].port_id) ==
@@ -2424,8 +3185,17 @@ static void msm_pcm_routing_process_voice(u16 reg, u16 val, int set)
 		voc_disable_device(session_id);
 	}
 
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
+
+}
+
+static void msm_pcm_routing_process_voice(u16 reg, u16 val, int set)
+{
+	struct msm_routing_op op;
 
+	msm_routing_op_begin(&op);
+	__msm_pcm_routing_process_voice(reg, val, set);
+	msm_routing_op_end(ROUTING_OP_VOICE_MIXER, &op);
 }
 
 static int msm_routing_get_voice_mixer(struct snd_kcontrol *kcontrol,
@@ -2434,14 +3204,14 @@ static int msm_routing_get_voice_mixer(struct snd_kcontrol *kcontrol,
 	struct soc_mixer_control *mc =
 	(struct soc_mixer_control *)kcontrol->private_value;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 
 	if (test_bit(mc->rshift, &msm_bedais[mc->shift].fe_sessions[0]))
 		ucontrol->value.integer.value[0] = 1;
 	else
 		ucontrol->value.integer.value[0] = 0;
 
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 
 	pr_debug("%s: shift %x rshift %x val %ld\n", __func__, mc->shift, mc->rshift,
 			ucontrol->value.integer.value[0]);
@@ -2477,14 +3247,14 @@ static int msm_routing_get_voice_stub_mixer(struct snd_kcontrol *kcontrol,
 	struct soc_mixer_control *mc =
 		(struct soc_mixer_control *)kcontrol->private_value;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 
 	if (test_bit(mc->rshift, &msm_bedais[mc->shift].fe_sessions[0]))
 		ucontrol->value.integer.value[0] = 1;
 	else
 		ucontrol->value.integer.value[0] = 0;
 
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 
 	pr_debug("%s: shift %x rshift %x val %ld\n", __func__, mc->shift, mc->rshift,
 		ucontrol->value.integer.value[0]);
@@ -2502,16 +3272,16 @@ static int msm_routing_put_voice_stub_mixer(struct snd_kcontrol *kcontrol,
 	struct snd_soc_dapm_update *update = NULL;
 
 	if (ucontrol->value.integer.value[0]) {
-		mutex_lock(&routing_lock);
-		set_bit(mc->rshift, &msm_bedais[mc->shift].fe_sessions[0]);
-		mutex_unlock(&routing_lock);
+		msm_routing_lock();
+		msm_pcm_routing_set_route(mc->shift, mc->rshift);
+		msm_routing_unlock();
 
 		snd_soc_dapm_mixer_update_power(widget->dapm, kcontrol, 1,
 						update);
 	} else {
-		mutex_lock(&routing_lock);
-		clear_bit(mc->rshift, &msm_bedais[mc->shift].fe_sessions[0]);
-		mutex_unlock(&routing_lock);
+		msm_routing_lock();
+		msm_pcm_routing_clear_route(mc->shift, mc->rshift);
+		msm_routing_unlock();
 
 		snd_soc_dapm_mixer_update_power(widget->dapm, kcontrol, 0,
 						update);
@@ -2572,7 +3342,7 @@ static int msm_pcm_get_dev_acdb_id_by_port_id(int port_id)
 		goto exit;
 	}
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	i = find_first_bit(&msm_bedais[be_id].fe_sessions[0],
 			   MSM_FRONTEND_DAI_MAX);
 	if (i < MSM_FRONTEND_DAI_MAX)
@@ -2580,7 +3350,7 @@ static int msm_pcm_get_dev_acdb_id_by_port_id(int port_id)
 
 	pr_debug("%s: FE[%d] session[%d] BE[%d] acdb_id(%d)\n",
 		 __func__, i, session, be_id, acdb_id);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 exit:
 	return acdb_id;
 }
@@ -3327,12 +4097,12 @@ static int msm_routing_adm_channel_config_get(
 	int backend_id = msm_routing_adm_get_backend_idx(kcontrol);
 
 	if (backend_id >= 0) {
-		mutex_lock(&routing_lock);
+		msm_routing_lock_shared();
 		ucontrol->value.integer.value[0] =
 			 msm_bedais[backend_id].adm_override_ch;
 		pr_debug("%s: adm channel count %ld for BE:%d\n", __func__,
 			 ucontrol->value.integer.value[0], backend_id);
-		 mutex_unlock(&routing_lock);
+		 msm_routing_unlock_shared();
 	}
 
 	return 0;
@@ -3345,13 +4115,13 @@ static int msm_routing_adm_channel_config_put(
 	int backend_id = msm_routing_adm_get_backend_idx(kcontrol);
 
 	if (backend_id >= 0) {
-		mutex_lock(&routing_lock);
+		msm_routing_lock();
 		msm_bedais[backend_id].adm_override_ch =
 				 ucontrol->value.integer.value[0];
 		pr_debug("%s:updating BE :%d  adm channels: %d\n",
 			  __func__, backend_id,
 			  msm_bedais[backend_id].adm_override_ch);
-		mutex_unlock(&routing_lock);
+		msm_routing_unlock();
 	}
 
 	return 0;
@@ -3370,9 +4140,9 @@ static int msm_routing_slim_0_rx_aanc_mux_get(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol)
 {
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	ucontrol->value.integer.value[0] = slim0_rx_aanc_fb_port;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 	pr_debug("%s: AANC Mux Port %ld\n", __func__,
 		ucontrol->value.integer.value[0]);
 	return 0;
@@ -3383,7 +4153,7 @@ static int msm_routing_slim_0_rx_aanc_mux_put(struct snd_kcontrol *kcontrol,
 {
 	struct aanc_data aanc_info;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	memset(&aanc_info, 0x00, sizeof(aanc_info));
 	pr_debug("%s: AANC Mux Port %ld\n", __func__,
 		ucontrol->value.integer.value[0]);
@@ -3399,7 +4169,7 @@ static int msm_routing_slim_0_rx_aanc_mux_put(struct snd_kcontrol *kcontrol,
 			(SLIMBUS_0_RX - 1 + (slim0_rx_aanc_fb_port * 2));
 	}
 	afe_set_aanc_info(&aanc_info);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return 0;
 };
 static int msm_routing_get_port_mixer(struct snd_kcontrol *kcontrol,
@@ -5601,9 +6371,9 @@ static int msm_routing_afe_lb_tx_port_get(struct snd_kcontrol *kcontrol,
 				struct snd_ctl_elem_value *ucontrol)
 {
 	pr_debug("%s: port index = %d", __func__, afe_loopback_tx_port_index);
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	ucontrol->value.integer.value[0] = afe_loopback_tx_port_index;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 
 	return 0;
 }
@@ -5613,12 +6383,12 @@ static int msm_routing_afe_lb_tx_port_put(struct snd_kcontrol *kcontrol,
 {
 	int value = ucontrol->value.integer.value[0];
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	afe_loopback_tx_port_id = get_ec_ref_port_id(value,
 			&afe_loopback_tx_port_index);
 	pr_debug("%s: afe_loopback_tx_port_index = %d\n",
 	    __func__, afe_loopback_tx_port_index);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 
 	return 0;
 }
@@ -5697,9 +6467,9 @@ static int msm_routing_ec_ref_rx_get(struct snd_kcontrol *kcontrol,
 				struct snd_ctl_elem_value *ucontrol)
 {
 	pr_debug("%s: ec_ref_rx  = %d", __func__, msm_route_ec_ref_rx);
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	ucontrol->value.integer.value[0] = msm_route_ec_ref_rx;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 
 	return 0;
 }
@@ -5713,12 +6483,12 @@ static int msm_routing_ec_ref_rx_put(struct snd_kcontrol *kcontrol,
 	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
 	struct snd_soc_dapm_update *update = NULL;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	msm_ec_ref_port_id = get_ec_ref_port_id(value, &msm_route_ec_ref_rx);
 	adm_ec_ref_rx_id(msm_ec_ref_port_id);
 	pr_debug("%s: msm_route_ec_ref_rx = %d\n",
 	    __func__, msm_route_ec_ref_rx);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 
 	snd_soc_dapm_mux_update_power(widget->dapm, kcontrol,
 					msm_route_ec_ref_rx, e, update);
@@ -5805,9 +6575,9 @@ static int msm_routing_ext_ec_get(struct snd_kcontrol *kcontrol,
 {
 	pr_debug("%s: ext_ec_ref_rx  = %x\n", __func__, msm_route_ext_ec_ref);
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	ucontrol->value.integer.value[0] = msm_route_ext_ec_ref;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 	return 0;
 }
 
@@ -5828,7 +6598,7 @@ static int msm_routing_ext_ec_put(struct snd_kcontrol *kcontrol,
 		return -EINVAL;
 	}
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	msm_route_ext_ec_ref = ucontrol->value.integer.value[0];
 
 	switch (msm_route_ext_ec_ref) {
@@ -5873,12 +6643,12 @@ static int msm_routing_ext_ec_put(struct snd_kcontrol *kcontrol,
 		 __func__, msm_route_ext_ec_ref, ext_ec_ref_port_id, state);
 
 	if (!voc_set_ext_ec_ref_port_id(ext_ec_ref_port_id, state)) {
-		mutex_unlock(&routing_lock);
+		msm_routing_unlock();
 		snd_soc_dapm_mux_update_power(widget->dapm, kcontrol, mux, e,
 						update);
 	} else {
 		ret = -EINVAL;
-		mutex_unlock(&routing_lock);
+		msm_routing_unlock();
 	}
 	return ret;
 }
@@ -22559,12 +23329,12 @@ static int msm_routing_aanc_noise_level_put(struct snd_kcontrol *kcontrol,
 {
 	int ret = 0;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	aanc_level = ucontrol->value.integer.value[0];
 	pr_debug("%s: value: %ld\n",
 		 __func__, ucontrol->value.integer.value[0]);
 	ret = afe_set_aanc_noise_level(aanc_level);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 
 	return ret;
 }
@@ -22730,7 +23500,7 @@ static int msm_routing_put_app_type_gain_control(struct snd_kcontrol *kcontrol,
 	port_type = (dir == SESSION_TYPE_RX) ? MSM_AFE_PORT_TYPE_RX :
 					       MSM_AFE_PORT_TYPE_TX;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	for (be_id = 0; be_id < MSM_BACKEND_DAI_MAX; be_id++) {
 		if (is_be_dai_extproc(be_id))
 			continue;
@@ -22758,7 +23528,7 @@ static int msm_routing_put_app_type_gain_control(struct snd_kcontrol *kcontrol,
 			}
 		}
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return ret ? -EINVAL : 0;
 }
 
@@ -22808,7 +23578,7 @@ static int msm_routing_put_module_cfg_control(struct snd_kcontrol *kcontrol,
 
 	packed_param_size = 0;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	for (be_id = 0; be_id < MSM_BACKEND_DAI_MAX; be_id++) {
 		if (is_be_dai_extproc(be_id))
 			continue;
@@ -22858,7 +23628,7 @@ static int msm_routing_put_module_cfg_control(struct snd_kcontrol *kcontrol,
 		}
 	}
 done:
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	kfree(packed_params);
 	return ret;
 }
@@ -22876,7 +23646,7 @@ static int msm_routing_get_lsm_app_type_cfg_control(
 				kcontrol->private_value)->shift;
 	int i = 0, j = 0;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
 	ucontrol->value.integer.value[i] = num_app_cfg_types;
 
 	for (j = 0; j < num_app_cfg_types; ++j) {
@@ -22890,7 +23660,7 @@ static int msm_routing_get_lsm_app_type_cfg_control(
 			ucontrol->value.integer.value[++i] =
 				lsm_app_type_cfg[j].num_out_channels;
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 	return 0;
 }
 
@@ -22902,11 +23672,11 @@ static int msm_routing_put_lsm_app_type_cfg_control(
 				kcontrol->private_value)->shift;
 	int i = 0, j;
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	if (ucontrol->value.integer.value[0] > MAX_APP_TYPES) {
 		pr_err("%s: number of app types exceed the max supported\n",
 			__func__);
-		mutex_unlock(&routing_lock);
+		msm_routing_unlock();
 		return -EINVAL;
 	}
 
@@ -22926,7 +23696,7 @@ static int msm_routing_put_lsm_app_type_cfg_control(
 			lsm_app_type_cfg[j].num_out_channels =
 				ucontrol->value.integer.value[i++];
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return 0;
 }
 
@@ -23664,7 +24434,7 @@ static int spkr_prot_put_vi_lch_port(struct snd_kcontrol *kcontrol,
 
 	pr_debug("%s item is %d\n", __func__,
 		   ucontrol->value.enumerated.item[0]);
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	item = ucontrol->value.enumerated.item[0];
 	if (item < e->items) {
 		pr_debug("%s RX DAI ID %d TX DAI id %d\n",
@@ -23688,7 +24458,7 @@ static int spkr_prot_put_vi_lch_port(struct snd_kcontrol *kcontrol,
 		pr_err("%s item value is out of range item\n", __func__);
 		ret = -EINVAL;
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return ret;
 }
 
@@ -23701,7 +24471,7 @@ static int spkr_prot_put_vi_rch_port(struct snd_kcontrol *kcontrol,
 
 	pr_debug("%s item is %d\n", __func__,
 			ucontrol->value.enumerated.item[0]);
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	item = ucontrol->value.enumerated.item[0];
 	if (item < e->items) {
 		pr_debug("%s RX DAI ID %d TX DAI id %d\n",
@@ -23727,7 +24497,7 @@ static int spkr_prot_put_vi_rch_port(struct snd_kcontrol *kcontrol,
 		pr_err("%s item value is out of range item\n", __func__);
 		ret = -EINVAL;
 	}
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return ret;
 }
 
@@ -29812,47 +30582,55 @@ static int msm_pcm_routing_hw_params(struct snd_pcm_substream *substream,
 		return -EINVAL;
 	}
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock_shared();
+	msm_routing_lock_be(be_id);
 	msm_bedais[be_id].sample_rate = params_rate(params);
 	msm_bedais[be_id].channel = params_channels(params);
 	msm_bedais[be_id].format = params_format(params);
 	pr_debug("%s: BE Sample Rate (%d) format (%d) BE id %d\n",
 		__func__, msm_bedais[be_id].sample_rate,
 		msm_bedais[be_id].format, be_id);
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_be(be_id);
+	msm_routing_unlock_shared();
 	return 0;
 }
 
-static int msm_pcm_routing_close(struct snd_pcm_substream *substream)
+static int __msm_pcm_routing_close(unsigned int be_id, int stream)
 {
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	unsigned int be_id = rtd->dai_link->id;
 	int i, session_type, path_type, topology;
 	struct msm_pcm_routing_bdai_data *bedai;
 	struct msm_pcm_routing_fdai_data *fdai;
 
-	pr_debug("%s: substream->pcm->id:%s\n",
-		 __func__, substream->pcm->id);
-
 	if (be_id >= MSM_BACKEND_DAI_MAX) {
 		pr_err("%s: unexpected BE id %d\n", __func__, be_id);
 		return -EINVAL;
 	}
 
 	bedai = &msm_bedais[be_id];
-	session_type = (substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
+	session_type = (stream == SNDRV_PCM_STREAM_PLAYBACK ?
 		0 : 1);
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK)
 		path_type = ADM_PATH_PLAYBACK;
 	else
 		path_type = ADM_PATH_LIVE_REC;
 
-	mutex_lock(&routing_lock);
-	for_each_set_bit(i, &bedai->fe_sessions[0], MSM_FRONTEND_DAI_MAX) {
+	msm_routing_lock_shared();
+	/* Keep FE paths from opening new copps on this BE */
+	msm_routing_lock_be(be_id);
+	bedai->active = 0;
+	msm_routing_unlock_be(be_id);
+
+	/*
+	 * Walk the copp map rather than fe_sessions, a mixer put may clear
+	 * the route while this BE is inactive and leave its copp to us.
+	 */
+	for (i = 0; i < MSM_FRONTEND_DAI_MAX; i++) {
 		if (!is_mm_lsm_fe_id(i))
 			continue;
+		msm_routing_lock_fe(i);
+		msm_routing_lock_be(be_id);
 		fdai = &fe_dai_map[i][session_type];
-		if (fdai->strm_id != INVALID_SESSION) {
+		if (session_copp_map[i][session_type][be_id]) {
 			int idx;
 			int port_id;
 			unsigned long copp =
@@ -29861,12 +30639,8 @@ static int msm_pcm_routing_close(struct snd_pcm_substream *substream)
 				if (test_bit(idx, &copp))
 					break;
 
-			if (idx >= MAX_COPPS_PER_PORT) {
-				pr_debug("%s: copp idx is invalid, exiting\n",
-								__func__);
-				continue;
-			}
-			fdai->be_srate = bedai->sample_rate;
+			if (fdai->strm_id != INVALID_SESSION)
+				fdai->be_srate = bedai->sample_rate;
 			port_id = get_port_id(bedai->port_id);
 			topology = adm_get_topology_for_port_copp_idx(port_id,
 								     idx);
@@ -29882,20 +30656,42 @@ static int msm_pcm_routing_close(struct snd_pcm_substream *substream)
 				msm_pcm_routing_deinit_pp(port_id,
 							  topology);
 		}
+		msm_routing_unlock_be(be_id);
+		msm_routing_unlock_fe(i);
 	}
 
-	bedai->active = 0;
+	msm_routing_lock_be(be_id);
 	bedai->sample_rate = 0;
 	bedai->channel = 0;
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_be(be_id);
+	msm_routing_unlock_shared();
 
 	return 0;
 }
 
-static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
+static int msm_pcm_routing_be_close(unsigned int be_id, int stream)
+{
+	struct msm_routing_op op;
+	int ret;
+
+	msm_routing_op_begin(&op);
+	ret = __msm_pcm_routing_close(be_id, stream);
+	msm_routing_op_end(ROUTING_OP_BE_CLOSE, &op);
+	return ret;
+}
+
+static int msm_pcm_routing_close(struct snd_pcm_substream *substream)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	unsigned int be_id = rtd->dai_link->id;
+
+	pr_debug("%s: substream->pcm->id:%s\n",
+		 __func__, substream->pcm->id);
+
+	return msm_pcm_routing_be_close(rtd->dai_link->id, substream->stream);
+}
+
+static int __msm_pcm_routing_prepare(unsigned int be_id, int stream)
+{
 	int i, path_type, topology;
 	int session_type = INVALID_SESSION;
 	struct msm_pcm_routing_bdai_data *bedai;
@@ -29905,9 +30701,7 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 	u32 session_id;
 	struct media_format_info voc_be_media_format;
 	bool is_lsm;
-
-	pr_debug("%s: substream->pcm->id:%s\n",
-		 __func__, substream->pcm->id);
+	DECLARE_BITMAP(fe_sessions, MSM_FRONTEND_DAI_MAX);
 
 	if (be_id >= MSM_BACKEND_DAI_MAX) {
 		pr_err("%s: unexpected BE id %d\n", __func__, be_id);
@@ -29916,9 +30710,12 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 
 	bedai = &msm_bedais[be_id];
 
-	mutex_lock(&routing_lock);
-	if (bedai->active == 1)
+	msm_routing_lock_shared();
+	msm_routing_lock_be(be_id);
+	if (bedai->active == 1) {
+		msm_routing_unlock_be(be_id);
 		goto done; /* Ignore prepare if back-end already active */
+	}
 
 	/* AFE port is not active at this point. However, still
 	 * go ahead setting active flag under the notion that
@@ -29926,16 +30723,21 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 	 * is started.
 	 */
 	bedai->active = 1;
+	/* walked without the BE lock, each FE is rechecked under it below */
+	bitmap_copy(fe_sessions, &bedai->fe_sessions[0], MSM_FRONTEND_DAI_MAX);
+	msm_routing_unlock_be(be_id);
 
-	for_each_set_bit(i, &bedai->fe_sessions[0], MSM_FRONTEND_DAI_MAX) {
+	for_each_set_bit(i, fe_sessions, MSM_FRONTEND_DAI_MAX) {
 		if (!(is_mm_lsm_fe_id(i) &&
 				route_check_fe_id_adm_support(i)))
 			continue;
 
-		session_type = (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) ?
+		msm_routing_lock_fe(i);
+		msm_routing_lock_be(be_id);
+		session_type = (stream == SNDRV_PCM_STREAM_PLAYBACK) ?
 						SESSION_TYPE_RX : SESSION_TYPE_TX;
 		fdai = &fe_dai_map[i][session_type];
-		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
 			if (fdai->passthr_mode != LEGACY_PCM)
 				path_type = ADM_PATH_COMPRESSED_RX;
 			else
@@ -29950,7 +30752,13 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 
 		is_lsm = (i >= MSM_FRONTEND_DAI_LSM1) &&
 				 (i <= MSM_FRONTEND_DAI_LSM8);
-		if (fdai->strm_id != INVALID_SESSION) {
+		/*
+		 * Once active is set, FE register and mixer put open copps
+		 * on this BE themselves; skip sessions they already did.
+		 */
+		if (fdai->strm_id != INVALID_SESSION &&
+		    test_bit(i, &bedai->fe_sessions[0]) &&
+		    !session_copp_map[i][session_type][be_id]) {
 			int app_type, app_type_idx, copp_idx, acdb_dev_id;
 			int port_id = get_port_id(bedai->port_id);
 
@@ -30024,7 +30832,9 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 			if ((copp_idx < 0) ||
 				(copp_idx >= MAX_COPPS_PER_PORT)) {
 				pr_err("%s: adm open failed\n", __func__);
-				mutex_unlock(&routing_lock);
+				msm_routing_unlock_be(be_id);
+				msm_routing_unlock_fe(i);
+				msm_routing_unlock_shared();
 				return -EINVAL;
 			}
 			pr_debug("%s: setting idx bit of fe:%d, type: %d, be:%d\n",
@@ -30039,21 +30849,24 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 					bedai->sample_rate);
 
 			msm_pcm_routing_build_matrix(i, session_type, path_type,
-				fdai->perf_mode, fdai->passthr_mode);
+				fdai->perf_mode, fdai->passthr_mode, be_id);
 			if ((fdai->perf_mode == LEGACY_PCM_MODE) &&
 				(fdai->passthr_mode == LEGACY_PCM))
 				msm_pcm_routing_cfg_pp(port_id, copp_idx,
 						       topology, channels);
 		}
+		msm_routing_unlock_be(be_id);
+		msm_routing_unlock_fe(i);
 	}
 
+	msm_routing_lock_be(be_id);
 	for_each_set_bit(i, &bedai->fe_sessions[0], MSM_FRONTEND_DAI_MAX) {
 		session_id = msm_pcm_routing_get_voc_sessionid(i);
 		if (session_id) {
 			pr_debug("%s voice session_id: 0x%x\n", __func__,
 				 session_id);
 
-			if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			if (stream == SNDRV_PCM_STREAM_PLAYBACK)
 				voc_path_type = RX_PATH;
 			else
 				voc_path_type = TX_PATH;
@@ -30099,13 +30912,36 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 			 voc_be_media_format.bits_per_sample,
 			 voc_be_media_format.sample_rate);
 	}
+	msm_routing_unlock_be(be_id);
 
 done:
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock_shared();
 
 	return 0;
 }
 
+static int msm_pcm_routing_be_prepare(unsigned int be_id, int stream)
+{
+	struct msm_routing_op op;
+	int ret;
+
+	msm_routing_op_begin(&op);
+	ret = __msm_pcm_routing_prepare(be_id, stream);
+	msm_routing_op_end(ROUTING_OP_BE_PREPARE, &op);
+	return ret;
+}
+
+static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+
+	pr_debug("%s: substream->pcm->id:%s\n",
+		 __func__, substream->pcm->id);
+
+	return msm_pcm_routing_be_prepare(rtd->dai_link->id,
+					  substream->stream);
+}
+
 static int msm_routing_send_device_pp_params(int port_id, int copp_idx,
 					     int fe_id)
 {
@@ -30529,7 +31365,7 @@ static int msm_routing_stereo_channel_reverse_control_put(
 
 	swap_ch = ucontrol->value.integer.value[0];
 
-	mutex_lock(&routing_lock);
+	msm_routing_lock();
 	for (be_index = 0; be_index < MSM_BACKEND_DAI_MAX; be_index++) {
 		port_id = msm_bedais[be_index].port_id;
 		if (!msm_bedais[be_index].active)
@@ -30557,7 +31393,7 @@ static int msm_routing_stereo_channel_reverse_control_put(
 		}
 	}
 done:
-	mutex_unlock(&routing_lock);
+	msm_routing_unlock();
 	return ret;
 }
 
@@ -30718,6 +31554,9 @@ static int msm_routing_probe(struct snd_soc_component *component)
 	snd_soc_add_component_controls(component, pll_clk_drift_controls,
 				      ARRAY_SIZE(pll_clk_drift_controls));
 
+	snd_soc_add_component_controls(component, audio_mixer_txn_controls,
+				      ARRAY_SIZE(audio_mixer_txn_controls));
+
 	return 0;
 }
 
@@ -30873,9 +31712,77 @@ err:
 	return ret;
 }
 
+#ifdef CONFIG_MSM_QDSP6_APR_LOOPBACK
+/*
+ * Entry points for msm-pcm-routing-bench.c. They run the BE prepare and
+ * close paths and the mixer paths the sound card would, so scenarios
+ * can be driven on the loopback transport without a card.
+ */
+int msm_routing_bench_be_start(int be_id, int stream, u32 rate,
+			       u32 channels, u32 format)
+{
+	if (be_id < 0 || be_id >= MSM_BACKEND_DAI_MAX)
+		return -EINVAL;
+
+	msm_routing_lock_shared();
+	msm_routing_lock_be(be_id);
+	msm_bedais[be_id].sample_rate = rate;
+	msm_bedais[be_id].channel = channels;
+	msm_bedais[be_id].format = format;
+	msm_routing_unlock_be(be_id);
+	msm_routing_unlock_shared();
+
+	return msm_pcm_routing_be_prepare(be_id, stream);
+}
+
+int msm_routing_bench_be_stop(int be_id, int stream)
+{
+	if (be_id < 0 || be_id >= MSM_BACKEND_DAI_MAX)
+		return -EINVAL;
+
+	return msm_pcm_routing_be_close(be_id, stream);
+}
+
+void msm_routing_bench_route(int be_id, int fe_id, bool set)
+{
+	msm_pcm_routing_process_audio(be_id, fe_id, set);
+}
+
+void msm_routing_bench_route_voice(int be_id, int fe_id, bool set)
+{
+	if (be_id < 0 || be_id >= MSM_BACKEND_DAI_MAX ||
+	    fe_id < 0 || fe_id >= MSM_FRONTEND_DAI_MAX)
+		return;
+
+	msm_pcm_routing_process_voice(be_id, fe_id, set);
+}
+
+/* Summed hold time of the routing locks, see msm_routing_lock_stats */
+u64 msm_routing_bench_lock_hold_ns(void)
+{
+	u64 hold_ns = 0;
+	int i;
+
+	for (i = 0; i < ROUTING_LOCK_MAX; i++)
+		hold_ns += atomic64_read(&routing_lock_stats[i].hold_ns);
+	return hold_ns;
+}
+#endif
+
 int __init msm_soc_routing_platform_init(void)
 {
-	mutex_init(&routing_lock);
+	int i;
+
+	for (i = 0; i < MSM_FRONTEND_DAI_MAX; i++)
+		mutex_init(&fe_dai_lock[i]);
+	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++)
+		mutex_init(&be_dai_lock[i]);
+	debugfs_routing_lock_stats = debugfs_create_file(
+				"msm_routing_lock_stats", 0644, NULL, NULL,
+				&msm_routing_lock_stats_ops);
+	debugfs_routing_op_stats = debugfs_create_file(
+				"msm_routing_op_stats", 0644, NULL, NULL,
+				&msm_routing_op_stats_ops);
 	if (msm_routing_init_cal_data())
 		pr_err("%s: could not init cal data!\n", __func__);
 
@@ -30890,10 +31797,18 @@ int __init msm_soc_routing_platform_init(void)
 
 void msm_soc_routing_platform_exit(void)
 {
+	int i;
+
 	msm_routing_delete_cal_data();
 	memset(&be_dai_name_table, 0, sizeof(be_dai_name_table));
-	mutex_destroy(&routing_lock);
 	platform_driver_unregister(&msm_routing_pcm_driver);
+	cancel_delayed_work_sync(&routing_txn_work);
+	debugfs_remove(debugfs_routing_op_stats);
+	debugfs_remove(debugfs_routing_lock_stats);
+	for (i = 0; i < MSM_BACKEND_DAI_MAX; i++)
+		mutex_destroy(&be_dai_lock[i]);
+	for (i = 0; i < MSM_FRONTEND_DAI_MAX; i++)
+		mutex_destroy(&fe_dai_lock[i]);
 }
 
 MODULE_DESCRIPTION("MSM routing platform driver");
@@ -655,4 +655,14 @@ int msm_pcm_routing_set_channel_mixer_runtime(
 	int be_id, int session_id,
 	int session_type,
 	struct msm_pcm_channel_mixer *params);
+
+#ifdef CONFIG_MSM_QDSP6_APR_LOOPBACK
+/* Routing benchmark on the loopback APR transport */
+int msm_routing_bench_be_start(int be_id, int stream, u32 rate,
+			       u32 channels, u32 format);
+int msm_routing_bench_be_stop(int be_id, int stream);
+void msm_routing_bench_route(int be_id, int fe_id, bool set);
+void msm_routing_bench_route_voice(int be_id, int fe_id, bool set);
+u64 msm_routing_bench_lock_hold_ns(void);
+#endif
 #endif /*_MSM_PCM_H*/
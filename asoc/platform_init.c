@@ -27,12 +27,14 @@ static int __init audio_platform_init(void)
 	msm_pcm_voice_init();
 	msm_pcm_voip_init();
 	msm_transcode_loopback_init();
+	msm_routing_bench_init();
 
 	return 0;
 }
 
 static void audio_platform_exit(void)
 {
+	msm_routing_bench_exit();
 	msm_transcode_loopback_exit();
 	msm_pcm_voip_exit();
 	msm_pcm_voice_exit();
@@ -55,5 +55,18 @@ static inline void msm_dai_slim_exit(void)
 {
 };
 #endif
+
+#if IS_ENABLED(CONFIG_MSM_QDSP6_APR_LOOPBACK)
+int msm_routing_bench_init(void);
+void msm_routing_bench_exit(void);
+#else
+static inline int msm_routing_bench_init(void)
+{
+	return 0;
+};
+static inline void msm_routing_bench_exit(void)
+{
+};
+#endif
 #endif
 
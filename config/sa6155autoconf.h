@@ -27,3 +27,4 @@
 #define CONFIG_SND_SOC_SA6155 1
 #define CONFIG_SOUNDWIRE_MSTR_CTRL 1
 #define CONFIG_SND_EVENT 1
+#define CONFIG_SND_SOC_QDSP6V2_ASM_MAX_SESSIONS 32
@@ -8,8 +8,11 @@
 #include <linux/miscdevice.h>
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
+#include <linux/jhash.h>
 #include <dsp/audio_cal_utils.h>
 
+static atomic_t cal_version = ATOMIC_INIT(0);
+
 static int unmap_memory(struct cal_type_data *cal_type,
 			struct cal_block_data *cal_block);
 
@@ -948,6 +951,31 @@ done:
 }
 EXPORT_SYMBOL(cal_utils_dealloc_cal);
 
+/*
+ * Userspace sets the same calibration again on every device switch.
+ * Hash what the DSP would be sent and hand out a new version only when
+ * it differs, so that clients can tell what the DSP already holds.
+ */
+static void update_cal_version(struct cal_block_data *cal_block,
+			       size_t cal_info_size)
+{
+	size_t size = cal_block->cal_data.size;
+	u32 hash;
+
+	hash = jhash(&size, sizeof(size), 0);
+	if (cal_block->cal_data.kvaddr && size <= cal_block->map_data.map_size)
+		hash = jhash(cal_block->cal_data.kvaddr, size, hash);
+	hash = jhash(cal_block->cal_info, cal_info_size, hash);
+
+	if (cal_block->cal_version && cal_block->cal_hash == hash)
+		return;
+
+	cal_block->cal_hash = hash;
+	do {
+		cal_block->cal_version = atomic_inc_return(&cal_version);
+	} while (!cal_block->cal_version);
+}
+
 /**
  * cal_utils_set_cal
  *
@@ -1033,6 +1061,9 @@ int cal_utils_set_cal(size_t data_size, void *data,
 		((uint8_t *)data + sizeof(struct audio_cal_type_basic)),
 		data_size - sizeof(struct audio_cal_type_basic));
 
+	update_cal_version(cal_block,
+		data_size - sizeof(struct audio_cal_type_basic));
+
 	/* reset buffer stale flag */
 	cal_block->cal_stale = false;
 
@@ -10,6 +10,7 @@
 static int __init audio_q6_init(void)
 {
 	adsp_err_init();
+	q6common_init();
 	audio_cal_init();
 	rtac_init();
 	adm_init();
@@ -44,6 +45,7 @@ static void __exit audio_q6_exit(void)
 	adm_exit();
 	rtac_exit();
 	audio_cal_exit();
+	q6common_exit();
 	adsp_err_exit();
 	voice_mhi_exit();
 }
@@ -6,6 +6,7 @@
 #ifndef __Q6_INIT_H__
 #define __Q6_INIT_H__
 int adsp_err_init(void);
+int q6common_init(void);
 int adm_init(void);
 int afe_init(void);
 int q6asm_init(void);
@@ -54,6 +55,7 @@ void q6asm_exit(void);
 void afe_exit(void);
 void adm_exit(void);
 void adsp_err_exit(void);
+void q6common_exit(void);
 #if IS_ENABLED(CONFIG_WCD9XXX_CODEC_CORE)
 int audio_slimslave_init(void);
 void audio_slimslave_exit(void);
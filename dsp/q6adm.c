@@ -9,6 +9,10 @@
 #include <linux/jiffies.h>
 #include <linux/uaccess.h>
 #include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
 #include <sound/asound.h>
 #include <dsp/msm-dts-srs-tm-config.h>
 #include <dsp/apr_audio-v2.h>
@@ -25,6 +29,24 @@
 
 #define RESET_COPP_ID 99
 #define INVALID_COPP_ID 0xFF
+/* Token bit marking commands sent through adm_send_batch() */
+#define ADM_TOKEN_BATCH_FLAG (1 << 24)
+/* token bits 25..28 carry (param pool slot + 1) for pooled get/set */
+#define ADM_TOKEN_SLOT_SHIFT 25
+#define ADM_TOKEN_SLOT_MASK 0xF
+
+#define ADM_PARAM_POOL_SLOTS 8
+#define ADM_PARAM_SLOT_SIZE (2 * AUD_PROC_BLOCK_SIZE)
+#define ADM_PARAM_POOL_SIZE (ADM_PARAM_POOL_SLOTS * ADM_PARAM_SLOT_SIZE)
+/* in band set params payloads above this go through the pool */
+#define ADM_PARAM_INBAND_MAX AUD_PROC_BLOCK_SIZE
+/* Packed channel mixer commands kept for reuse */
+#define ADM_CHMIX_CACHE_SLOTS 4
+/* rule, channel counts, both channel maps and the full weight matrix */
+#define ADM_CHMIX_PARAM_MAX (2 * (4 + 2 * ADM_MAX_CHANNELS + \
+				  ADM_MAX_CHANNELS * ADM_MAX_CHANNELS))
+/* Most calibration blocks sent to one COPP in send_adm_cal() */
+#define ADM_CAL_BATCH_MAX 3
 /* Used for inband payload copy, max size is 4k */
 /* 3 is to account for module, instance & param ID in payload */
 #define ADM_GET_PARAMETER_LENGTH (4096 - APR_HDR_SIZE - 3 * sizeof(uint32_t))
@@ -44,12 +66,65 @@
 
 #define SESSION_TYPE_RX 0
 
+/*
+ * Closed COPPs are kept open on the DSP for this long so that a matching
+ * adm_open() can revive them without an open and calibration round trip.
+ */
+static unsigned int adm_copp_cache_ms = 2000;
+module_param(adm_copp_cache_ms, uint, 0664);
+MODULE_PARM_DESC(adm_copp_cache_ms, "Closed COPP grace period, 0 disables");
+
+/* Upper bound on COPPs parked across all ports */
+static unsigned int adm_copp_cache_max = MAX_COPPS_PER_PORT;
+module_param(adm_copp_cache_max, uint, 0664);
+MODULE_PARM_DESC(adm_copp_cache_max, "Most closed COPPs kept on the DSP");
+
 /* ENUM for adm_status */
 enum adm_cal_status {
 	ADM_STATUS_CALIBRATION_REQUIRED = 0,
 	ADM_STATUS_MAX,
 };
 
+/* Parked COPP, still open on the DSP with cnt == 0 */
+struct adm_copp_warm {
+	unsigned long expires;	/* jiffies, 0 when not parked */
+	int port_id;
+	int path;
+	u32 cal_gen;		/* copp_cache_cal_gen when parked */
+	bool pinned;		/* opened with one-shot settings, never parked */
+};
+
+/* Channel mixer payload a COPP last acknowledged, gen 0 when unknown */
+struct adm_chmix_applied {
+	u32 gen;
+	int session_id;
+	int session_type;
+};
+
+struct adm_copp_cache_stats {
+	atomic_t hit;
+	atomic_t miss;
+	atomic_t expired;
+	atomic_t evicted;
+};
+
+/* Commands sent to the DSP, by kind, for msm_adm_cmd_stats */
+enum {
+	ADM_CMD_STAT_OPEN,
+	ADM_CMD_STAT_CLOSE,
+	ADM_CMD_STAT_MATRIX_MAP,
+	ADM_CMD_STAT_SET_PARAMS,
+	ADM_CMD_STAT_GET_PARAMS,
+	ADM_CMD_STAT_MEM_MAP,
+	ADM_CMD_STAT_OTHER,
+	ADM_CMD_STAT_MAX,
+};
+
+static const char * const adm_cmd_stat_names[ADM_CMD_STAT_MAX] = {
+	"open", "close", "matrix_map", "set_params", "get_params", "mem_map",
+	"other",
+};
+
 struct adm_copp {
 
 	atomic_t id[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
@@ -68,12 +143,65 @@ struct adm_copp {
 	atomic_t adm_delay_stat[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	uint32_t adm_delay[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
 	unsigned long adm_status[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+	atomic_t batch_cnt[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+	atomic_t batch_stat[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+	/* serializes copp open/close on one port */
+	struct mutex lock[AFE_MAX_PORTS];
+	struct adm_copp_warm warm[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+	struct adm_chmix_applied chmix[AFE_MAX_PORTS][MAX_COPPS_PER_PORT];
+};
+
+/*
+ * A fully packed ADM_CMD_SET_PSPD_MTMX_STRTR_PARAMS_V5 command for one
+ * channel mixer configuration. Only the session and COPP addressing
+ * fields are patched before it is sent again.
+ */
+struct adm_chmix_entry {
+	/* jhash of the packed coefficient param, for a cheap lookup */
+	u32 hash;
+	u32 param_size;
+	/* bytes allocated for pkt */
+	u32 alloc_size;
+	/* unique per packed payload, 0 for an empty entry */
+	u32 gen;
+	/* cache tick of the last use, the oldest entry is reused */
+	u32 used;
+	struct adm_cmd_set_pspd_mtmx_strtr_params_v5 *pkt;
 };
 
-struct source_tracking_data {
+struct adm_chmix_cache {
+	/* guards the entries and scratch until the command is sent */
+	struct mutex lock;
+	/* coefficient param is packed here first to look it up */
+	u16 *scratch;
+	u32 tick;
+	u32 gen;
+	struct adm_chmix_entry entry[ADM_CHMIX_CACHE_SLOTS];
+	atomic_t hit;
+	atomic_t miss;
+	atomic_t skipped;
+};
+
+/*
+ * Shared memory for out of band get/set params, allocated and mapped to
+ * the DSP once and carved into fixed size slots, one per request in
+ * flight. Each slot completes on its own status and wait queue, so
+ * concurrent queries on the same COPP do not share copp.stat.
+ */
+struct adm_param_pool {
 	struct dma_buf *dma_buf;
 	struct param_outband memmap;
-	int apr_cmd_status;
+	/* serializes allocation and mapping of the pool */
+	struct mutex lock;
+	/* guards in_use, leaked and ready */
+	spinlock_t slot_lock;
+	unsigned long in_use;
+	/* mapped to the DSP and handing out slots */
+	bool ready;
+	/* slots whose command timed out, reclaimed on late reply or SSR */
+	unsigned long leaked;
+	atomic_t stat[ADM_PARAM_POOL_SLOTS];
+	wait_queue_head_t wait[ADM_PARAM_POOL_SLOTS];
 };
 
 struct adm_ctl {
@@ -81,11 +209,25 @@ struct adm_ctl {
 
 	struct adm_copp copp;
 
+	struct delayed_work copp_cache_work;
+	atomic_t copp_cache_cnt;
+	/* bumped on every ADM cal update, parked COPPs hold older cal */
+	atomic_t copp_cache_cal_gen;
+	struct adm_copp_cache_stats copp_cache_stats;
+
+	atomic64_t cmd_stats[ADM_CMD_STAT_MAX];
+	atomic64_t cmd_total;
+	/* never reset, adm_get_cmd_count() deltas are taken on it */
+	atomic64_t cmd_seq;
+
 	atomic_t matrix_map_stat;
 	wait_queue_head_t matrix_map_wait;
+	struct mutex matrix_map_lock;
 
 	atomic_t adm_stat;
 	wait_queue_head_t adm_wait;
+	/* one adm_stat command in flight, also guards mem_map_index */
+	struct mutex adm_stat_lock;
 
 	struct cal_type_data *cal_data[ADM_MAX_CAL_TYPES];
 
@@ -93,9 +235,12 @@ struct adm_ctl {
 	atomic_t mem_map_index;
 
 	struct param_outband outband_memmap;
-	struct source_tracking_data sourceTrackingData;
+	struct adm_param_pool param_pool;
+	struct adm_chmix_cache chmix_cache;
 
 	int set_custom_topology;
+	/* cal_version of the custom topology the DSP holds */
+	uint32_t custom_top_version;
 	int ec_ref_rx;
 	int num_ec_ref_rx_chans;
 	int ec_ref_rx_bit_width;
@@ -205,7 +350,8 @@ int adm_get_default_copp_idx(int port_id)
 	pr_debug("%s: port_idx:%d\n", __func__, port_idx);
 	for (idx = 0; idx < MAX_COPPS_PER_PORT; idx++) {
 		if (atomic_read(&this_adm.copp.id[port_idx][idx]) !=
-			RESET_COPP_ID)
+			RESET_COPP_ID &&
+		    !READ_ONCE(this_adm.copp.warm[port_idx][idx].expires))
 			return idx;
 	}
 	return -EINVAL;
@@ -480,12 +626,216 @@ static int adm_populate_channel_weight(u16 *ptr,
 	return 0;
 }
 
+static void adm_count_cmd(uint32_t opcode)
+{
+	int type;
+
+	switch (opcode) {
+	case ADM_CMD_DEVICE_OPEN_V5:
+	case ADM_CMD_DEVICE_OPEN_V6:
+	case ADM_CMD_DEVICE_OPEN_V8:
+		type = ADM_CMD_STAT_OPEN;
+		break;
+	case ADM_CMD_DEVICE_CLOSE_V5:
+		type = ADM_CMD_STAT_CLOSE;
+		break;
+	case ADM_CMD_MATRIX_MAP_ROUTINGS_V5:
+	case ADM_CMD_STREAM_DEVICE_MAP_ROUTINGS_V5:
+		type = ADM_CMD_STAT_MATRIX_MAP;
+		break;
+	case ADM_CMD_SET_PP_PARAMS_V5:
+	case ADM_CMD_SET_PP_PARAMS_V6:
+	case ADM_CMD_SET_PSPD_MTMX_STRTR_PARAMS_V5:
+	case ADM_CMD_SET_PSPD_MTMX_STRTR_PARAMS_V6:
+		type = ADM_CMD_STAT_SET_PARAMS;
+		break;
+	case ADM_CMD_GET_PP_PARAMS_V5:
+	case ADM_CMD_GET_PP_PARAMS_V6:
+		type = ADM_CMD_STAT_GET_PARAMS;
+		break;
+	case ADM_CMD_SHARED_MEM_MAP_REGIONS:
+	case ADM_CMD_SHARED_MEM_UNMAP_REGIONS:
+		type = ADM_CMD_STAT_MEM_MAP;
+		break;
+	default:
+		type = ADM_CMD_STAT_OTHER;
+		break;
+	}
+	atomic64_inc(&this_adm.cmd_stats[type]);
+	atomic64_inc(&this_adm.cmd_total);
+	atomic64_inc(&this_adm.cmd_seq);
+}
+
+static int adm_apr_send_pkt(void *pkt)
+{
+	adm_count_cmd(((struct apr_hdr *) pkt)->opcode);
+	return apr_send_pkt(this_adm.apr, (uint32_t *) pkt);
+}
+
+/**
+ * adm_get_cmd_count -
+ *        Number of commands sent to the ADM service so far
+ *
+ * Lets callers account the DSP commands an operation costs by taking
+ * the difference around it.
+ */
+u64 adm_get_cmd_count(void)
+{
+	return atomic64_read(&this_adm.cmd_seq);
+}
+EXPORT_SYMBOL(adm_get_cmd_count);
+
+/*
+ * Packs the DEFAULT_CHMIXER_PARAM_ID_COEFF param for one input of
+ * ch_mixer into ptr. First 8 bytes are 4 bytes as rule number, 2 bytes
+ * as output channel and 2 bytes as input channel, followed by the output
+ * and input channel mappings and the channel mixer weighting
+ * coefficients. ptr holds param_size bytes, a multiple of 4.
+ */
+static int adm_chmix_pack(u16 *ptr, u32 param_size, int port_idx,
+			  int session_type,
+			  struct msm_pcm_channel_mixer *ch_mixer,
+			  int channel_index)
+{
+	struct adm_device_endpoint_payload ep_params = {0, 0, 0, {0}};
+	int index, i, path_type;
+
+	memset(ptr, 0, param_size);
+	ptr[0] = ch_mixer->rule;
+	ptr[2] = ch_mixer->output_channel;
+	ptr[3] = ch_mixer->input_channels[channel_index];
+	index = 4;
+
+	path_type = (session_type == SESSION_TYPE_RX) ?
+				ADM_PATH_PLAYBACK : ADM_PATH_LIVE_REC;
+
+	if (ch_mixer->override_out_ch_map) {
+		memcpy(&ptr[index], &ch_mixer->out_ch_map,
+			ch_mixer->output_channel * sizeof(uint16_t));
+		index += ch_mixer->output_channel;
+	} else {
+		ep_params.dev_num_channel = ch_mixer->output_channel;
+		adm_arrange_mch_map_v8(&ep_params, path_type,
+				       ep_params.dev_num_channel, port_idx);
+		for (i = 0; i < ch_mixer->output_channel; i++)
+			ptr[index++] = ep_params.dev_channel_mapping[i];
+	}
+
+	if (ch_mixer->override_in_ch_map) {
+		memcpy(&ptr[index], &ch_mixer->in_ch_map,
+			ch_mixer->input_channel * sizeof(uint16_t));
+		index += ch_mixer->input_channel;
+	} else {
+		ep_params.dev_num_channel = ch_mixer->input_channels[channel_index];
+		adm_arrange_mch_map_v8(&ep_params, path_type,
+				       ep_params.dev_num_channel, port_idx);
+		for (i = 0; i < ch_mixer->input_channels[channel_index]; i++)
+			ptr[index++] = ep_params.dev_channel_mapping[i];
+	}
+
+	return adm_populate_channel_weight(&ptr[index], ch_mixer,
+					   channel_index);
+}
+
+/*
+ * Returns the cached command carrying the param packed in the scratch
+ * buffer, packing a new one in place of the least recently used entry
+ * on a miss. Called with chmix_cache.lock held.
+ */
+static struct adm_chmix_entry *adm_chmix_get(struct adm_chmix_cache *cache,
+					     u32 param_size)
+{
+	struct adm_chmix_entry *entry, *victim = NULL;
+	struct param_hdr_v1 data_v5;
+	u32 hash = jhash(cache->scratch, param_size, 0);
+	int sz, i;
+
+	for (i = 0; i < ADM_CHMIX_CACHE_SLOTS; i++) {
+		entry = &cache->entry[i];
+		if (entry->gen && entry->hash == hash &&
+		    entry->param_size == param_size &&
+		    !memcmp((u8 *)entry->pkt + sizeof(*entry->pkt) +
+			    sizeof(data_v5), cache->scratch, param_size)) {
+			atomic_inc(&cache->hit);
+			entry->used = ++cache->tick;
+			return entry;
+		}
+		if (!victim || !entry->gen ||
+		    (victim->gen && entry->used < victim->used))
+			victim = entry;
+	}
+
+	atomic_inc(&cache->miss);
+	sz = sizeof(*victim->pkt) +
+	     sizeof(struct default_chmixer_param_id_coeff) +
+	     sizeof(data_v5) + param_size;
+	victim->gen = 0;
+	if (victim->alloc_size < sz) {
+		kfree(victim->pkt);
+		victim->alloc_size = 0;
+		victim->pkt = kzalloc(sz, GFP_KERNEL);
+		if (!victim->pkt)
+			return NULL;
+		victim->alloc_size = sz;
+	}
+
+	/*
+	 * This module is internal to ADSP and cannot be configured with
+	 * an instance id
+	 */
+	data_v5.module_id = MTMX_MODULE_ID_DEFAULT_CHMIXER;
+	data_v5.param_id =  DEFAULT_CHMIXER_PARAM_ID_COEFF;
+	data_v5.reserved = 0;
+	data_v5.param_size = param_size;
+	memcpy((u8 *)victim->pkt + sizeof(*victim->pkt), &data_v5,
+	       sizeof(data_v5));
+	memcpy((u8 *)victim->pkt + sizeof(*victim->pkt) + sizeof(data_v5),
+	       cache->scratch, param_size);
+	/* a reused entry may carry stale bytes in the trailing coeff hdr */
+	memset((u8 *)victim->pkt + sizeof(*victim->pkt) + sizeof(data_v5) +
+	       param_size, 0, sizeof(struct default_chmixer_param_id_coeff));
+
+	victim->pkt->hdr.hdr_field = APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD,
+				APR_HDR_LEN(APR_HDR_SIZE), APR_PKT_VER);
+	victim->pkt->hdr.src_svc = APR_SVC_ADM;
+	victim->pkt->hdr.src_domain = APR_DOMAIN_APPS;
+	victim->pkt->hdr.dest_svc = APR_SVC_ADM;
+	victim->pkt->hdr.dest_domain = APR_DOMAIN_ADSP;
+	victim->pkt->hdr.opcode = ADM_CMD_SET_PSPD_MTMX_STRTR_PARAMS_V5;
+	victim->pkt->hdr.pkt_size = sz;
+	victim->pkt->payload_addr_lsw = 0;
+	victim->pkt->payload_addr_msw = 0;
+	victim->pkt->mem_map_handle = 0;
+	victim->pkt->payload_size =
+		sizeof(struct default_chmixer_param_id_coeff) +
+		sizeof(data_v5) + param_size;
+	victim->pkt->reserved = 0;
+
+	victim->hash = hash;
+	victim->param_size = param_size;
+	victim->used = ++cache->tick;
+	if (!++cache->gen)
+		cache->gen = 1;
+	victim->gen = cache->gen;
+	return victim;
+}
+
+/* Forgets what channel mixer payload a COPP holds */
+static void adm_chmix_invalidate(int port_idx, int copp_idx)
+{
+	WRITE_ONCE(this_adm.copp.chmix[port_idx][copp_idx].gen, 0);
+}
+
 /*
  * adm_programable_channel_mixer
  *
  * Receives port_id, copp_idx, session_id, session_type, ch_mixer
  * and channel_index to send ADM command to mix COPP data.
  *
+ * Packed commands are cached by content, so a configuration seen
+ * recently is sent without being rebuilt, and one the COPP already
+ * holds for this session is not sent at all.
+ *
  * port_id - Passed value, port_id for which backend is wanted
  * copp_idx - Passed value, copp_idx for which COPP is wanted
  * session_id - Passed value, session_id for which session is needed
@@ -498,13 +848,14 @@ int adm_programable_channel_mixer(int port_id, int copp_idx, int session_id,
 				  struct msm_pcm_channel_mixer *ch_mixer,
 				  int channel_index)
 {
-	struct adm_cmd_set_pspd_mtmx_strtr_params_v5 *adm_params = NULL;
-	struct param_hdr_v1 data_v5;
-	int ret = 0, port_idx, sz = 0, param_size = 0;
-	struct adm_device_endpoint_payload ep_params = {0, 0, 0, {0}};
-	u16 *adm_pspd_params;
+	struct adm_chmix_cache *cache = &this_adm.chmix_cache;
+	struct adm_chmix_applied *applied;
+	struct adm_cmd_set_pspd_mtmx_strtr_params_v5 *adm_params;
+	struct adm_chmix_entry *entry;
+	int ret = 0, port_idx, param_size = 0;
+	u32 gen;
 	u16 *ptr;
-	int index = 0, i = 0, path_type = ADM_PATH_PLAYBACK;
+	int index = 0;
 
 	pr_debug("%s: port_id = %d\n", __func__, port_id);
 	port_id = afe_convert_virtual_to_portid(port_id);
@@ -525,8 +876,6 @@ int adm_programable_channel_mixer(int port_id, int copp_idx, int session_id,
 	}
 
 	/*
-	 * First 8 bytes are 4 bytes as rule number, 2 bytes as output
-	 * channel and 2 bytes as input channel.
 	 * 2 * ch_mixer->output_channel means output channel mapping.
 	 * 2 * ch_mixer->input_channels[channel_index]) means input
 	 * channel mapping.
@@ -535,121 +884,75 @@ int adm_programable_channel_mixer(int port_id, int copp_idx, int session_id,
 	 * coefficients.
 	 * param_size needs to be a multiple of 4 bytes.
 	 */
-
 	param_size = 2 * (4 + ch_mixer->output_channel +
 			ch_mixer->input_channels[channel_index] +
 			ch_mixer->input_channels[channel_index] *
 			ch_mixer->output_channel);
 	param_size = roundup(param_size, 4);
-
-	sz = sizeof(struct adm_cmd_set_pspd_mtmx_strtr_params_v5) +
-	     sizeof(struct default_chmixer_param_id_coeff) +
-	     sizeof(struct param_hdr_v1) + param_size;
-	pr_debug("%s: sz = %d\n", __func__, sz);
-	adm_params = kzalloc(sz, GFP_KERNEL);
-	if (!adm_params)
-		return -ENOMEM;
-
-	adm_params->payload_addr_lsw = 0;
-	adm_params->payload_addr_msw = 0;
-	adm_params->mem_map_handle = 0;
-	adm_params->direction = session_type;
-	adm_params->sessionid = session_id;
-	pr_debug("%s: copp_id = %d, session id  %d\n", __func__,
-		atomic_read(&this_adm.copp.id[port_idx][copp_idx]),
-			session_id);
-	adm_params->deviceid = atomic_read(
-				&this_adm.copp.id[port_idx][copp_idx]);
-	adm_params->reserved = 0;
-
-	/*
-	 * This module is internal to ADSP and cannot be configured with
-	 * an instance id
-	 */
-	data_v5.module_id = MTMX_MODULE_ID_DEFAULT_CHMIXER;
-	data_v5.param_id =  DEFAULT_CHMIXER_PARAM_ID_COEFF;
-	data_v5.reserved = 0;
-	data_v5.param_size = param_size;
-	adm_params->payload_size =
-		sizeof(struct default_chmixer_param_id_coeff) +
-		sizeof(struct param_hdr_v1) + data_v5.param_size;
-	adm_pspd_params = (u16 *)((u8 *)adm_params +
-			sizeof(struct adm_cmd_set_pspd_mtmx_strtr_params_v5));
-	memcpy(adm_pspd_params, &data_v5, sizeof(data_v5));
-
-	adm_pspd_params = (u16 *)((u8 *)adm_params +
-			sizeof(struct adm_cmd_set_pspd_mtmx_strtr_params_v5)
-			+ sizeof(data_v5));
-
-	adm_pspd_params[0] = ch_mixer->rule;
-	adm_pspd_params[2] = ch_mixer->output_channel;
-	adm_pspd_params[3] = ch_mixer->input_channels[channel_index];
-	index = 4;
-
-	path_type = (session_type == SESSION_TYPE_RX) ?
-				ADM_PATH_PLAYBACK : ADM_PATH_LIVE_REC;
-
-	if (ch_mixer->override_out_ch_map) {
-		memcpy(&adm_pspd_params[index], &ch_mixer->out_ch_map,
-			ch_mixer->output_channel * sizeof(uint16_t));
-		index += ch_mixer->output_channel;
-	} else {
-		ep_params.dev_num_channel = ch_mixer->output_channel;
-		adm_arrange_mch_map_v8(&ep_params, path_type,
-				       ep_params.dev_num_channel, port_idx);
-		for (i = 0; i < ch_mixer->output_channel; i++)
-			adm_pspd_params[index++] = ep_params.dev_channel_mapping[i];
+	if (param_size > ADM_CHMIX_PARAM_MAX) {
+		pr_err("%s: invalid channel config, param size %d\n",
+			__func__, param_size);
+		return -EINVAL;
 	}
 
-	if (ch_mixer->override_in_ch_map) {
-		memcpy(&adm_pspd_params[index], &ch_mixer->in_ch_map,
-			ch_mixer->input_channel * sizeof(uint16_t));
-		index += ch_mixer->input_channel;
-	} else {
-		ep_params.dev_num_channel = ch_mixer->input_channels[channel_index];
-		adm_arrange_mch_map_v8(&ep_params, path_type,
-				       ep_params.dev_num_channel, port_idx);
-		for (i = 0; i < ch_mixer->input_channels[channel_index]; i++)
-			adm_pspd_params[index++] = ep_params.dev_channel_mapping[i];
+	mutex_lock(&cache->lock);
+	if (!cache->scratch) {
+		ret = -ENOMEM;
+		goto fail_unlock;
 	}
 
-	ret = adm_populate_channel_weight(&adm_pspd_params[index],
-					ch_mixer, channel_index);
+	ret = adm_chmix_pack(cache->scratch, param_size, port_idx,
+			     session_type, ch_mixer, channel_index);
 	if (ret) {
 		pr_err("%s: fail to get channel weight with error %d\n",
 			__func__, ret);
-		goto fail_cmd;
+		goto fail_unlock;
 	}
 
-	adm_params->hdr.hdr_field = APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD,
-				APR_HDR_LEN(APR_HDR_SIZE), APR_PKT_VER);
-	adm_params->hdr.src_svc = APR_SVC_ADM;
-	adm_params->hdr.src_domain = APR_DOMAIN_APPS;
+	entry = adm_chmix_get(cache, param_size);
+	if (!entry) {
+		ret = -ENOMEM;
+		goto fail_unlock;
+	}
+	gen = entry->gen;
+
+	applied = &this_adm.copp.chmix[port_idx][copp_idx];
+	if (READ_ONCE(applied->gen) == gen &&
+	    applied->session_id == session_id &&
+	    applied->session_type == session_type) {
+		pr_debug("%s: port %#x copp %d already holds this config\n",
+			__func__, port_id, copp_idx);
+		atomic_inc(&cache->skipped);
+		goto fail_unlock;
+	}
+
+	adm_params = entry->pkt;
+	adm_params->direction = session_type;
+	adm_params->sessionid = session_id;
+	pr_debug("%s: copp_id = %d, session id  %d\n", __func__,
+		atomic_read(&this_adm.copp.id[port_idx][copp_idx]),
+			session_id);
+	adm_params->deviceid = atomic_read(
+				&this_adm.copp.id[port_idx][copp_idx]);
 	adm_params->hdr.src_port = port_id;
-	adm_params->hdr.dest_svc = APR_SVC_ADM;
-	adm_params->hdr.dest_domain = APR_DOMAIN_ADSP;
 	adm_params->hdr.dest_port =
 			atomic_read(&this_adm.copp.id[port_idx][copp_idx]);
 	adm_params->hdr.token = port_idx << 16 | copp_idx;
-	adm_params->hdr.opcode = ADM_CMD_SET_PSPD_MTMX_STRTR_PARAMS_V5;
-	adm_params->hdr.pkt_size = sz;
-	adm_params->payload_addr_lsw = 0;
-	adm_params->payload_addr_msw = 0;
-	adm_params->mem_map_handle = 0;
-	adm_params->reserved = 0;
 
 	ptr = (u16 *)adm_params;
-	for (index = 0; index < (sz / 2); index++)
+	for (index = 0; index < (adm_params->hdr.pkt_size / 2); index++)
 		pr_debug("%s: adm_params[%d] = 0x%x\n",
 			__func__, index, (unsigned int)ptr[index]);
 
-	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], 0);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *)adm_params);
+	/* APR copies the command, the entry is free once it is sent */
+	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
+	adm_chmix_invalidate(port_idx, copp_idx);
+	ret = adm_apr_send_pkt((uint32_t *)adm_params);
+	mutex_unlock(&cache->lock);
 	if (ret < 0) {
 		pr_err("%s: Set params failed port %d rc %d\n", __func__,
 			port_id, ret);
-		ret = -EINVAL;
-		goto fail_cmd;
+		return -EINVAL;
 	}
 
 	ret = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
@@ -659,13 +962,24 @@ int adm_programable_channel_mixer(int port_id, int copp_idx, int session_id,
 	if (!ret) {
 		pr_err("%s: set params timed out port = %d\n",
 			__func__, port_id);
-		ret = -ETIMEDOUT;
-		goto fail_cmd;
+		return -ETIMEDOUT;
 	}
-	ret = 0;
-fail_cmd:
-	kfree(adm_params);
+	/* a rejected config is not remembered so the next call resends it */
+	if (atomic_read(&this_adm.copp.stat[port_idx][copp_idx]) > 0) {
+		pr_err("%s: DSP returned error[%s]\n", __func__,
+			adsp_err_get_err_str(atomic_read(
+			&this_adm.copp.stat[port_idx][copp_idx])));
+		return adsp_err_get_lnx_err_code(atomic_read(
+			&this_adm.copp.stat[port_idx][copp_idx]));
+	}
+
+	applied->session_id = session_id;
+	applied->session_type = session_type;
+	WRITE_ONCE(applied->gen, gen);
+	return 0;
 
+fail_unlock:
+	mutex_unlock(&cache->lock);
 	return ret;
 }
 EXPORT_SYMBOL(adm_programable_channel_mixer);
@@ -734,7 +1048,9 @@ int adm_set_stereo_to_custom_stereo(int port_id, int copp_idx,
 		__func__, adm_params->deviceid, adm_params->sessionid,
 		adm_params->hdr.src_port, adm_params->hdr.dest_port);
 	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
-	rc = apr_send_pkt(this_adm.apr, (uint32_t *)adm_params);
+	/* replaces whatever adm_programable_channel_mixer() left there */
+	adm_chmix_invalidate(port_idx, copp_idx);
+	rc = adm_apr_send_pkt((uint32_t *)adm_params);
 	if (rc < 0) {
 		pr_err("%s: Set params failed port = 0x%x rc %d\n",
 			__func__, port_id, rc);
@@ -833,7 +1149,9 @@ int adm_set_custom_chmix_cfg(int port_id, int copp_idx,
 		__func__, adm_params->deviceid, adm_params->sessionid,
 		adm_params->hdr.src_port, adm_params->hdr.dest_port);
 	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
-	rc = apr_send_pkt(this_adm.apr, (uint32_t *)adm_params);
+	/* replaces whatever adm_programable_channel_mixer() left there */
+	adm_chmix_invalidate(port_idx, copp_idx);
+	rc = adm_apr_send_pkt((uint32_t *)adm_params);
 	if (rc < 0) {
 		pr_err("%s: Set params failed port = 0x%x rc %d\n",
 			__func__, port_id, rc);
@@ -869,6 +1187,377 @@ exit:
 }
 EXPORT_SYMBOL(adm_set_custom_chmix_cfg);
 
+static void adm_fill_set_pp_params_hdr(struct adm_cmd_set_pp_params *params,
+				       int port_id, int port_idx, int copp_idx,
+				       int size)
+{
+	params->apr_hdr.hdr_field =
+		APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD, APR_HDR_LEN(APR_HDR_SIZE),
+			      APR_PKT_VER);
+	params->apr_hdr.pkt_size = size;
+	params->apr_hdr.src_svc = APR_SVC_ADM;
+	params->apr_hdr.src_domain = APR_DOMAIN_APPS;
+	params->apr_hdr.src_port = port_id;
+	params->apr_hdr.dest_svc = APR_SVC_ADM;
+	params->apr_hdr.dest_domain = APR_DOMAIN_ADSP;
+	params->apr_hdr.dest_port =
+		atomic_read(&this_adm.copp.id[port_idx][copp_idx]);
+	params->apr_hdr.token = port_idx << 16 | copp_idx;
+
+	if (q6common_is_instance_id_supported())
+		params->apr_hdr.opcode = ADM_CMD_SET_PP_PARAMS_V6;
+	else
+		params->apr_hdr.opcode = ADM_CMD_SET_PP_PARAMS_V5;
+}
+
+/*
+ * Send @cnt prepared commands for one COPP in a single APR transaction.
+ * The acks are routed back to the COPP through the port/copp index in
+ * the token and collected by adm_wait_batch(). Returns the number of
+ * commands sent or error.
+ */
+static int adm_send_batch(int port_idx, int copp_idx, struct apr_hdr **pkts,
+			  int cnt)
+{
+	atomic_t *batch_cnt = &this_adm.copp.batch_cnt[port_idx][copp_idx];
+	atomic_t *batch_stat = &this_adm.copp.batch_stat[port_idx][copp_idx];
+	int i, sent;
+
+	for (i = 0; i < cnt; i++) {
+		pkts[i]->token |= ADM_TOKEN_BATCH_FLAG;
+		adm_count_cmd(pkts[i]->opcode);
+	}
+
+	atomic_set(batch_stat, 0);
+	atomic_set(batch_cnt, cnt);
+	sent = apr_send_pkt_batch(this_adm.apr, (uint32_t **)pkts, cnt);
+	if (sent < 0) {
+		pr_err("%s: batch send failed port_idx %d copp_idx %d ret %d\n",
+		       __func__, port_idx, copp_idx, sent);
+		atomic_set(batch_cnt, 0);
+		return sent;
+	}
+	if (sent < cnt)
+		atomic_sub(cnt - sent, batch_cnt);
+
+	return sent;
+}
+
+static int adm_wait_batch(int port_idx, int copp_idx, int cnt, int sent)
+{
+	atomic_t *batch_cnt = &this_adm.copp.batch_cnt[port_idx][copp_idx];
+	atomic_t *batch_stat = &this_adm.copp.batch_stat[port_idx][copp_idx];
+	int ret;
+
+	ret = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
+				 atomic_read(batch_cnt) <= 0,
+				 msecs_to_jiffies(TIMEOUT_MS));
+	if (!ret) {
+		pr_err("%s: timeout, %d of %d cmds pending\n", __func__,
+		       atomic_read(batch_cnt), sent);
+		atomic_set(batch_cnt, 0);
+		return -ETIMEDOUT;
+	}
+	if (atomic_read(batch_stat) > 0) {
+		pr_err("%s: DSP returned error[%s]\n", __func__,
+		       adsp_err_get_err_str(atomic_read(batch_stat)));
+		return adsp_err_get_lnx_err_code(atomic_read(batch_stat));
+	}
+
+	return sent < cnt ? -EINVAL : 0;
+}
+
+static int adm_memory_map_regions(int map_index, phys_addr_t *buf_add,
+				  uint32_t mempool_id, uint32_t *bufsz,
+				  uint32_t bufcnt);
+static int adm_memory_unmap_regions(int map_index);
+
+static void adm_param_pool_free(struct adm_param_pool *pool)
+{
+	msm_audio_ion_free(pool->dma_buf);
+	pool->dma_buf = NULL;
+	pool->memmap.size = 0;
+	pool->memmap.kvaddr = NULL;
+	pool->memmap.paddr = 0;
+	atomic_set(&this_adm.mem_map_handles[ADM_MEM_MAP_INDEX_PARAM_POOL], 0);
+}
+
+/* Allocates and maps the pool on first use, and again after an SSR */
+static int adm_param_pool_map(void)
+{
+	struct adm_param_pool *pool = &this_adm.param_pool;
+	uint32_t map_size = 0;
+	unsigned long flags;
+	bool ready, busy;
+	int ret = 0;
+
+	mutex_lock(&pool->lock);
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	ready = pool->ready;
+	busy = pool->in_use != 0;
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	if (ready)
+		goto done;
+	if (busy) {
+		/* requests sent before the DSP restarted still hold slots */
+		ret = -EBUSY;
+		goto done;
+	}
+	if (pool->dma_buf)
+		adm_param_pool_free(pool);
+
+	ret = msm_audio_ion_alloc(&pool->dma_buf, ADM_PARAM_POOL_SIZE,
+				  &pool->memmap.paddr, &pool->memmap.size,
+				  &pool->memmap.kvaddr);
+	if (ret) {
+		pr_err("%s: failed to allocate param pool, ret %d\n",
+		       __func__, ret);
+		pool->dma_buf = NULL;
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	map_size = pool->memmap.size;
+	ret = adm_memory_map_regions(ADM_MEM_MAP_INDEX_PARAM_POOL,
+				     &pool->memmap.paddr, 0, &map_size, 1);
+	if (ret < 0) {
+		pr_err("%s: failed to map param pool, paddr = 0x%pK, size = %d\n",
+		       __func__, (void *)pool->memmap.paddr, map_size);
+		adm_param_pool_free(pool);
+		ret = -EINVAL;
+		goto done;
+	}
+	ret = 0;
+
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	pool->ready = true;
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	pr_debug("%s: paddr = 0x%pK, size = %d, mem_map_handle = 0x%x\n",
+		 __func__, (void *)pool->memmap.paddr, map_size,
+		 atomic_read(&this_adm.mem_map_handles
+			     [ADM_MEM_MAP_INDEX_PARAM_POOL]));
+done:
+	mutex_unlock(&pool->lock);
+	return ret;
+}
+
+/*
+ * The DSP dropped the mapping. The memory itself is kept until the next
+ * adm_param_pool_map() so requests still holding a slot never touch
+ * freed memory; slots lost to timeouts are returned here.
+ */
+static void adm_param_pool_reset(void)
+{
+	struct adm_param_pool *pool = &this_adm.param_pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	pool->ready = false;
+	pool->in_use &= ~pool->leaked;
+	pool->leaked = 0;
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	atomic_set(&this_adm.mem_map_handles[ADM_MEM_MAP_INDEX_PARAM_POOL], 0);
+}
+
+/*
+ * Unmaps the pool from a running DSP on teardown. After an SSR the DSP
+ * has dropped the mapping already, see adm_param_pool_reset().
+ */
+static void adm_param_pool_unmap(void)
+{
+	struct adm_param_pool *pool = &this_adm.param_pool;
+	unsigned long flags;
+	bool ready;
+	int ret;
+
+	mutex_lock(&pool->lock);
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	ready = pool->ready;
+	pool->ready = false;
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	if (ready && atomic_read(&this_adm.mem_map_handles
+				 [ADM_MEM_MAP_INDEX_PARAM_POOL])) {
+		ret = adm_memory_unmap_regions(ADM_MEM_MAP_INDEX_PARAM_POOL);
+		if (ret < 0)
+			pr_err("%s: adm mem unmmap err %d", __func__, ret);
+		atomic_set(&this_adm.mem_map_handles
+			   [ADM_MEM_MAP_INDEX_PARAM_POOL], 0);
+	}
+	mutex_unlock(&pool->lock);
+}
+
+static int adm_param_slot_claim(struct adm_param_pool *pool)
+{
+	unsigned long flags;
+	int slot;
+
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	if (!pool->ready) {
+		slot = -ENODEV;
+	} else {
+		slot = find_first_zero_bit(&pool->in_use,
+					   ADM_PARAM_POOL_SLOTS);
+		if (slot < ADM_PARAM_POOL_SLOTS)
+			set_bit(slot, &pool->in_use);
+		else
+			slot = -EBUSY;
+	}
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	return slot;
+}
+
+/*
+ * Returns a free slot of the mapped pool, or error if none can be had.
+ * Callers fall back to in band right away when all slots are taken.
+ */
+static int adm_param_slot_get(void)
+{
+	int ret;
+
+	ret = adm_param_pool_map();
+	if (ret)
+		return ret;
+
+	ret = adm_param_slot_claim(&this_adm.param_pool);
+	if (ret == -EBUSY)
+		pr_debug("%s: no free param slot\n", __func__);
+	return ret;
+}
+
+/*
+ * A slot whose command timed out may still be written by the DSP, so it
+ * is only reused once its late reply arrives or after the next SSR.
+ */
+static void adm_param_slot_put(int slot, bool timed_out)
+{
+	struct adm_param_pool *pool = &this_adm.param_pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	if (timed_out && atomic_read(&pool->stat[slot]) < 0)
+		set_bit(slot, &pool->leaked);
+	else
+		clear_bit(slot, &pool->in_use);
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+}
+
+static u8 *adm_param_slot_kvaddr(int slot)
+{
+	return (u8 *)this_adm.param_pool.memmap.kvaddr +
+	       slot * ADM_PARAM_SLOT_SIZE;
+}
+
+static void adm_param_slot_mem_hdr(int slot, struct mem_mapping_hdr *mem_hdr)
+{
+	phys_addr_t paddr = this_adm.param_pool.memmap.paddr +
+			    slot * ADM_PARAM_SLOT_SIZE;
+
+	memset(mem_hdr, 0, sizeof(*mem_hdr));
+	mem_hdr->data_payload_addr_lsw = lower_32_bits(paddr);
+	mem_hdr->data_payload_addr_msw =
+		msm_audio_populate_upper_32_bits(paddr);
+	mem_hdr->mem_map_handle = atomic_read(
+		&this_adm.mem_map_handles[ADM_MEM_MAP_INDEX_PARAM_POOL]);
+}
+
+/* Sends a get/set params command on behalf of @slot and waits for it */
+static int adm_param_slot_send(int slot, struct apr_hdr *hdr)
+{
+	atomic_t *stat = &this_adm.param_pool.stat[slot];
+	int ret;
+
+	hdr->token |= (slot + 1) << ADM_TOKEN_SLOT_SHIFT;
+	atomic_set(stat, -1);
+	ret = adm_apr_send_pkt((uint32_t *) hdr);
+	if (ret < 0) {
+		pr_err("%s: APR send failed for opcode 0x%x ret %d\n",
+		       __func__, hdr->opcode, ret);
+		return -EINVAL;
+	}
+	ret = wait_event_timeout(this_adm.param_pool.wait[slot],
+				 atomic_read(stat) >= 0,
+				 msecs_to_jiffies(TIMEOUT_MS));
+	if (!ret) {
+		pr_err("%s: opcode 0x%x timed out on slot %d\n", __func__,
+		       hdr->opcode, slot);
+		return -ETIMEDOUT;
+	}
+	if (atomic_read(stat) > 0) {
+		pr_err("%s: DSP returned error[%s]\n", __func__,
+		       adsp_err_get_err_str(atomic_read(stat)));
+		return adsp_err_get_lnx_err_code(atomic_read(stat));
+	}
+	return 0;
+}
+
+/* Routes a response tagged with a param slot to it, true if consumed */
+static bool adm_param_slot_complete(struct apr_client_data *data,
+				    uint32_t *payload)
+{
+	struct adm_param_pool *pool = &this_adm.param_pool;
+	int slot = ((data->token >> ADM_TOKEN_SLOT_SHIFT) &
+		    ADM_TOKEN_SLOT_MASK) - 1;
+	unsigned long flags;
+	uint32_t status;
+
+	if (slot < 0 || slot >= ADM_PARAM_POOL_SLOTS)
+		return false;
+
+	switch (data->opcode) {
+	case APR_BASIC_RSP_RESULT:
+		if (data->payload_size < 2 * sizeof(uint32_t))
+			return false;
+		status = payload[1];
+		break;
+	case ADM_CMDRSP_GET_PP_PARAMS_V5:
+	case ADM_CMDRSP_GET_PP_PARAMS_V6:
+		status = payload[0];
+		break;
+	default:
+		return false;
+	}
+
+	if (status)
+		pr_err("%s: slot %d opcode 0x%x returned error 0x%x\n",
+		       __func__, slot, data->opcode, status);
+	spin_lock_irqsave(&pool->slot_lock, flags);
+	atomic_set(&pool->stat[slot], status);
+	/* the requester gave up on this reply, hand the slot back */
+	if (test_and_clear_bit(slot, &pool->leaked)) {
+		clear_bit(slot, &pool->in_use);
+		pr_debug("%s: slot %d reclaimed\n", __func__, slot);
+	}
+	spin_unlock_irqrestore(&pool->slot_lock, flags);
+	wake_up(&pool->wait[slot]);
+	return true;
+}
+
+/* Copies the payload of an out of band get params reply out of @slot */
+static int adm_param_slot_copy_out(int slot, struct param_hdr_v3 *param_hdr,
+				   u8 *returned_param_data)
+{
+	u8 *src = adm_param_slot_kvaddr(slot);
+	u32 hdr_size = 0;
+	u32 returned_size = 0;
+
+	if (q6common_is_instance_id_supported()) {
+		hdr_size = sizeof(struct param_hdr_v3);
+		returned_size = ((struct param_hdr_v3 *) src)->param_size;
+	} else {
+		hdr_size = sizeof(struct param_hdr_v1);
+		returned_size = ((struct param_hdr_v1 *) src)->param_size;
+	}
+
+	if (returned_size > ADM_PARAM_SLOT_SIZE - hdr_size ||
+	    returned_size > param_hdr->param_size) {
+		pr_err("%s: Invalid returned size %d, buffer size %d\n",
+		       __func__, returned_size, param_hdr->param_size);
+		return -EINVAL;
+	}
+	memcpy(returned_param_data, src + hdr_size, returned_size);
+	return 0;
+}
+
 /*
  * With pre-packed data, only the opcode differes from V5 and V6.
  * Use q6common_pack_pp_params to pack the data correctly.
@@ -878,8 +1567,10 @@ int adm_set_pp_params(int port_id, int copp_idx,
 		      u32 param_size)
 {
 	struct adm_cmd_set_pp_params *adm_set_params = NULL;
+	struct mem_mapping_hdr slot_mem_hdr;
 	int size = 0;
 	int port_idx = 0;
+	int slot = -1;
 	atomic_t *copp_stat = NULL;
 	int ret = 0;
 
@@ -893,32 +1584,33 @@ int adm_set_pp_params(int port_id, int copp_idx,
 		return -EINVAL;
 	}
 
+	/* Too large for an APR packet, send out of band if the pool has room */
+	if (mem_hdr == NULL && param_data != NULL &&
+	    param_size > ADM_PARAM_INBAND_MAX &&
+	    param_size <= ADM_PARAM_SLOT_SIZE) {
+		slot = adm_param_slot_get();
+		if (slot >= 0) {
+			memcpy(adm_param_slot_kvaddr(slot), param_data,
+			       param_size);
+			adm_param_slot_mem_hdr(slot, &slot_mem_hdr);
+			mem_hdr = &slot_mem_hdr;
+			param_data = NULL;
+		}
+	}
+
 	/* Only add params_size in inband case */
 	size = sizeof(struct adm_cmd_set_pp_params);
 	if (param_data != NULL)
 		size += param_size;
-	adm_set_params = kzalloc(size, GFP_KERNEL);
-	if (!adm_set_params)
+	adm_set_params = q6common_pkt_alloc(size);
+	if (!adm_set_params) {
+		if (slot >= 0)
+			adm_param_slot_put(slot, false);
 		return -ENOMEM;
+	}
 
-	adm_set_params->apr_hdr.hdr_field =
-		APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD, APR_HDR_LEN(APR_HDR_SIZE),
-			      APR_PKT_VER);
-	adm_set_params->apr_hdr.pkt_size = size;
-	adm_set_params->apr_hdr.src_svc = APR_SVC_ADM;
-	adm_set_params->apr_hdr.src_domain = APR_DOMAIN_APPS;
-	adm_set_params->apr_hdr.src_port = port_id;
-	adm_set_params->apr_hdr.dest_svc = APR_SVC_ADM;
-	adm_set_params->apr_hdr.dest_domain = APR_DOMAIN_ADSP;
-	adm_set_params->apr_hdr.dest_port =
-		atomic_read(&this_adm.copp.id[port_idx][copp_idx]);
-	adm_set_params->apr_hdr.token = port_idx << 16 | copp_idx;
-
-	if (q6common_is_instance_id_supported())
-		adm_set_params->apr_hdr.opcode = ADM_CMD_SET_PP_PARAMS_V6;
-	else
-		adm_set_params->apr_hdr.opcode = ADM_CMD_SET_PP_PARAMS_V5;
-
+	adm_fill_set_pp_params_hdr(adm_set_params, port_id, port_idx,
+				   copp_idx, size);
 	adm_set_params->payload_size = param_size;
 
 	if (mem_hdr != NULL) {
@@ -939,9 +1631,15 @@ int adm_set_pp_params(int port_id, int copp_idx,
 		goto done;
 	}
 
+	if (slot >= 0) {
+		ret = adm_param_slot_send(slot, &adm_set_params->apr_hdr);
+		adm_param_slot_put(slot, ret == -ETIMEDOUT);
+		goto done;
+	}
+
 	copp_stat = &this_adm.copp.stat[port_idx][copp_idx];
 	atomic_set(copp_stat, -1);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *) adm_set_params);
+	ret = adm_apr_send_pkt((uint32_t *) adm_set_params);
 	if (ret < 0) {
 		pr_err("%s: Set params APR send failed port = 0x%x ret %d\n",
 		       __func__, port_id, ret);
@@ -965,7 +1663,7 @@ int adm_set_pp_params(int port_id, int copp_idx,
 
 	ret = 0;
 done:
-	kfree(adm_set_params);
+	q6common_pkt_free(adm_set_params);
 	return ret;
 }
 EXPORT_SYMBOL(adm_set_pp_params);
@@ -978,7 +1676,7 @@ int adm_pack_and_set_one_pp_param(int port_id, int copp_idx,
 	int ret = 0;
 
 	total_size = sizeof(union param_hdrs) + param_hdr.param_size;
-	packed_data = kzalloc(total_size, GFP_KERNEL);
+	packed_data = q6common_pkt_alloc(total_size);
 	if (!packed_data)
 		return -ENOMEM;
 
@@ -996,7 +1694,7 @@ int adm_pack_and_set_one_pp_param(int port_id, int copp_idx,
 		pr_err("%s: Failed to set parameter data, error %d\n", __func__,
 		       ret);
 done:
-	kfree(packed_data);
+	q6common_pkt_free(packed_data);
 	return ret;
 }
 EXPORT_SYMBOL(adm_pack_and_set_one_pp_param);
@@ -1004,12 +1702,21 @@ EXPORT_SYMBOL(adm_pack_and_set_one_pp_param);
 /*
  * Only one parameter can be requested at a time. Therefore, packing and sending
  * the request can be handled locally.
+ *
+ * Requests that want the data copied back are served out of band from a
+ * param pool slot when one is available, so concurrent gets neither share
+ * adm_get_parameters nor the per-COPP status. The in band buffer remains
+ * the fallback. @dsp_status, when given, is set to the status the DSP
+ * returned, 0 if no reply arrived.
  */
-int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
-		      struct mem_mapping_hdr *mem_hdr,
-		      struct param_hdr_v3 *param_hdr, u8 *returned_param_data)
+static int __adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
+			       struct mem_mapping_hdr *mem_hdr,
+			       struct param_hdr_v3 *param_hdr,
+			       u8 *returned_param_data, uint32_t *dsp_status)
 {
 	struct adm_cmd_get_pp_params adm_get_params;
+	struct mem_mapping_hdr slot_mem_hdr;
+	int slot = -1;
 	int total_size = 0;
 	int get_param_array_sz = ARRAY_SIZE(adm_get_parameters);
 	int returned_param_size = 0;
@@ -1019,6 +1726,9 @@ int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
 	atomic_t *copp_stat = NULL;
 	int ret = 0;
 
+	if (dsp_status)
+		*dsp_status = 0;
+
 	if (param_hdr == NULL) {
 		pr_err("%s: Received NULL pointer for parameter header\n",
 		       __func__);
@@ -1036,6 +1746,16 @@ int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
 		return -EINVAL;
 	}
 
+	if (mem_hdr == NULL && returned_param_data != NULL &&
+	    param_hdr->param_size <=
+			ADM_PARAM_SLOT_SIZE - sizeof(union param_hdrs)) {
+		slot = adm_param_slot_get();
+		if (slot >= 0) {
+			adm_param_slot_mem_hdr(slot, &slot_mem_hdr);
+			mem_hdr = &slot_mem_hdr;
+		}
+	}
+
 	memset(&adm_get_params, 0, sizeof(adm_get_params));
 
 	if (mem_hdr != NULL)
@@ -1064,10 +1784,23 @@ int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
 	else
 		adm_get_params.apr_hdr.opcode = ADM_CMD_GET_PP_PARAMS_V5;
 
+	if (slot >= 0) {
+		ret = adm_param_slot_send(slot, &adm_get_params.apr_hdr);
+		if (dsp_status &&
+		    atomic_read(&this_adm.param_pool.stat[slot]) > 0)
+			*dsp_status =
+				atomic_read(&this_adm.param_pool.stat[slot]);
+		if (!ret)
+			ret = adm_param_slot_copy_out(slot, param_hdr,
+						      returned_param_data);
+		adm_param_slot_put(slot, ret == -ETIMEDOUT);
+		return ret;
+	}
+
 	copp_stat = &this_adm.copp.stat[port_idx][copp_idx];
 	atomic_set(copp_stat, -1);
 
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *) &adm_get_params);
+	ret = adm_apr_send_pkt((uint32_t *) &adm_get_params);
 	if (ret < 0) {
 		pr_err("%s: Get params APR send failed port = 0x%x ret %d\n",
 		       __func__, port_id, ret);
@@ -1086,6 +1819,8 @@ int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
 	if (atomic_read(copp_stat) > 0) {
 		pr_err("%s: DSP returned error[%s]\n", __func__,
 		       adsp_err_get_err_str(atomic_read(copp_stat)));
+		if (dsp_status)
+			*dsp_status = atomic_read(copp_stat);
 		ret = adsp_err_get_lnx_err_code(atomic_read(copp_stat));
 		goto done;
 	}
@@ -1121,6 +1856,14 @@ int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
 done:
 	return ret;
 }
+
+int adm_get_pp_params(int port_id, int copp_idx, uint32_t client_id,
+		      struct mem_mapping_hdr *mem_hdr,
+		      struct param_hdr_v3 *param_hdr, u8 *returned_param_data)
+{
+	return __adm_get_pp_params(port_id, copp_idx, client_id, mem_hdr,
+				   param_hdr, returned_param_data, NULL);
+}
 EXPORT_SYMBOL(adm_get_pp_params);
 
 int adm_get_pp_topo_module_list_v2(int port_id, int copp_idx,
@@ -1183,7 +1926,7 @@ int adm_get_pp_topo_module_list_v2(int port_id, int copp_idx,
 
 	copp_stat = &this_adm.copp.stat[port_idx][copp_idx];
 	atomic_set(copp_stat, -1);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *) &adm_get_module_list);
+	ret = adm_apr_send_pkt((uint32_t *) &adm_get_module_list);
 	if (ret < 0) {
 		pr_err("%s: APR send pkt failed for port_id: 0x%x failed ret %d\n",
 		       __func__, port_id, ret);
@@ -1501,33 +2244,22 @@ static void adm_reset_data(void)
 			   &this_adm.copp.session_type[i][j], 0);
 			this_adm.copp.adm_status[i][j] =
 				ADM_STATUS_CALIBRATION_REQUIRED;
+			WRITE_ONCE(this_adm.copp.warm[i][j].expires, 0);
+			adm_chmix_invalidate(i, j);
 		}
 	}
+	atomic_set(&this_adm.copp_cache_cnt, 0);
 	this_adm.apr = NULL;
 	cal_utils_clear_cal_block_q6maps(ADM_MAX_CAL_TYPES,
 		this_adm.cal_data);
 	mutex_lock(&this_adm.cal_data
 		[ADM_CUSTOM_TOP_CAL]->lock);
 	this_adm.set_custom_topology = 1;
+	this_adm.custom_top_version = 0;
 	mutex_unlock(&this_adm.cal_data[
 		ADM_CUSTOM_TOP_CAL]->lock);
 	rtac_clear_mapping(ADM_RTAC_CAL);
-	/*
-	 * Free the ION memory and clear the map handles
-	 * for Source Tracking
-	 */
-	if (this_adm.sourceTrackingData.memmap.paddr != 0) {
-		msm_audio_ion_free(
-			this_adm.sourceTrackingData.dma_buf);
-		this_adm.sourceTrackingData.dma_buf = NULL;
-		this_adm.sourceTrackingData.memmap.size = 0;
-		this_adm.sourceTrackingData.memmap.kvaddr =
-							 NULL;
-		this_adm.sourceTrackingData.memmap.paddr = 0;
-		this_adm.sourceTrackingData.apr_cmd_status = -1;
-		atomic_set(&this_adm.mem_map_handles[
-			ADM_MEM_MAP_INDEX_SOURCE_TRACKING], 0);
-	}
+	adm_param_pool_reset();
 }
 
 static int32_t adm_callback(struct apr_client_data *data, void *priv)
@@ -1573,6 +2305,8 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 				client_id);
 			return 0;
 		}
+		if (adm_param_slot_complete(data, payload))
+			return 0;
 		if (data->opcode == APR_BASIC_RSP_RESULT) {
 			pr_debug("%s: APR_BASIC_RSP_RESULT id 0x%x\n",
 				__func__, payload[0]);
@@ -1592,15 +2326,24 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 				pr_err("%s: cmd = 0x%x returned error = 0x%x\n",
 					__func__, payload[0], payload[1]);
 			}
+			if (data->token & ADM_TOKEN_BATCH_FLAG) {
+				if (payload[1] != 0)
+					atomic_cmpxchg(&this_adm.copp.batch_stat
+						[port_idx][copp_idx], 0,
+						payload[1]);
+				if (atomic_dec_return(&this_adm.copp.batch_cnt
+						[port_idx][copp_idx]) <= 0)
+					wake_up(&this_adm.copp.wait
+						[port_idx][copp_idx]);
+				return 0;
+			}
 			switch (payload[0]) {
 			case ADM_CMD_SET_PP_PARAMS_V5:
 			case ADM_CMD_SET_PP_PARAMS_V6:
 				pr_debug("%s: ADM_CMD_SET_PP_PARAMS\n",
 					 __func__);
-				if (client_id == ADM_CLIENT_ID_SOURCE_TRACKING)
-					this_adm.sourceTrackingData.
-						apr_cmd_status = payload[1];
-				else if (rtac_make_adm_callback(payload,
+				if (client_id != ADM_CLIENT_ID_SOURCE_TRACKING &&
+				    rtac_make_adm_callback(payload,
 							data->payload_size))
 					break;
 				/*
@@ -1662,8 +2405,6 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 				/* ADM_CMDRSP_GET_PP_PARAMS_V5 */
 				if (client_id ==
 					ADM_CLIENT_ID_SOURCE_TRACKING) {
-					this_adm.sourceTrackingData.
-						apr_cmd_status = payload[1];
 					if (payload[1] != 0)
 						pr_err("%s: ADM get param error = %d\n",
 							__func__, payload[1]);
@@ -1741,11 +2482,9 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 		case ADM_CMDRSP_GET_PP_PARAMS_V5:
 		case ADM_CMDRSP_GET_PP_PARAMS_V6:
 			pr_debug("%s: ADM_CMDRSP_GET_PP_PARAMS\n", __func__);
-			if (client_id == ADM_CLIENT_ID_SOURCE_TRACKING)
-				this_adm.sourceTrackingData.apr_cmd_status =
-					payload[0];
-			else if (rtac_make_adm_callback(payload,
-							data->payload_size))
+			if (client_id != ADM_CLIENT_ID_SOURCE_TRACKING &&
+			    rtac_make_adm_callback(payload,
+						   data->payload_size))
 				break;
 
 			idx = ADM_GET_PARAMETER_LENGTH * copp_idx;
@@ -1814,8 +2553,9 @@ static int32_t adm_callback(struct apr_client_data *data, void *priv)
 	return 0;
 }
 
-static int adm_memory_map_regions(phys_addr_t *buf_add, uint32_t mempool_id,
-			   uint32_t *bufsz, uint32_t bufcnt)
+static int adm_memory_map_regions(int map_index, phys_addr_t *buf_add,
+				  uint32_t mempool_id, uint32_t *bufsz,
+				  uint32_t bufcnt)
 {
 	struct  avs_cmd_shared_mem_map_regions *mmap_regions = NULL;
 	struct  avs_shared_map_region_payload *mregions = NULL;
@@ -1873,8 +2613,10 @@ static int adm_memory_map_regions(phys_addr_t *buf_add, uint32_t mempool_id,
 		++mregions;
 	}
 
+	mutex_lock(&this_adm.adm_stat_lock);
+	atomic_set(&this_adm.mem_map_index, map_index);
 	atomic_set(&this_adm.adm_stat, -1);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *) mmap_region_cmd);
+	ret = adm_apr_send_pkt((uint32_t *) mmap_region_cmd);
 	if (ret < 0) {
 		pr_err("%s: mmap_regions op[0x%x]rc[%d]\n", __func__,
 					mmap_regions->hdr.opcode, ret);
@@ -1898,11 +2640,12 @@ static int adm_memory_map_regions(phys_addr_t *buf_add, uint32_t mempool_id,
 		goto fail_cmd;
 	}
 fail_cmd:
+	mutex_unlock(&this_adm.adm_stat_lock);
 	kfree(mmap_region_cmd);
 	return ret;
 }
 
-static int adm_memory_unmap_regions(void)
+static int adm_memory_unmap_regions(int map_index)
 {
 	struct  avs_cmd_shared_mem_unmap_regions unmap_regions;
 	int     ret = 0;
@@ -1922,9 +2665,10 @@ static int adm_memory_unmap_regions(void)
 	unmap_regions.hdr.token = 0;
 	unmap_regions.hdr.opcode = ADM_CMD_SHARED_MEM_UNMAP_REGIONS;
 	unmap_regions.mem_map_handle = atomic_read(&this_adm.
-		mem_map_handles[atomic_read(&this_adm.mem_map_index)]);
+		mem_map_handles[map_index]);
+	mutex_lock(&this_adm.adm_stat_lock);
 	atomic_set(&this_adm.adm_stat, -1);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *) &unmap_regions);
+	ret = adm_apr_send_pkt((uint32_t *) &unmap_regions);
 	if (ret < 0) {
 		pr_err("%s: mmap_regions op[0x%x]rc[%d]\n", __func__,
 				unmap_regions.hdr.opcode, ret);
@@ -1952,6 +2696,7 @@ static int adm_memory_unmap_regions(void)
 			 unmap_regions.mem_map_handle);
 	}
 fail_cmd:
+	mutex_unlock(&this_adm.adm_stat_lock);
 	return ret;
 }
 
@@ -1968,8 +2713,8 @@ static int remap_cal_data(struct cal_block_data *cal_block, int cal_index)
 
 	if ((cal_block->map_data.map_size > 0) &&
 		(cal_block->map_data.q6map_handle == 0)) {
-		atomic_set(&this_adm.mem_map_index, cal_index);
-		ret = adm_memory_map_regions(&cal_block->cal_data.paddr, 0,
+		ret = adm_memory_map_regions(cal_index,
+				&cal_block->cal_data.paddr, 0,
 				(uint32_t *)&cal_block->map_data.map_size, 1);
 		if (ret < 0) {
 			pr_err("%s: ADM mmap did not work! size = %zd ret %d\n",
@@ -2007,6 +2752,12 @@ static void send_adm_custom_topology(void)
 	if (cal_block == NULL || cal_utils_is_cal_stale(cal_block))
 		goto unlock;
 
+	if (this_adm.custom_top_version &&
+	    cal_block->cal_version == this_adm.custom_top_version) {
+		pr_debug("%s: custom topology unchanged\n", __func__);
+		goto unlock;
+	}
+
 	pr_debug("%s: Sending cal_index %d\n", __func__, cal_index);
 
 	result = remap_cal_data(cal_block, cal_index);
@@ -2015,7 +2766,6 @@ static void send_adm_custom_topology(void)
 			__func__, cal_index);
 		goto unlock;
 	}
-	atomic_set(&this_adm.mem_map_index, cal_index);
 	atomic_set(&this_adm.mem_map_handles[cal_index],
 		cal_block->map_data.q6map_handle);
 
@@ -2041,15 +2791,16 @@ static void send_adm_custom_topology(void)
 	adm_top.mem_map_handle = cal_block->map_data.q6map_handle;
 	adm_top.payload_size = cal_block->cal_data.size;
 
+	mutex_lock(&this_adm.adm_stat_lock);
 	atomic_set(&this_adm.adm_stat, -1);
 	pr_debug("%s: Sending ADM_CMD_ADD_TOPOLOGIES payload = 0x%pK, size = %d\n",
 		__func__, &cal_block->cal_data.paddr,
 		adm_top.payload_size);
-	result = apr_send_pkt(this_adm.apr, (uint32_t *)&adm_top);
+	result = adm_apr_send_pkt((uint32_t *)&adm_top);
 	if (result < 0) {
 		pr_err("%s: Set topologies failed payload size = %zd result %d\n",
 			__func__, cal_block->cal_data.size, result);
-		goto unlock;
+		goto unlock_stat;
 	}
 	/* Wait for the callback */
 	result = wait_event_timeout(this_adm.adm_wait,
@@ -2058,15 +2809,18 @@ static void send_adm_custom_topology(void)
 	if (!result) {
 		pr_err("%s: Set topologies timed out payload size = %zd\n",
 			__func__, cal_block->cal_data.size);
-		goto unlock;
+		goto unlock_stat;
 	} else if (atomic_read(&this_adm.adm_stat) > 0) {
 		pr_err("%s: DSP returned error[%s]\n",
 				__func__, adsp_err_get_err_str(
 				atomic_read(&this_adm.adm_stat)));
 		result = adsp_err_get_lnx_err_code(
 				atomic_read(&this_adm.adm_stat));
-		goto unlock;
+		goto unlock_stat;
 	}
+	this_adm.custom_top_version = cal_block->cal_version;
+unlock_stat:
+	mutex_unlock(&this_adm.adm_stat_lock);
 unlock:
 	mutex_unlock(&this_adm.cal_data[cal_index]->lock);
 done:
@@ -2274,37 +3028,6 @@ done:
 	return ret;
 }
 
-static void send_adm_cal_type(int cal_index, int path, int port_id,
-			      int copp_idx, int perf_mode, int app_type,
-			      int acdb_id, int sample_rate)
-{
-	struct cal_block_data		*cal_block = NULL;
-	int ret;
-
-	pr_debug("%s: cal index %d\n", __func__, cal_index);
-
-	if (this_adm.cal_data[cal_index] == NULL) {
-		pr_debug("%s: cal_index %d not allocated!\n",
-			__func__, cal_index);
-		goto done;
-	}
-
-	mutex_lock(&this_adm.cal_data[cal_index]->lock);
-	cal_block = adm_find_cal(cal_index, path, app_type, acdb_id,
-				sample_rate);
-	if (cal_block == NULL)
-		goto unlock;
-
-	ret = adm_remap_and_send_cal_block(cal_index, port_id, copp_idx,
-		cal_block, perf_mode, app_type, acdb_id, sample_rate);
-
-	cal_utils_mark_cal_used(cal_block);
-unlock:
-	mutex_unlock(&this_adm.cal_data[cal_index]->lock);
-done:
-	return;
-}
-
 static int get_cal_path(int path)
 {
 	if (path == 0x1)
@@ -2317,25 +3040,103 @@ static void send_adm_cal(int port_id, int copp_idx, int path, int perf_mode,
 			 int app_type, int acdb_id, int sample_rate,
 			 int passthr_mode)
 {
+	struct cal_block_data *cal_block[ADM_CAL_BATCH_MAX];
+	struct adm_cmd_set_pp_params cal_pkt[ADM_CAL_BATCH_MAX];
+	struct apr_hdr *pkts[ADM_CAL_BATCH_MAX];
+	bool locked[ADM_CAL_BATCH_MAX];
+	int cal_index[ADM_CAL_BATCH_MAX];
+	struct cal_block_data *blk;
+	bool skip_send = false;
+	int port_idx, topology;
+	int i, cnt = 0, sent = 0;
+
 	pr_debug("%s: port id 0x%x copp_idx %d\n", __func__, port_id, copp_idx);
 
 	if (passthr_mode != LISTEN) {
-		send_adm_cal_type(ADM_AUDPROC_CAL, path, port_id, copp_idx,
-				perf_mode, app_type, acdb_id, sample_rate);
-		send_adm_cal_type(ADM_AUDPROC_PERSISTENT_CAL, path,
-				  port_id, copp_idx, perf_mode, app_type,
-				  acdb_id, sample_rate);
+		cal_index[0] = ADM_AUDPROC_CAL;
+		cal_index[1] = ADM_AUDPROC_PERSISTENT_CAL;
 	} else {
-		send_adm_cal_type(ADM_LSM_AUDPROC_CAL, path, port_id, copp_idx,
-				  perf_mode, app_type, acdb_id, sample_rate);
+		cal_index[0] = ADM_LSM_AUDPROC_CAL;
+		cal_index[1] = ADM_LSM_AUDPROC_PERSISTENT_CAL;
+	}
+	cal_index[2] = ADM_AUDVOL_CAL;
+
+	port_id = afe_convert_virtual_to_portid(port_id);
+	port_idx = adm_validate_and_get_port_index(port_id);
+	if (port_idx < 0 || port_idx >= AFE_MAX_PORTS) {
+		pr_err("%s: Invalid port_id 0x%x\n", __func__, port_id);
+		return;
+	} else if (copp_idx < 0 || copp_idx >= MAX_COPPS_PER_PORT) {
+		pr_err("%s: Invalid copp_idx 0x%x\n", __func__, copp_idx);
+		return;
+	}
+
+	topology = atomic_read(&this_adm.copp.topology[port_idx][copp_idx]);
+	if (perf_mode == LEGACY_PCM_MODE &&
+	    topology == DS2_ADM_COPP_TOPOLOGY_ID) {
+		pr_err("%s: perf_mode %d, topology 0x%x\n", __func__, perf_mode,
+		       topology);
+		skip_send = true;
+	}
+
+	/*
+	 * All cal types are held until the whole batch is queued, so the
+	 * blocks sent are the ones marked used below. They are always
+	 * taken in the order above and dropped before waiting for the acks.
+	 */
+	for (i = 0; i < ADM_CAL_BATCH_MAX; i++) {
+		cal_block[i] = NULL;
+		locked[i] = false;
+		if (this_adm.cal_data[cal_index[i]] == NULL) {
+			pr_debug("%s: cal_index %d not allocated!\n",
+				__func__, cal_index[i]);
+			continue;
+		}
+		mutex_lock_nested(&this_adm.cal_data[cal_index[i]]->lock, i);
+		locked[i] = true;
+
+		blk = adm_find_cal(cal_index[i], path, app_type, acdb_id,
+				   sample_rate);
+		if (blk == NULL)
+			continue;
+		cal_block[i] = blk;
+
+		if (remap_cal_data(blk, cal_index[i])) {
+			pr_err("%s: Remap_cal_data failed for cal %d!\n",
+				__func__, cal_index[i]);
+			continue;
+		}
+		if (skip_send || blk->cal_data.size <= 0)
+			continue;
 
-		send_adm_cal_type(ADM_LSM_AUDPROC_PERSISTENT_CAL, path,
-				  port_id, copp_idx, perf_mode, app_type,
-				  acdb_id, sample_rate);
+		memset(&cal_pkt[cnt], 0, sizeof(cal_pkt[cnt]));
+		adm_fill_set_pp_params_hdr(&cal_pkt[cnt], port_id, port_idx,
+					   copp_idx, sizeof(cal_pkt[cnt]));
+		cal_pkt[cnt].mem_hdr.data_payload_addr_lsw =
+			lower_32_bits(blk->cal_data.paddr);
+		cal_pkt[cnt].mem_hdr.data_payload_addr_msw =
+			msm_audio_populate_upper_32_bits(blk->cal_data.paddr);
+		cal_pkt[cnt].mem_hdr.mem_map_handle =
+			blk->map_data.q6map_handle;
+		cal_pkt[cnt].payload_size = blk->cal_data.size;
+		pkts[cnt] = &cal_pkt[cnt].apr_hdr;
+		cnt++;
+	}
+
+	if (cnt)
+		sent = adm_send_batch(port_idx, copp_idx, pkts, cnt);
+
+	for (i = ADM_CAL_BATCH_MAX - 1; i >= 0; i--) {
+		if (!locked[i])
+			continue;
+		if (cal_block[i])
+			cal_utils_mark_cal_used(cal_block[i]);
+		mutex_unlock(&this_adm.cal_data[cal_index[i]]->lock);
 	}
 
-	send_adm_cal_type(ADM_AUDVOL_CAL, path, port_id, copp_idx, perf_mode,
-			  app_type, acdb_id, sample_rate);
+	if (sent < 0 || (cnt && adm_wait_batch(port_idx, copp_idx, cnt, sent)))
+		pr_debug("%s: cal batch failed for port_id = 0x%x copp_idx %d\n",
+			 __func__, port_id, copp_idx);
 }
 
 /**
@@ -2393,7 +3194,7 @@ int adm_connect_afe_port(int mode, int session_id, int port_id)
 	cmd.afe_port_id = port_id;
 
 	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *)&cmd);
+	ret = adm_apr_send_pkt((uint32_t *)&cmd);
 	if (ret < 0) {
 		pr_err("%s: ADM enable for port_id: 0x%x failed ret %d\n",
 					__func__, port_id, ret);
@@ -2973,27 +3774,253 @@ exit:
 	return rc;
 }
 
-/**
- * adm_open -
- *        command to send ADM open
- *
- * @port_id: port id number
- * @path: direction or ADM path type
- * @rate: sample rate of session
- * @channel_mode: number of channels set
- * @topology: topology active for this session
- * @perf_mode: performance mode like LL/ULL/..
- * @bit_width: bit width to set for copp
- * @app_type: App type used for this session
- * @acdb_id: ACDB ID of this device
- * @session_type: type of session
- *
- * Returns 0 on success or error on failure
+static int adm_copp_release(int port_id, int port_idx, int perf_mode,
+			    int copp_idx)
+{
+	struct apr_hdr close;
+	int copp_id, ret;
+
+	copp_id = adm_get_copp_id(port_idx, copp_idx);
+	pr_debug("%s: Closing ADM port_idx:%d copp_idx:%d copp_id:0x%x\n",
+		 __func__, port_idx, copp_idx, copp_id);
+	if ((!perf_mode) && (this_adm.outband_memmap.paddr != 0) &&
+	    (atomic_read(&this_adm.copp.topology[port_idx][copp_idx]) ==
+		SRS_TRUMEDIA_TOPOLOGY_ID)) {
+		ret = adm_memory_unmap_regions(ADM_SRS_TRUMEDIA);
+		if (ret < 0) {
+			pr_err("%s: adm mem unmmap err %d",
+				__func__, ret);
+		} else {
+			atomic_set(&this_adm.mem_map_handles
+				   [ADM_SRS_TRUMEDIA], 0);
+		}
+	}
+
+	close.hdr_field = APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD,
+					APR_HDR_LEN(APR_HDR_SIZE),
+					APR_PKT_VER);
+	close.pkt_size = sizeof(close);
+	close.src_svc = APR_SVC_ADM;
+	close.src_domain = APR_DOMAIN_APPS;
+	close.src_port = port_id;
+	close.dest_svc = APR_SVC_ADM;
+	close.dest_domain = APR_DOMAIN_ADSP;
+	close.dest_port = copp_id;
+	close.token = port_idx << 16 | copp_idx;
+	close.opcode = ADM_CMD_DEVICE_CLOSE_V5;
+
+	atomic_set(&this_adm.copp.id[port_idx][copp_idx],
+		   RESET_COPP_ID);
+	atomic_set(&this_adm.copp.cnt[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.topology[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.mode[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
+	atomic_set(&this_adm.copp.rate[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.channels[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.bit_width[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.app_type[port_idx][copp_idx], 0);
+	atomic_set(&this_adm.copp.session_type[port_idx][copp_idx], 0);
+
+	clear_bit(ADM_STATUS_CALIBRATION_REQUIRED,
+		(void *)&this_adm.copp.adm_status[port_idx][copp_idx]);
+
+	ret = adm_apr_send_pkt((uint32_t *)&close);
+	if (ret < 0) {
+		pr_err("%s: ADM close failed %d\n", __func__, ret);
+		return -EINVAL;
+	}
+
+	ret = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
+		atomic_read(&this_adm.copp.stat
+		[port_idx][copp_idx]) >= 0,
+		msecs_to_jiffies(TIMEOUT_MS));
+	if (!ret) {
+		pr_err("%s: ADM cmd Route timedout for port 0x%x\n",
+			__func__, port_id);
+		return -EINVAL;
+	} else if (atomic_read(&this_adm.copp.stat
+				[port_idx][copp_idx]) > 0) {
+		pr_err("%s: DSP returned error[%s]\n",
+			__func__, adsp_err_get_err_str(
+			atomic_read(&this_adm.copp.stat
+			[port_idx][copp_idx])));
+		return adsp_err_get_lnx_err_code(
+				atomic_read(&this_adm.copp.stat
+					[port_idx][copp_idx]));
+	}
+
+	return 0;
+}
+
+/*
+ * Settings only an open command applies and then resets: EC reference,
+ * native mode and custom channel maps. A parked COPP cannot take them,
+ * and one opened with them stays tied to them.
  */
-int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
-	     int perf_mode, uint16_t bit_width, int app_type, int acdb_id,
-	     int session_type, uint32_t passthr_mode)
+static bool adm_open_settings_pending(int port_idx, int path,
+				      int channel_mode)
+{
+	int idx = (path == ADM_PATH_PLAYBACK) ?
+		  ADM_MCH_MAP_IDX_PLAYBACK : ADM_MCH_MAP_IDX_REC;
+
+	if (this_adm.native_mode)
+		return true;
+	if ((path != ADM_PATH_PLAYBACK) &&
+	    (((this_adm.ec_ref_rx & AFE_PORT_INVALID) != AFE_PORT_INVALID) ||
+	     this_adm.num_ec_ref_rx_chans))
+		return true;
+	if ((channel_mode > 2) &&
+	    (port_channel_map[port_idx].set_channel_map ||
+	     multi_ch_maps[idx].set_channel_map))
+		return true;
+	return false;
+}
+
+static bool adm_copp_cache_stale(int port_idx, int copp_idx)
+{
+	return this_adm.copp.warm[port_idx][copp_idx].cal_gen !=
+	       (u32)atomic_read(&this_adm.copp_cache_cal_gen);
+}
+
+/* Parked COPPs were calibrated with the old data, have them closed */
+static void adm_copp_cache_cal_changed(void)
+{
+	atomic_inc(&this_adm.copp_cache_cal_gen);
+	if (atomic_read(&this_adm.copp_cache_cnt))
+		mod_delayed_work(system_wq, &this_adm.copp_cache_work, 0);
+}
+
+/* Called with copp.lock[port_idx] held */
+static bool adm_copp_cache_unpark(int port_idx, int copp_idx)
+{
+	struct adm_copp_warm *warm = &this_adm.copp.warm[port_idx][copp_idx];
+
+	if (!warm->expires)
+		return false;
+
+	WRITE_ONCE(warm->expires, 0);
+	atomic_dec(&this_adm.copp_cache_cnt);
+	return true;
+}
+
+/* Closes a COPP just taken off the cache, copp.lock[port_idx] held */
+static void adm_copp_cache_drop(int port_idx, int copp_idx)
 {
+	int port_id = this_adm.copp.warm[port_idx][copp_idx].port_id;
+	int copp_id = adm_get_copp_id(port_idx, copp_idx);
+	int ret;
+
+	pr_debug("%s: port_idx:%d copp_idx:%d\n", __func__, port_idx, copp_idx);
+	ret = adm_copp_release(port_id, port_idx,
+			atomic_read(&this_adm.copp.mode[port_idx][copp_idx]),
+			copp_idx);
+	if (ret)
+		pr_err("%s: close of parked copp failed %d\n", __func__, ret);
+	rtac_remove_adm_device(port_id, copp_id);
+}
+
+/*
+ * Keeps a COPP whose last user went away open on the DSP. Returns false
+ * if it has to be closed now, either because the cache is off or full,
+ * or because closing it has side effects that cannot wait.
+ */
+static bool adm_copp_cache_park(int port_id, int port_idx, int perf_mode,
+				int copp_idx)
+{
+	struct adm_copp_warm *warm = &this_adm.copp.warm[port_idx][copp_idx];
+	int topology = atomic_read(&this_adm.copp.topology[port_idx][copp_idx]);
+	unsigned int ms = READ_ONCE(adm_copp_cache_ms);
+	unsigned long expires;
+
+	if (!ms || perf_mode == ULTRA_LOW_LATENCY_PCM_MODE || warm->pinned)
+		return false;
+	if (warm->path != ADM_PATH_PLAYBACK && warm->path != ADM_PATH_LIVE_REC)
+		return false;
+	if (topology == SRS_TRUMEDIA_TOPOLOGY_ID || topology == FFECNS_TOPOLOGY)
+		return false;
+
+	if (atomic_inc_return(&this_adm.copp_cache_cnt) >
+	    READ_ONCE(adm_copp_cache_max)) {
+		atomic_dec(&this_adm.copp_cache_cnt);
+		return false;
+	}
+
+	expires = jiffies + msecs_to_jiffies(ms);
+	warm->port_id = port_id;
+	warm->cal_gen = atomic_read(&this_adm.copp_cache_cal_gen);
+	WRITE_ONCE(warm->expires, expires ? expires : 1);
+	pr_debug("%s: port_idx:%d copp_idx:%d parked for %ums\n",
+		 __func__, port_idx, copp_idx, ms);
+
+	schedule_delayed_work(&this_adm.copp_cache_work, msecs_to_jiffies(ms));
+	return true;
+}
+
+/* Frees a parked COPP on a port with no free slot left */
+static int adm_copp_cache_evict(int port_idx)
+{
+	int idx;
+
+	for (idx = 0; idx < MAX_COPPS_PER_PORT; idx++) {
+		if (adm_copp_cache_unpark(port_idx, idx)) {
+			atomic_inc(&this_adm.copp_cache_stats.evicted);
+			adm_copp_cache_drop(port_idx, idx);
+			break;
+		}
+	}
+	return idx;
+}
+
+static void adm_copp_cache_reap(struct work_struct *work)
+{
+	unsigned long expires, next = 0;
+	int i, j;
+
+	for (i = 0; i < AFE_MAX_PORTS; i++) {
+		for (j = 0; j < MAX_COPPS_PER_PORT; j++) {
+			expires = READ_ONCE(this_adm.copp.warm[i][j].expires);
+			if (!expires)
+				continue;
+
+			if (time_before(jiffies, expires) &&
+			    !adm_copp_cache_stale(i, j)) {
+				if (!next || time_before(expires, next))
+					next = expires;
+				continue;
+			}
+
+			mutex_lock(&this_adm.copp.lock[i]);
+			/* may have been revived and parked again meanwhile */
+			expires = this_adm.copp.warm[i][j].expires;
+			if (expires && (!time_before(jiffies, expires) ||
+					adm_copp_cache_stale(i, j)) &&
+			    adm_copp_cache_unpark(i, j)) {
+				atomic_inc(&this_adm.copp_cache_stats.expired);
+				adm_copp_cache_drop(i, j);
+			}
+			mutex_unlock(&this_adm.copp.lock[i]);
+		}
+	}
+
+	if (next)
+		schedule_delayed_work(&this_adm.copp_cache_work,
+			time_after(next, jiffies) ? next - jiffies : 0);
+}
+
+/*
+ * First half of a COPP open: picks the copp_idx and sends the open
+ * command if the COPP does not exist yet, without waiting for the DSP.
+ * Called with copp.lock of the port held, which must stay held until
+ * __adm_open_complete().
+ */
+static int __adm_open_issue(struct adm_open_req *req)
+{
+	int port_id = req->port_id, path = req->path, rate = req->rate;
+	int channel_mode = req->channel_mode, topology = req->topology;
+	int perf_mode = req->perf_mode, app_type = req->app_type;
+	int acdb_id = req->acdb_id, session_type = req->session_type;
+	uint16_t bit_width = req->bit_width;
+	uint32_t passthr_mode = req->passthr_mode;
 	struct adm_cmd_device_open_v5	open;
 	struct adm_cmd_device_open_v6	open_v6;
 	struct adm_cmd_device_open_v8	open_v8;
@@ -3008,6 +4035,7 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 	void *adm_params = NULL;
 	int param_size;
 	int num_ec_ref_rx_chans = this_adm.num_ec_ref_rx_chans;
+	bool revived = false;
 
 	pr_debug("%s:port %#x path:%d rate:%d mode:%d perf_mode:%d,topo_id %d\n",
 		 __func__, port_id, path, rate, channel_mode, perf_mode,
@@ -3096,8 +4124,34 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 						      rate, bit_width,
 						      app_type, session_type);
 
+	/*
+	 * A parked COPP is still open and calibrated on the DSP, take it
+	 * back as is if the rest of its media format matches too, its cal
+	 * is current and no setting is waiting for an open command.
+	 */
+	if (copp_idx >= 0 && adm_copp_cache_unpark(port_idx, copp_idx)) {
+		if ((this_adm.copp.warm[port_idx][copp_idx].path == path) &&
+		    !adm_copp_cache_stale(port_idx, copp_idx) &&
+		    !adm_open_settings_pending(port_idx, path, channel_mode) &&
+		    (atomic_read(&this_adm.copp.channels[port_idx][copp_idx]) ==
+			channel_mode) &&
+		    (atomic_read(&this_adm.copp.acdb_id[port_idx][copp_idx]) ==
+			acdb_id)) {
+			pr_debug("%s: revive port_idx:%d copp_idx:%d\n",
+				 __func__, port_idx, copp_idx);
+			atomic_inc(&this_adm.copp_cache_stats.hit);
+			revived = true;
+		} else {
+			atomic_inc(&this_adm.copp_cache_stats.evicted);
+			adm_copp_cache_drop(port_idx, copp_idx);
+			copp_idx = -1;
+		}
+	}
+
 	if (copp_idx < 0) {
 		copp_idx = adm_get_next_available_copp(port_idx);
+		if (copp_idx >= MAX_COPPS_PER_PORT)
+			copp_idx = adm_copp_cache_evict(port_idx);
 		if (copp_idx >= MAX_COPPS_PER_PORT) {
 			pr_err("%s: exceeded copp id %d\n",
 				 __func__, copp_idx);
@@ -3120,6 +4174,7 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 			   acdb_id);
 		atomic_set(&this_adm.copp.session_type[port_idx][copp_idx],
 			   session_type);
+		this_adm.copp.warm[port_idx][copp_idx].path = path;
 		set_bit(ADM_STATUS_CALIBRATION_REQUIRED,
 		(void *)&this_adm.copp.adm_status[port_idx][copp_idx]);
 		if ((path != ADM_PATH_COMPRESSED_RX) &&
@@ -3136,16 +4191,21 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 	}
 
 	/* Create a COPP if port id are not enabled */
-	if (atomic_read(&this_adm.copp.cnt[port_idx][copp_idx]) == 0) {
+	if (!revived &&
+	    atomic_read(&this_adm.copp.cnt[port_idx][copp_idx]) == 0) {
 		pr_debug("%s: open ADM: port_idx: %d, copp_idx: %d\n", __func__,
 			 port_idx, copp_idx);
+		this_adm.copp.warm[port_idx][copp_idx].pinned =
+			adm_open_settings_pending(port_idx, path, channel_mode);
+		if (perf_mode != ULTRA_LOW_LATENCY_PCM_MODE &&
+		    READ_ONCE(adm_copp_cache_ms))
+			atomic_inc(&this_adm.copp_cache_stats.miss);
 		if ((topology == SRS_TRUMEDIA_TOPOLOGY_ID) &&
 		      perf_mode == LEGACY_PCM_MODE) {
 			int res;
 
-			atomic_set(&this_adm.mem_map_index, ADM_SRS_TRUMEDIA);
 			msm_dts_srs_tm_ion_memmap(&this_adm.outband_memmap);
-			res = adm_memory_map_regions(
+			res = adm_memory_map_regions(ADM_SRS_TRUMEDIA,
 					&this_adm.outband_memmap.paddr, 0,
 			(uint32_t *)&this_adm.outband_memmap.size, 1);
 			if (res < 0) {
@@ -3287,8 +4347,7 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 						ep2_payload_size);
 			}
 
-			ret = apr_send_pkt(this_adm.apr,
-					(uint32_t *)adm_params);
+			ret = adm_apr_send_pkt((uint32_t *)adm_params);
 			if (ret < 0) {
 				pr_err("%s: port_id: 0x%x for[0x%x] failed %d for open_v8\n",
 					__func__, tmp_port, port_id, ret);
@@ -3374,11 +4433,9 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 				if (ret)
 					return ret;
 
-				ret = apr_send_pkt(this_adm.apr,
-					(uint32_t *)&open_v6);
+				ret = adm_apr_send_pkt((uint32_t *)&open_v6);
 			} else {
-				ret = apr_send_pkt(this_adm.apr,
-					(uint32_t *)&open);
+				ret = adm_apr_send_pkt((uint32_t *)&open);
 			}
 			if (ret < 0) {
 				pr_err("%s: port_id: 0x%x for[0x%x] failed %d\n",
@@ -3387,6 +4444,25 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 			}
 		}
 
+		req->pending = true;
+	}
+
+	req->port_idx = port_idx;
+	req->num_ec_ref_rx_chans = num_ec_ref_rx_chans;
+	return copp_idx;
+}
+
+/* Second half of a COPP open, waits for the DSP if an open was sent */
+static int __adm_open_complete(struct adm_open_req *req, int copp_idx)
+{
+	int port_id = q6audio_convert_virtual_to_portid(req->port_id);
+	int tmp_port = q6audio_get_port_id(req->port_id);
+	int port_idx = req->port_idx;
+	int num_ec_ref_rx_chans = req->num_ec_ref_rx_chans;
+	int ret;
+
+	if (req->pending) {
+		req->pending = false;
 		/* Wait for the callback with copp id */
 		ret = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
 			atomic_read(&this_adm.copp.stat
@@ -3407,27 +4483,175 @@ int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
 						[port_idx][copp_idx]));
 		}
 	}
-	atomic_inc(&this_adm.copp.cnt[port_idx][copp_idx]);
+	atomic_inc(&this_adm.copp.cnt[port_idx][copp_idx]);
+
+	/*
+	 * Configure MFC(in ec_ref path) if chmixing param is applicable and set.
+	 * Except channels and channel maps the media format config for this module
+	 * should match with the COPP(EP1) config values.
+	 */
+	if (req->path != ADM_PATH_PLAYBACK &&
+		this_adm.num_ec_ref_rx_chans_downmixed != 0 &&
+		num_ec_ref_rx_chans != this_adm.num_ec_ref_rx_chans_downmixed) {
+		ret = adm_copp_set_ec_ref_mfc_cfg(port_id, copp_idx,
+			atomic_read(&this_adm.copp.rate[port_idx][copp_idx]),
+			atomic_read(&this_adm.copp.bit_width[port_idx][copp_idx]),
+			num_ec_ref_rx_chans,
+			this_adm.num_ec_ref_rx_chans_downmixed);
+		this_adm.num_ec_ref_rx_chans_downmixed = 0;
+		if (ret)
+			pr_err("%s: set EC REF MFC cfg failed, err %d\n", __func__, ret);
+	}
+
+	return copp_idx;
+}
+
+static int __adm_open(struct adm_open_req *req)
+{
+	int copp_idx;
+
+	req->pending = false;
+	copp_idx = __adm_open_issue(req);
+	if (copp_idx < 0)
+		return copp_idx;
+
+	return __adm_open_complete(req, copp_idx);
+}
+
+/**
+ * adm_open -
+ *        command to send ADM open
+ *
+ * @port_id: port id number
+ * @path: direction or ADM path type
+ * @rate: sample rate of session
+ * @channel_mode: number of channels set
+ * @topology: topology active for this session
+ * @perf_mode: performance mode like LL/ULL/..
+ * @bit_width: bit width to set for copp
+ * @app_type: App type used for this session
+ * @acdb_id: ACDB ID of this device
+ * @session_type: type of session
+ *
+ * Returns 0 on success or error on failure
+ */
+int adm_open(int port_id, int path, int rate, int channel_mode, int topology,
+	     int perf_mode, uint16_t bit_width, int app_type, int acdb_id,
+	     int session_type, uint32_t passthr_mode)
+{
+	struct adm_open_req req = {
+		.port_id = port_id,
+		.path = path,
+		.rate = rate,
+		.channel_mode = channel_mode,
+		.topology = topology,
+		.perf_mode = perf_mode,
+		.bit_width = bit_width,
+		.app_type = app_type,
+		.acdb_id = acdb_id,
+		.session_type = session_type,
+		.passthr_mode = passthr_mode,
+	};
+	int port_idx, ret;
+
+	port_idx = adm_validate_and_get_port_index(
+			q6audio_convert_virtual_to_portid(port_id));
+	if (port_idx < 0) {
+		pr_err("%s: Invalid port_id 0x%x\n", __func__, port_id);
+		return -EINVAL;
+	}
+
+	mutex_lock(&this_adm.copp.lock[port_idx]);
+	ret = __adm_open(&req);
+	mutex_unlock(&this_adm.copp.lock[port_idx]);
+	return ret;
+}
+EXPORT_SYMBOL(adm_open);
+
+/* True if an earlier request in the batch is on the same port */
+static bool adm_open_batch_port_seen(struct adm_open_req *reqs, int idx)
+{
+	int i;
+
+	for (i = 0; i < idx; i++)
+		if (reqs[i].port_idx == reqs[idx].port_idx)
+			return true;
+	return false;
+}
+
+/**
+ * adm_open_batch -
+ *        open several COPPs with the DSP working on them in parallel
+ *
+ * @reqs: open requests, copp_idx of each is set to the result
+ * @num_reqs: number of requests
+ *
+ * All open commands are sent before waiting for any of them, so the
+ * time taken is that of the slowest open rather than their sum. Requests
+ * sharing a port with an earlier one are opened one by one afterwards.
+ *
+ * Returns 0 if all opens succeeded or the first error otherwise
+ */
+int adm_open_batch(struct adm_open_req *reqs, int num_reqs)
+{
+	int i, port_idx, next, ret = 0;
+
+	for (i = 0; i < num_reqs; i++) {
+		reqs[i].pending = false;
+		reqs[i].port_idx = adm_validate_and_get_port_index(
+			q6audio_convert_virtual_to_portid(reqs[i].port_id));
+		reqs[i].copp_idx = reqs[i].port_idx < 0 ? -EINVAL : 0;
+	}
+
+	/* Lowest port index first, callers may race on the same ports */
+	for (port_idx = -1; ; port_idx = next) {
+		next = AFE_MAX_PORTS;
+		for (i = 0; i < num_reqs; i++)
+			if (reqs[i].port_idx > port_idx &&
+			    reqs[i].port_idx < next)
+				next = reqs[i].port_idx;
+		if (next == AFE_MAX_PORTS)
+			break;
+		mutex_lock(&this_adm.copp.lock[next]);
+	}
+
+	for (i = 0; i < num_reqs; i++) {
+		if (reqs[i].copp_idx < 0 || adm_open_batch_port_seen(reqs, i))
+			continue;
+		reqs[i].copp_idx = __adm_open_issue(&reqs[i]);
+	}
+
+	for (i = 0; i < num_reqs; i++) {
+		if (reqs[i].copp_idx < 0 || adm_open_batch_port_seen(reqs, i))
+			continue;
+		reqs[i].copp_idx = __adm_open_complete(&reqs[i],
+						       reqs[i].copp_idx);
+	}
 
-	/*
-	 * Configure MFC(in ec_ref path) if chmixing param is applicable and set.
-	 * Except channels and channel maps the media format config for this module
-	 * should match with the COPP(EP1) config values.
-	 */
-	if (path != ADM_PATH_PLAYBACK &&
-		this_adm.num_ec_ref_rx_chans_downmixed != 0 &&
-		num_ec_ref_rx_chans != this_adm.num_ec_ref_rx_chans_downmixed) {
-		ret = adm_copp_set_ec_ref_mfc_cfg(port_id, copp_idx,
-				rate, bit_width, num_ec_ref_rx_chans,
-				this_adm.num_ec_ref_rx_chans_downmixed);
-		this_adm.num_ec_ref_rx_chans_downmixed = 0;
-		if (ret)
-			pr_err("%s: set EC REF MFC cfg failed, err %d\n", __func__, ret);
+	for (i = 0; i < num_reqs; i++) {
+		if (reqs[i].copp_idx < 0 || !adm_open_batch_port_seen(reqs, i))
+			continue;
+		reqs[i].copp_idx = __adm_open(&reqs[i]);
 	}
 
-	return copp_idx;
+	for (i = num_reqs - 1; i >= 0; i--) {
+		if (reqs[i].port_idx >= 0 &&
+		    !adm_open_batch_port_seen(reqs, i))
+			mutex_unlock(&this_adm.copp.lock[reqs[i].port_idx]);
+	}
+
+	for (i = 0; i < num_reqs; i++) {
+		if (reqs[i].copp_idx >= 0)
+			continue;
+		pr_err("%s: open failed for port_id 0x%x err %d\n",
+		       __func__, reqs[i].port_id, reqs[i].copp_idx);
+		if (!ret)
+			ret = reqs[i].copp_idx;
+	}
+
+	return ret;
 }
-EXPORT_SYMBOL(adm_open);
+EXPORT_SYMBOL(adm_open_batch);
 
 /**
  * adm_copp_mfc_cfg -
@@ -3544,6 +4768,39 @@ static void route_set_opcode_matrix_id(
 		 __func__, route->hdr.opcode, route->matrix_id);
 }
 
+static int adm_send_matrix_map(void *matrix_map, int session_id)
+{
+	int ret;
+
+	mutex_lock(&this_adm.matrix_map_lock);
+	atomic_set(&this_adm.matrix_map_stat, -1);
+
+	ret = adm_apr_send_pkt((uint32_t *)matrix_map);
+	if (ret < 0) {
+		pr_err("%s: routing for syream %d failed ret %d\n",
+			__func__, session_id, ret);
+		ret = -EINVAL;
+		goto done;
+	}
+	ret = wait_event_timeout(this_adm.matrix_map_wait,
+				atomic_read(&this_adm.matrix_map_stat) >= 0,
+				msecs_to_jiffies(TIMEOUT_MS));
+	if (!ret) {
+		pr_err("%s: routing for syream %d failed\n", __func__,
+			session_id);
+		ret = -EINVAL;
+	} else if (atomic_read(&this_adm.matrix_map_stat) > 0) {
+		pr_err("%s: DSP returned error[%s]\n", __func__,
+			adsp_err_get_err_str(atomic_read(
+			&this_adm.matrix_map_stat)));
+		ret = adsp_err_get_lnx_err_code(
+				atomic_read(&this_adm.matrix_map_stat));
+	}
+done:
+	mutex_unlock(&this_adm.matrix_map_lock);
+	return ret;
+}
+
 /**
  * adm_matrix_map -
  *        command to send ADM matrix map for ADM copp list
@@ -3613,38 +4870,17 @@ int adm_matrix_map(int path, struct route_payload payload_map, int perf_mode,
 		copps_list[i] = atomic_read(&this_adm.copp.id[port_idx]
 							     [copp_idx]);
 	}
-	atomic_set(&this_adm.matrix_map_stat, -1);
-
-	ret = apr_send_pkt(this_adm.apr, (uint32_t *)matrix_map);
-	if (ret < 0) {
-		pr_err("%s: routing for syream %d failed ret %d\n",
-			__func__, payload_map.session_id, ret);
-		ret = -EINVAL;
-		goto fail_cmd;
-	}
-	ret = wait_event_timeout(this_adm.matrix_map_wait,
-				atomic_read(&this_adm.matrix_map_stat) >= 0,
-				msecs_to_jiffies(TIMEOUT_MS));
-	if (!ret) {
-		pr_err("%s: routing for syream %d failed\n", __func__,
-			payload_map.session_id);
-		ret = -EINVAL;
-		goto fail_cmd;
-	} else if (atomic_read(&this_adm.matrix_map_stat) > 0) {
-		pr_err("%s: DSP returned error[%s]\n", __func__,
-			adsp_err_get_err_str(atomic_read(
-			&this_adm.matrix_map_stat)));
-		ret = adsp_err_get_lnx_err_code(
-				atomic_read(&this_adm.matrix_map_stat));
+	ret = adm_send_matrix_map(matrix_map, payload_map.session_id);
+	if (ret < 0)
 		goto fail_cmd;
-	}
 
 	if ((perf_mode != ULTRA_LOW_LATENCY_PCM_MODE) &&
 		 (path != ADM_PATH_COMPRESSED_RX)) {
 		for (i = 0; i < payload_map.num_copps; i++) {
 			port_idx = afe_get_port_index(payload_map.port_id[i]);
 			copp_idx = payload_map.copp_idx[i];
-			if (port_idx < 0 || copp_idx < 0 ||
+			if (port_idx < 0 || port_idx >= AFE_MAX_PORTS ||
+			    copp_idx < 0 ||
 			    (copp_idx > MAX_COPPS_PER_PORT - 1)) {
 				pr_err("%s: Invalid idx port_idx %d copp_idx %d\n",
 					__func__, port_idx, copp_idx);
@@ -3658,9 +4894,15 @@ int adm_matrix_map(int path, struct route_payload payload_map, int perf_mode,
 					    payload_map.app_type[i],
 					    payload_map.acdb_dev_id[i]);
 
+			/*
+			 * FEs sharing this COPP map it concurrently, only one
+			 * of them sends cal and waits on the COPP at a time.
+			 */
+			mutex_lock(&this_adm.copp.lock[port_idx]);
 			if (!test_bit(ADM_STATUS_CALIBRATION_REQUIRED,
 				(void *)&this_adm.copp.adm_status[port_idx]
 								[copp_idx])) {
+				mutex_unlock(&this_adm.copp.lock[port_idx]);
 				pr_debug("%s: adm copp[0x%x][%d] already sent",
 						__func__, port_idx, copp_idx);
 				continue;
@@ -3675,6 +4917,7 @@ int adm_matrix_map(int path, struct route_payload payload_map, int perf_mode,
 			clear_bit(ADM_STATUS_CALIBRATION_REQUIRED,
 				(void *)&this_adm.copp.
 				adm_status[port_idx][copp_idx]);
+			mutex_unlock(&this_adm.copp.lock[port_idx]);
 			pr_debug("%s: copp_id: %d\n", __func__,
 				 atomic_read(&this_adm.copp.id[port_idx]
 							      [copp_idx]));
@@ -3800,20 +5043,8 @@ void adm_set_native_mode(int mode)
 }
 EXPORT_SYMBOL(adm_set_native_mode);
 
-/**
- * adm_close -
- *        command to close ADM copp
- *
- * @port_id: Port ID number
- * @perf_mode: performance mode like LL/ULL/..
- * @copp_idx: copp index assigned
- *
- * Returns 0 on success or error on failure
- */
-int adm_close(int port_id, int perf_mode, int copp_idx)
+static int __adm_close(int port_id, int perf_mode, int copp_idx)
 {
-	struct apr_hdr close;
-
 	int ret = 0, port_idx;
 	int copp_id = RESET_COPP_ID;
 
@@ -3842,99 +5073,15 @@ int adm_close(int port_id, int perf_mode, int copp_idx)
 		wake_up(&this_adm.copp.adm_delay_wait[port_idx][copp_idx]);
 	}
 
+	adm_chmix_invalidate(port_idx, copp_idx);
 	atomic_dec(&this_adm.copp.cnt[port_idx][copp_idx]);
 	if (!(atomic_read(&this_adm.copp.cnt[port_idx][copp_idx]))) {
+		if (adm_copp_cache_park(port_id, port_idx, perf_mode, copp_idx))
+			return 0;
 		copp_id = adm_get_copp_id(port_idx, copp_idx);
-		pr_debug("%s: Closing ADM port_idx:%d copp_idx:%d copp_id:0x%x\n",
-			 __func__, port_idx, copp_idx, copp_id);
-		if ((!perf_mode) && (this_adm.outband_memmap.paddr != 0) &&
-		    (atomic_read(&this_adm.copp.topology[port_idx][copp_idx]) ==
-			SRS_TRUMEDIA_TOPOLOGY_ID)) {
-			atomic_set(&this_adm.mem_map_index,
-				ADM_SRS_TRUMEDIA);
-			ret = adm_memory_unmap_regions();
-			if (ret < 0) {
-				pr_err("%s: adm mem unmmap err %d",
-					__func__, ret);
-			} else {
-				atomic_set(&this_adm.mem_map_handles
-					   [ADM_SRS_TRUMEDIA], 0);
-			}
-		}
-
-
-		if ((afe_get_port_type(port_id) == MSM_AFE_PORT_TYPE_TX) &&
-		    this_adm.sourceTrackingData.memmap.paddr) {
-			atomic_set(&this_adm.mem_map_index,
-				   ADM_MEM_MAP_INDEX_SOURCE_TRACKING);
-			ret = adm_memory_unmap_regions();
-			if (ret < 0) {
-				pr_err("%s: adm mem unmmap err %d",
-					__func__, ret);
-			}
-			msm_audio_ion_free(
-				this_adm.sourceTrackingData.dma_buf);
-			this_adm.sourceTrackingData.dma_buf = NULL;
-			this_adm.sourceTrackingData.memmap.size = 0;
-			this_adm.sourceTrackingData.memmap.kvaddr = NULL;
-			this_adm.sourceTrackingData.memmap.paddr = 0;
-			this_adm.sourceTrackingData.apr_cmd_status = -1;
-			atomic_set(&this_adm.mem_map_handles[
-					ADM_MEM_MAP_INDEX_SOURCE_TRACKING], 0);
-		}
-
-		close.hdr_field = APR_HDR_FIELD(APR_MSG_TYPE_SEQ_CMD,
-						APR_HDR_LEN(APR_HDR_SIZE),
-						APR_PKT_VER);
-		close.pkt_size = sizeof(close);
-		close.src_svc = APR_SVC_ADM;
-		close.src_domain = APR_DOMAIN_APPS;
-		close.src_port = port_id;
-		close.dest_svc = APR_SVC_ADM;
-		close.dest_domain = APR_DOMAIN_ADSP;
-		close.dest_port = copp_id;
-		close.token = port_idx << 16 | copp_idx;
-		close.opcode = ADM_CMD_DEVICE_CLOSE_V5;
-
-		atomic_set(&this_adm.copp.id[port_idx][copp_idx],
-			   RESET_COPP_ID);
-		atomic_set(&this_adm.copp.cnt[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.topology[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.mode[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.stat[port_idx][copp_idx], -1);
-		atomic_set(&this_adm.copp.rate[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.channels[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.bit_width[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.app_type[port_idx][copp_idx], 0);
-		atomic_set(&this_adm.copp.session_type[port_idx][copp_idx], 0);
-
-		clear_bit(ADM_STATUS_CALIBRATION_REQUIRED,
-			(void *)&this_adm.copp.adm_status[port_idx][copp_idx]);
-
-		ret = apr_send_pkt(this_adm.apr, (uint32_t *)&close);
-		if (ret < 0) {
-			pr_err("%s: ADM close failed %d\n", __func__, ret);
-			return -EINVAL;
-		}
-
-		ret = wait_event_timeout(this_adm.copp.wait[port_idx][copp_idx],
-			atomic_read(&this_adm.copp.stat
-			[port_idx][copp_idx]) >= 0,
-			msecs_to_jiffies(TIMEOUT_MS));
-		if (!ret) {
-			pr_err("%s: ADM cmd Route timedout for port 0x%x\n",
-				__func__, port_id);
-			return -EINVAL;
-		} else if (atomic_read(&this_adm.copp.stat
-					[port_idx][copp_idx]) > 0) {
-			pr_err("%s: DSP returned error[%s]\n",
-				__func__, adsp_err_get_err_str(
-				atomic_read(&this_adm.copp.stat
-				[port_idx][copp_idx])));
-			return adsp_err_get_lnx_err_code(
-					atomic_read(&this_adm.copp.stat
-						[port_idx][copp_idx]));
-		}
+		ret = adm_copp_release(port_id, port_idx, perf_mode, copp_idx);
+		if (ret)
+			return ret;
 	}
 
 	if (perf_mode != ULTRA_LOW_LATENCY_PCM_MODE) {
@@ -3947,6 +5094,33 @@ int adm_close(int port_id, int perf_mode, int copp_idx)
 
 	return 0;
 }
+
+/**
+ * adm_close -
+ *        command to close ADM copp
+ *
+ * @port_id: Port ID number
+ * @perf_mode: performance mode like LL/ULL/..
+ * @copp_idx: copp index assigned
+ *
+ * Returns 0 on success or error on failure
+ */
+int adm_close(int port_id, int perf_mode, int copp_idx)
+{
+	int port_idx, ret;
+
+	port_idx = adm_validate_and_get_port_index(
+			q6audio_convert_virtual_to_portid(port_id));
+	if (port_idx < 0) {
+		pr_err("%s: Invalid port_id 0x%x\n", __func__, port_id);
+		return -EINVAL;
+	}
+
+	mutex_lock(&this_adm.copp.lock[port_idx]);
+	ret = __adm_close(port_id, perf_mode, copp_idx);
+	mutex_unlock(&this_adm.copp.lock[port_idx]);
+	return ret;
+}
 EXPORT_SYMBOL(adm_close);
 
 int send_rtac_audvol_cal(void)
@@ -4050,8 +5224,8 @@ int adm_map_rtac_block(struct rtac_cal_block_data *cal_block)
 	}
 
 	/* valid port ID needed for callback use primary I2S */
-	atomic_set(&this_adm.mem_map_index, ADM_RTAC_APR_CAL);
-	result = adm_memory_map_regions(&cal_block->cal_data.paddr, 0,
+	result = adm_memory_map_regions(ADM_RTAC_APR_CAL,
+					&cal_block->cal_data.paddr, 0,
 					&cal_block->map_data.map_size, 1);
 	if (result < 0) {
 		pr_err("%s: RTAC mmap did not work! size = %d result %d\n",
@@ -4100,8 +5274,7 @@ int adm_unmap_rtac_block(uint32_t *mem_map_handle)
 	}
 
 	/* valid port ID needed for callback use primary I2S */
-	atomic_set(&this_adm.mem_map_index, ADM_RTAC_APR_CAL);
-	result = adm_memory_unmap_regions();
+	result = adm_memory_unmap_regions(ADM_RTAC_APR_CAL);
 	if (result < 0) {
 		pr_debug("%s: adm_memory_unmap_regions failed, error %d\n",
 			__func__, result);
@@ -4201,6 +5374,7 @@ static int adm_dealloc_cal(int32_t cal_type, size_t data_size, void *data)
 		ret = -EINVAL;
 		goto done;
 	}
+	adm_copp_cache_cal_changed();
 done:
 	return ret;
 }
@@ -4236,6 +5410,7 @@ static int adm_set_cal(int32_t cal_type, size_t data_size, void *data)
 	} else if (cal_index == ADM_RTAC_AUDVOL_CAL) {
 		send_rtac_audvol_cal();
 	}
+	adm_copp_cache_cal_changed();
 done:
 	return ret;
 }
@@ -4256,8 +5431,7 @@ static int adm_map_cal_data(int32_t cal_type,
 		goto done;
 	}
 
-	atomic_set(&this_adm.mem_map_index, cal_index);
-	ret = adm_memory_map_regions(&cal_block->cal_data.paddr, 0,
+	ret = adm_memory_map_regions(cal_index, &cal_block->cal_data.paddr, 0,
 		(uint32_t *)&cal_block->map_data.map_size, 1);
 	if (ret < 0) {
 		pr_err("%s: map did not work! cal_type %i ret %d\n",
@@ -4301,8 +5475,7 @@ static int adm_unmap_cal_data(int32_t cal_type,
 
 	atomic_set(&this_adm.mem_map_handles[cal_index],
 		cal_block->map_data.q6map_handle);
-	atomic_set(&this_adm.mem_map_index, cal_index);
-	ret = adm_memory_unmap_regions();
+	ret = adm_memory_unmap_regions(cal_index);
 	if (ret < 0) {
 		pr_err("%s: unmap did not work! cal_type %i ret %d\n",
 			__func__, cal_index, ret);
@@ -5199,6 +6372,7 @@ int adm_get_sound_focus(int port_id, int copp_idx,
 	int ret = 0, i;
 	char *params_value;
 	uint32_t max_param_size = 0;
+	uint32_t dsp_status = 0;
 	struct adm_param_fluence_soundfocus_t *soundfocus_params = NULL;
 	struct param_hdr_v3 param_hdr;
 
@@ -5216,24 +6390,21 @@ int adm_get_sound_focus(int port_id, int copp_idx,
 	param_hdr.instance_id = INSTANCE_ID_0;
 	param_hdr.param_id = VOICEPROC_PARAM_ID_FLUENCE_SOUNDFOCUS;
 	param_hdr.param_size = max_param_size;
-	ret = adm_get_pp_params(port_id, copp_idx,
-				ADM_CLIENT_ID_SOURCE_TRACKING, NULL, &param_hdr,
-				params_value);
+	ret = __adm_get_pp_params(port_id, copp_idx,
+				  ADM_CLIENT_ID_SOURCE_TRACKING, NULL,
+				  &param_hdr, params_value, &dsp_status);
+	if (dsp_status != 0) {
+		pr_err("%s - get params returned error [%s]\n",
+			__func__, adsp_err_get_err_str(dsp_status));
+		ret = adsp_err_get_lnx_err_code(dsp_status);
+		goto done;
+	}
 	if (ret) {
 		pr_err("%s: get parameters failed ret:%d\n", __func__, ret);
 		ret = -EINVAL;
 		goto done;
 	}
 
-	if (this_adm.sourceTrackingData.apr_cmd_status != 0) {
-		pr_err("%s - get params returned error [%s]\n",
-			__func__, adsp_err_get_err_str(
-			this_adm.sourceTrackingData.apr_cmd_status));
-		ret = adsp_err_get_lnx_err_code(
-				this_adm.sourceTrackingData.apr_cmd_status);
-		goto done;
-	}
-
 	soundfocus_params = (struct adm_param_fluence_soundfocus_t *)
 								params_value;
 	for (i = 0; i < MAX_SECTORS; i++) {
@@ -5256,60 +6427,6 @@ done:
 }
 EXPORT_SYMBOL(adm_get_sound_focus);
 
-static int adm_source_tracking_alloc_map_memory(void)
-{
-	int ret;
-
-	pr_debug("%s: Enter\n", __func__);
-
-	ret = msm_audio_ion_alloc(&this_adm.sourceTrackingData.dma_buf,
-				  AUD_PROC_BLOCK_SIZE,
-				  &this_adm.sourceTrackingData.memmap.paddr,
-				  &this_adm.sourceTrackingData.memmap.size,
-				  &this_adm.sourceTrackingData.memmap.kvaddr);
-	if (ret) {
-		pr_err("%s: failed to allocate memory\n", __func__);
-
-		ret = -EINVAL;
-		goto done;
-	}
-
-	atomic_set(&this_adm.mem_map_index, ADM_MEM_MAP_INDEX_SOURCE_TRACKING);
-	ret = adm_memory_map_regions(&this_adm.sourceTrackingData.memmap.paddr,
-			0,
-			(uint32_t *)&this_adm.sourceTrackingData.memmap.size,
-			1);
-	if (ret < 0) {
-		pr_err("%s: failed to map memory, paddr = 0x%pK, size = %d\n",
-			__func__,
-			(void *)this_adm.sourceTrackingData.memmap.paddr,
-			(uint32_t)this_adm.sourceTrackingData.memmap.size);
-
-		msm_audio_ion_free(this_adm.sourceTrackingData.dma_buf);
-		this_adm.sourceTrackingData.dma_buf = NULL;
-		this_adm.sourceTrackingData.memmap.size = 0;
-		this_adm.sourceTrackingData.memmap.kvaddr = NULL;
-		this_adm.sourceTrackingData.memmap.paddr = 0;
-		this_adm.sourceTrackingData.apr_cmd_status = -1;
-		atomic_set(&this_adm.mem_map_handles
-				[ADM_MEM_MAP_INDEX_SOURCE_TRACKING], 0);
-
-		ret = -EINVAL;
-		goto done;
-	}
-	ret = 0;
-	pr_debug("%s: paddr = 0x%pK, size = %d, mem_map_handle = 0x%x\n",
-		  __func__, (void *)this_adm.sourceTrackingData.memmap.paddr,
-		  (uint32_t)this_adm.sourceTrackingData.memmap.size,
-		  atomic_read(&this_adm.mem_map_handles
-			      [ADM_MEM_MAP_INDEX_SOURCE_TRACKING]));
-
-done:
-	pr_debug("%s: Exit, ret = %d\n", __func__, ret);
-
-	return ret;
-}
-
 /**
  * adm_get_source_tracking -
  *        Retrieve source tracking info
@@ -5325,32 +6442,16 @@ int adm_get_source_tracking(int port_id, int copp_idx,
 {
 	struct adm_param_fluence_sourcetracking_t *source_tracking_params =
 		NULL;
-	struct mem_mapping_hdr mem_hdr;
 	struct param_hdr_v3 param_hdr;
+	char *params_value;
+	uint32_t dsp_status = 0;
 	int i = 0;
 	int ret = 0;
 
 	pr_debug("%s: Enter, port_id %d, copp_idx %d\n",
 		  __func__, port_id, copp_idx);
 
-	if (!this_adm.sourceTrackingData.memmap.paddr) {
-		/* Allocate and map shared memory for out of band usage */
-		ret = adm_source_tracking_alloc_map_memory();
-		if (ret != 0) {
-			ret = -EINVAL;
-			goto done;
-		}
-	}
-
-	memset(&mem_hdr, 0, sizeof(mem_hdr));
 	memset(&param_hdr, 0, sizeof(param_hdr));
-	mem_hdr.data_payload_addr_lsw =
-		lower_32_bits(this_adm.sourceTrackingData.memmap.paddr);
-	mem_hdr.data_payload_addr_msw = msm_audio_populate_upper_32_bits(
-		this_adm.sourceTrackingData.memmap.paddr);
-	mem_hdr.mem_map_handle = atomic_read(
-		&this_adm.mem_map_handles[ADM_MEM_MAP_INDEX_SOURCE_TRACKING]);
-
 	param_hdr.module_id = VOICEPROC_MODULE_ID_FLUENCE_PRO_VC_TX;
 	param_hdr.instance_id = INSTANCE_ID_0;
 	param_hdr.param_id = VOICEPROC_PARAM_ID_FLUENCE_SOURCETRACKING;
@@ -5360,36 +6461,32 @@ int adm_get_source_tracking(int port_id, int copp_idx,
 	 */
 	param_hdr.param_size =
 		sizeof(struct adm_param_fluence_sourcetracking_t) +
-		sizeof(struct param_hdr_v3);
+		sizeof(union param_hdrs);
+	params_value = kzalloc(param_hdr.param_size, GFP_KERNEL);
+	if (!params_value)
+		return -ENOMEM;
 
 	/*
-	 * Retrieving parameters out of band, so no need to provide a buffer for
-	 * the returned parameter data as it will be at the memory location
-	 * provided.
+	 * adm_get_pp_params fetches this out of band through the param
+	 * pool and copies the payload, without the header, back here. The
+	 * slot status is reported so a DSP error is not mistaken for data.
 	 */
-	ret = adm_get_pp_params(port_id, copp_idx,
-				ADM_CLIENT_ID_SOURCE_TRACKING, &mem_hdr,
-				&param_hdr, NULL);
-	if (ret) {
-		pr_err("%s: Failed to get params, error %d\n", __func__, ret);
+	ret = __adm_get_pp_params(port_id, copp_idx,
+				  ADM_CLIENT_ID_SOURCE_TRACKING, NULL,
+				  &param_hdr, params_value, &dsp_status);
+	if (dsp_status != 0) {
+		pr_err("%s - get params returned error [%s]\n",
+			__func__, adsp_err_get_err_str(dsp_status));
+		ret = adsp_err_get_lnx_err_code(dsp_status);
 		goto done;
 	}
-
-	if (this_adm.sourceTrackingData.apr_cmd_status != 0) {
-		pr_err("%s - get params returned error [%s]\n",
-			__func__, adsp_err_get_err_str(
-			this_adm.sourceTrackingData.apr_cmd_status));
-
-		ret = adsp_err_get_lnx_err_code(
-				this_adm.sourceTrackingData.apr_cmd_status);
+	if (ret) {
+		pr_err("%s: Failed to get params, error %d\n", __func__, ret);
 		goto done;
 	}
 
-	/* How do we know what the param data was retrieved with for hdr size */
 	source_tracking_params =
-		(struct adm_param_fluence_sourcetracking_t
-			 *) (this_adm.sourceTrackingData.memmap.kvaddr +
-			     sizeof(struct param_hdr_v3));
+		(struct adm_param_fluence_sourcetracking_t *) params_value;
 	for (i = 0; i < MAX_SECTORS; i++) {
 		sourceTrackingData->vad[i] = source_tracking_params->vad[i];
 		pr_debug("%s: vad[%d] = %d\n",
@@ -5417,6 +6514,7 @@ int adm_get_source_tracking(int port_id, int copp_idx,
 done:
 	pr_debug("%s: Exit, ret=%d\n", __func__, ret);
 
+	kfree(params_value);
 	return ret;
 }
 EXPORT_SYMBOL(adm_get_source_tracking);
@@ -5496,6 +6594,146 @@ done:
 }
 EXPORT_SYMBOL(adm_get_doa_tracking_mon);
 
+#ifdef CONFIG_DEBUG_FS
+#define ADM_COPP_CACHE_BUF_SIZE 256
+static struct dentry *debugfs_adm_copp_cache;
+
+static ssize_t adm_copp_cache_read(struct file *filp, char __user *ubuf,
+				   size_t cnt, loff_t *ppos)
+{
+	struct adm_copp_cache_stats *stats = &this_adm.copp_cache_stats;
+	char buf[ADM_COPP_CACHE_BUF_SIZE];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf),
+			"parked %d hit %d miss %d expired %d evicted %d\n",
+			atomic_read(&this_adm.copp_cache_cnt),
+			atomic_read(&stats->hit), atomic_read(&stats->miss),
+			atomic_read(&stats->expired),
+			atomic_read(&stats->evicted));
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t adm_copp_cache_write(struct file *filp,
+				    const char __user *ubuf,
+				    size_t cnt, loff_t *ppos)
+{
+	struct adm_copp_cache_stats *stats = &this_adm.copp_cache_stats;
+
+	atomic_set(&stats->hit, 0);
+	atomic_set(&stats->miss, 0);
+	atomic_set(&stats->expired, 0);
+	atomic_set(&stats->evicted, 0);
+
+	return cnt;
+}
+
+static const struct file_operations adm_copp_cache_ops = {
+	.read = adm_copp_cache_read,
+	.write = adm_copp_cache_write,
+};
+
+static struct dentry *debugfs_adm_cmd_stats;
+
+static ssize_t adm_cmd_stats_read(struct file *filp, char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	char buf[ADM_COPP_CACHE_BUF_SIZE];
+	int i, len = 0;
+
+	for (i = 0; i < ADM_CMD_STAT_MAX; i++)
+		len += scnprintf(buf + len, sizeof(buf) - len, "%s %lld\n",
+				 adm_cmd_stat_names[i],
+				 atomic64_read(&this_adm.cmd_stats[i]));
+	len += scnprintf(buf + len, sizeof(buf) - len, "total %lld\n",
+			 atomic64_read(&this_adm.cmd_total));
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t adm_cmd_stats_write(struct file *filp,
+				   const char __user *ubuf,
+				   size_t cnt, loff_t *ppos)
+{
+	int i;
+
+	for (i = 0; i < ADM_CMD_STAT_MAX; i++)
+		atomic64_set(&this_adm.cmd_stats[i], 0);
+	atomic64_set(&this_adm.cmd_total, 0);
+
+	return cnt;
+}
+
+static const struct file_operations adm_cmd_stats_ops = {
+	.read = adm_cmd_stats_read,
+	.write = adm_cmd_stats_write,
+};
+
+static struct dentry *debugfs_adm_chmix_cache;
+
+static ssize_t adm_chmix_cache_read(struct file *filp, char __user *ubuf,
+				    size_t cnt, loff_t *ppos)
+{
+	struct adm_chmix_cache *cache = &this_adm.chmix_cache;
+	char buf[ADM_COPP_CACHE_BUF_SIZE];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf), "hit %d miss %d skipped %d\n",
+			atomic_read(&cache->hit), atomic_read(&cache->miss),
+			atomic_read(&cache->skipped));
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+}
+
+static ssize_t adm_chmix_cache_write(struct file *filp,
+				     const char __user *ubuf,
+				     size_t cnt, loff_t *ppos)
+{
+	struct adm_chmix_cache *cache = &this_adm.chmix_cache;
+
+	atomic_set(&cache->hit, 0);
+	atomic_set(&cache->miss, 0);
+	atomic_set(&cache->skipped, 0);
+
+	return cnt;
+}
+
+static const struct file_operations adm_chmix_cache_ops = {
+	.read = adm_chmix_cache_read,
+	.write = adm_chmix_cache_write,
+};
+
+static void adm_debugfs_init(void)
+{
+	debugfs_adm_copp_cache = debugfs_create_file("msm_adm_copp_cache",
+						     S_IFREG | 0644, NULL, NULL,
+						     &adm_copp_cache_ops);
+	debugfs_adm_cmd_stats = debugfs_create_file("msm_adm_cmd_stats",
+						    S_IFREG | 0644, NULL, NULL,
+						    &adm_cmd_stats_ops);
+	debugfs_adm_chmix_cache = debugfs_create_file("msm_adm_chmix_cache",
+						      S_IFREG | 0644, NULL,
+						      NULL,
+						      &adm_chmix_cache_ops);
+}
+
+static void adm_debugfs_exit(void)
+{
+	debugfs_remove(debugfs_adm_chmix_cache);
+	debugfs_remove(debugfs_adm_cmd_stats);
+	debugfs_remove(debugfs_adm_copp_cache);
+}
+#else
+static void adm_debugfs_init(void)
+{
+}
+
+static void adm_debugfs_exit(void)
+{
+}
+#endif
+
 int __init adm_init(void)
 {
 	int i = 0, j;
@@ -5504,8 +6742,12 @@ int __init adm_init(void)
 	this_adm.ffecns_port_id = -1;
 	init_waitqueue_head(&this_adm.matrix_map_wait);
 	init_waitqueue_head(&this_adm.adm_wait);
+	mutex_init(&this_adm.matrix_map_lock);
+	mutex_init(&this_adm.adm_stat_lock);
+	INIT_DELAYED_WORK(&this_adm.copp_cache_work, adm_copp_cache_reap);
 
 	for (i = 0; i < AFE_MAX_PORTS; i++) {
+		mutex_init(&this_adm.copp.lock[i]);
 		for (j = 0; j < MAX_COPPS_PER_PORT; j++) {
 			atomic_set(&this_adm.copp.id[i][j], RESET_COPP_ID);
 			init_waitqueue_head(&this_adm.copp.wait[i][j]);
@@ -5517,18 +6759,39 @@ int __init adm_init(void)
 	if (adm_init_cal_data())
 		pr_err("%s: could not init cal data!\n", __func__);
 
-	this_adm.sourceTrackingData.dma_buf = NULL;
-	this_adm.sourceTrackingData.memmap.size = 0;
-	this_adm.sourceTrackingData.memmap.kvaddr = NULL;
-	this_adm.sourceTrackingData.memmap.paddr = 0;
-	this_adm.sourceTrackingData.apr_cmd_status = -1;
+	mutex_init(&this_adm.param_pool.lock);
+	spin_lock_init(&this_adm.param_pool.slot_lock);
+	for (i = 0; i < ADM_PARAM_POOL_SLOTS; i++)
+		init_waitqueue_head(&this_adm.param_pool.wait[i]);
+
+	mutex_init(&this_adm.chmix_cache.lock);
+	this_adm.chmix_cache.scratch = kmalloc(ADM_CHMIX_PARAM_MAX,
+					       GFP_KERNEL);
 
+	adm_debugfs_init();
 	return 0;
 }
 
 void adm_exit(void)
 {
+	int i;
+
+	adm_debugfs_exit();
+	cancel_delayed_work_sync(&this_adm.copp_cache_work);
+	adm_param_pool_unmap();
 	if (this_adm.apr)
 		adm_reset_data();
 	adm_delete_cal_data();
+	if (this_adm.param_pool.dma_buf)
+		adm_param_pool_free(&this_adm.param_pool);
+	mutex_destroy(&this_adm.param_pool.lock);
+	for (i = 0; i < ADM_CHMIX_CACHE_SLOTS; i++)
+		kfree(this_adm.chmix_cache.entry[i].pkt);
+	kfree(this_adm.chmix_cache.scratch);
+	mutex_destroy(&this_adm.chmix_cache.lock);
+
+	for (i = 0; i < AFE_MAX_PORTS; i++)
+		mutex_destroy(&this_adm.copp.lock[i]);
+	mutex_destroy(&this_adm.adm_stat_lock);
+	mutex_destroy(&this_adm.matrix_map_lock);
 }
@@ -2,6 +2,7 @@
 /* Copyright (c) 2012-2020, The Linux Foundation. All rights reserved.
  */
 #include <linux/slab.h>
+#include <linux/module.h>
 #include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/kthread.h>
@@ -104,6 +105,22 @@ struct wlock {
 
 static struct wlock wl;
 
+/*
+ * Skip the common port calibration on port start if the DSP was last sent
+ * the same block content for the same port topology. Off by default since
+ * it relies on the AFE keeping port parameters across stop and start.
+ */
+static bool afe_cal_skip_unchanged;
+module_param(afe_cal_skip_unchanged, bool, 0664);
+MODULE_PARM_DESC(afe_cal_skip_unchanged, "Do not resend unchanged port cal");
+
+/* Last common calibration sent to a port */
+struct afe_cal_record {
+	int cal_index;
+	uint32_t cal_version;
+	int topology;
+};
+
 struct afe_ctl {
 	void *apr;
 	atomic_t state;
@@ -135,6 +152,7 @@ struct afe_ctl {
 	struct work_struct afe_spdif_work;
 
 	int	topology[AFE_MAX_PORTS];
+	struct afe_cal_record cal_record[AFE_MAX_PORTS];
 	struct cal_type_data *cal_data[MAX_AFE_CAL_TYPES];
 
 	atomic_t mem_map_cal_handles[MAX_AFE_CAL_TYPES];
@@ -161,6 +179,8 @@ struct afe_ctl {
 	struct mutex afe_apr_lock;
 	struct mutex afe_clk_lock;
 	int set_custom_topology;
+	/* cal_version of the custom topology the DSP holds */
+	uint32_t custom_top_version;
 	int dev_acdb_id[AFE_MAX_PORTS];
 	routing_cb rt_cb;
 	struct audio_uevent_data *uevent_data;
@@ -632,7 +652,9 @@ static int32_t afe_callback(struct apr_client_data *data, void *priv)
 		/* Reset the custom topology mode: to resend again to AFE. */
 		mutex_lock(&this_afe.cal_data[AFE_CUST_TOPOLOGY_CAL]->lock);
 		this_afe.set_custom_topology = 1;
+		this_afe.custom_top_version = 0;
 		mutex_unlock(&this_afe.cal_data[AFE_CUST_TOPOLOGY_CAL]->lock);
+		memset(this_afe.cal_record, 0, sizeof(this_afe.cal_record));
 		rtac_clear_mapping(AFE_RTAC_CAL);
 
 		if (this_afe.apr) {
@@ -1201,7 +1223,7 @@ static int q6afe_set_params_v2(u16 port_id, int index,
 
 	if (packed_param_data != NULL)
 		size += packed_data_size;
-	set_param = kzalloc(size, GFP_KERNEL);
+	set_param = q6common_pkt_alloc(size);
 	if (set_param == NULL)
 		return -ENOMEM;
 
@@ -1235,7 +1257,7 @@ static int q6afe_set_params_v2(u16 port_id, int index,
 
 	rc = afe_apr_send_pkt(set_param, &this_afe.wait[index]);
 done:
-	kfree(set_param);
+	q6common_pkt_free(set_param);
 	return rc;
 }
 
@@ -1250,7 +1272,7 @@ static int q6afe_set_params_v3(u16 port_id, int index,
 
 	if (packed_param_data != NULL)
 		size += packed_data_size;
-	set_param = kzalloc(size, GFP_KERNEL);
+	set_param = q6common_pkt_alloc(size);
 	if (set_param == NULL)
 		return -ENOMEM;
 
@@ -1278,7 +1300,7 @@ static int q6afe_set_params_v3(u16 port_id, int index,
 
 	rc = afe_apr_send_pkt(set_param, &this_afe.wait[index]);
 done:
-	kfree(set_param);
+	q6common_pkt_free(set_param);
 	return rc;
 }
 
@@ -1323,7 +1345,7 @@ static int q6afe_pack_and_set_param_in_band(u16 port_id, int index,
 	int packed_data_size = sizeof(union param_hdrs) + param_hdr.param_size;
 	int ret;
 
-	packed_param_data = kzalloc(packed_data_size, GFP_KERNEL);
+	packed_param_data = q6common_pkt_alloc(packed_data_size);
 	if (packed_param_data == NULL)
 		return -ENOMEM;
 
@@ -1339,7 +1361,7 @@ static int q6afe_pack_and_set_param_in_band(u16 port_id, int index,
 			       packed_data_size);
 
 fail_cmd:
-	kfree(packed_param_data);
+	q6common_pkt_free(packed_param_data);
 	return ret;
 }
 
@@ -1863,6 +1885,12 @@ static void afe_send_custom_topology(void)
 		goto unlock;
 	}
 
+	if (this_afe.custom_top_version &&
+	    cal_block->cal_version == this_afe.custom_top_version) {
+		pr_debug("%s: custom topology unchanged\n", __func__);
+		goto unlock;
+	}
+
 	pr_debug("%s: Sending cal_index cal %d\n", __func__, cal_index);
 
 	ret = remap_cal_data(cal_block, cal_index);
@@ -1877,6 +1905,7 @@ static void afe_send_custom_topology(void)
 			__func__, cal_index, ret);
 		goto unlock;
 	}
+	this_afe.custom_top_version = cal_block->cal_version;
 	pr_debug("%s:sent custom topology for AFE\n", __func__);
 unlock:
 	mutex_unlock(&this_afe.cal_data[cal_index]->lock);
@@ -2706,6 +2735,7 @@ exit:
 static int send_afe_cal_type(int cal_index, int port_id)
 {
 	struct cal_block_data		*cal_block = NULL;
+	struct afe_cal_record		*record;
 	int ret;
 	int afe_port_index = q6audio_get_port_index(port_id);
 
@@ -2744,6 +2774,18 @@ static int send_afe_cal_type(int cal_index, int port_id)
 		goto unlock;
 	}
 
+	record = &this_afe.cal_record[afe_port_index];
+	if (afe_cal_skip_unchanged && cal_index != AFE_AANC_CAL &&
+	    record->cal_version &&
+	    record->cal_version == cal_block->cal_version &&
+	    record->cal_index == cal_index &&
+	    record->topology == this_afe.topology[afe_port_index]) {
+		pr_debug("%s: cal_index %d unchanged for port_id 0x%x\n",
+			 __func__, cal_index, port_id);
+		ret = 0;
+		goto mark_used;
+	}
+
 	pr_info("%s: Sending cal_index cal %d\n", __func__, cal_index);
 
 	ret = remap_cal_data(cal_block, cal_index);
@@ -2754,10 +2796,17 @@ static int send_afe_cal_type(int cal_index, int port_id)
 		goto unlock;
 	}
 	ret = afe_send_cal_block(port_id, cal_block);
-	if (ret < 0)
+	if (ret < 0) {
 		pr_err("%s: No cal sent for cal_index %d, port_id = 0x%x! ret %d\n",
 			__func__, cal_index, port_id, ret);
+		record->cal_version = 0;
+	} else {
+		record->cal_index = cal_index;
+		record->cal_version = cal_block->cal_version;
+		record->topology = this_afe.topology[afe_port_index];
+	}
 
+mark_used:
 	cal_utils_mark_cal_used(cal_block);
 
 unlock:
@@ -7127,7 +7176,7 @@ static int afe_sidetone_iir(u16 tx_port_id)
 	struct param_hdr_v3 param_hdr;
 	u8 *packed_param_data = NULL;
 	u32 packed_param_size = 0;
-	u32 single_param_size = 0;
+	u32 packed_buf_size = 0;
 	struct audio_cal_info_sidetone_iir *st_iir_cal_info = NULL;
 
 	memset(&enable, 0, sizeof(enable));
@@ -7173,9 +7222,9 @@ static int afe_sidetone_iir(u16 tx_port_id)
 	memcpy(&filter_data.iir_config, &st_iir_cal_info->iir_config, size);
 	mutex_unlock(&this_afe.cal_data[cal_index]->lock);
 
-	packed_param_size =
+	packed_buf_size =
 		sizeof(param_hdr) * 2 + sizeof(enable) + sizeof(filter_data);
-	packed_param_data = kzalloc(packed_param_size, GFP_KERNEL);
+	packed_param_data = q6common_pkt_alloc(packed_buf_size);
 	if (!packed_param_data)
 		return -ENOMEM;
 	packed_param_size = 0;
@@ -7188,14 +7237,14 @@ static int afe_sidetone_iir(u16 tx_port_id)
 	param_hdr.param_id = AFE_PARAM_ID_ENABLE;
 	param_hdr.param_size = sizeof(enable);
 	enable.enable = iir_enable;
-	ret = q6common_pack_pp_params(packed_param_data, &param_hdr,
-				      (u8 *) &enable, &single_param_size);
+	ret = q6common_pack_pp_params_append(packed_param_data, packed_buf_size,
+					     &packed_param_size, &param_hdr,
+					     (u8 *) &enable);
 	if (ret) {
 		pr_err("%s: Failed to pack param data, error %d\n", __func__,
 		       ret);
 		goto done;
 	}
-	packed_param_size += single_param_size;
 
 	/*
 	 * Set IIR filter config params
@@ -7207,15 +7256,14 @@ static int afe_sidetone_iir(u16 tx_port_id)
 			       sizeof(filter_data.pregain) + size;
 	filter_data.num_biquad_stages = iir_num_biquad_stages;
 	filter_data.pregain = iir_pregain;
-	ret = q6common_pack_pp_params(packed_param_data + packed_param_size,
-				      &param_hdr, (u8 *) &filter_data,
-				      &single_param_size);
+	ret = q6common_pack_pp_params_append(packed_param_data, packed_buf_size,
+					     &packed_param_size, &param_hdr,
+					     (u8 *) &filter_data);
 	if (ret) {
 		pr_err("%s: Failed to pack param data, error %d\n", __func__,
 		       ret);
 		goto done;
 	}
-	packed_param_size += single_param_size;
 
 	pr_debug("%s: tx(0x%x)mid(0x%x)iir_en(%d)stg(%d)gain(0x%x)size(%d)\n",
 		 __func__, tx_port_id, mid, enable.enable,
@@ -7229,7 +7277,7 @@ static int afe_sidetone_iir(u16 tx_port_id)
 			 __func__, tx_port_id);
 
 done:
-	kfree(packed_param_data);
+	q6common_pkt_free(packed_param_data);
 	return ret;
 }
 
@@ -14,6 +14,7 @@
  *
  */
 #include <linux/fs.h>
+#include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/miscdevice.h>
@@ -27,6 +28,8 @@
 #include <linux/time.h>
 #include <linux/atomic.h>
 #include <linux/mm.h>
+#include <linux/bitmap.h>
+#include <linux/hashtable.h>
 
 #include <asm/ioctls.h>
 
@@ -43,6 +46,9 @@
 #include <dsp/q6core.h>
 #include "adsp_err.h"
 
+#define CREATE_TRACE_POINTS
+#include "q6asm_trace.h"
+
 #define TIMEOUT_MS  1000
 #define TRUE        0x01
 #define FALSE       0x00
@@ -72,6 +78,8 @@ union asm_token_struct {
 enum {
 	ASM_DIRECTION_OFFSET,
 	ASM_CMD_NO_WAIT_OFFSET,
+	/* Command is part of a q6asm_send_batch() submission */
+	ASM_CMD_BATCH_OFFSET,
 	/*
 	 * Offset is limited to 7 because flags is stored in u8
 	 * field in asm_token_structure defined above. The offset
@@ -101,10 +109,21 @@ struct audio_session {
 	struct audio_client *ac;
 	spinlock_t session_lock;
 	struct mutex mutex_lock_per_session;
+	struct hlist_node node;
 };
 /* session id: 0 reserved */
 static struct audio_session session[ASM_ACTIVE_STREAMS_ALLOWED + 1];
 
+/*
+ * Session ids are handed out from a bitmap and active sessions are also
+ * hashed by their audio_client pointer, so neither open/close nor the
+ * client validity checks in the callback path scan the session table.
+ */
+#define ASM_SESSION_HASH_BITS	5
+static DEFINE_SPINLOCK(session_id_lock);
+static DECLARE_BITMAP(session_map, ASM_ACTIVE_STREAMS_ALLOWED + 1);
+static DEFINE_HASHTABLE(session_hash, ASM_SESSION_HASH_BITS);
+
 struct asm_buffer_node {
 	struct list_head list;
 	phys_addr_t buf_phys_addr;
@@ -135,8 +154,15 @@ static struct cal_type_data *cal_data[ASM_MAX_CAL_TYPES];
 static struct audio_buffer common_buf[2];
 static struct audio_client common_client;
 static int set_custom_topology;
+/* cal_version of the custom topology the DSP holds */
+static uint32_t custom_top_version;
 static int topology_map_handle;
 
+/* Run session callbacks from the APR service thread, data events stay inline */
+static bool asm_cb_deferred;
+module_param(asm_cb_deferred, bool, 0664);
+MODULE_PARM_DESC(asm_cb_deferred, "Defer ASM session callbacks off rx context");
+
 struct generic_get_data_ {
 	int valid;
 	int is_inband;
@@ -575,31 +601,57 @@ int q6asm_mmap_apr_dereg(void)
 
 static int q6asm_session_alloc(struct audio_client *ac)
 {
+	unsigned long flags;
 	int n;
 
-	for (n = 1; n <= ASM_ACTIVE_STREAMS_ALLOWED; n++) {
-		if (!(session[n].ac)) {
-			session[n].ac = ac;
-			return n;
-		}
+	spin_lock_irqsave(&session_id_lock, flags);
+	n = find_next_zero_bit(session_map, ASM_ACTIVE_STREAMS_ALLOWED + 1, 1);
+	if (n > ASM_ACTIVE_STREAMS_ALLOWED) {
+		spin_unlock_irqrestore(&session_id_lock, flags);
+		pr_err("%s: session not available\n", __func__);
+		return -ENOMEM;
+	}
+	__set_bit(n, session_map);
+	session[n].ac = ac;
+	hash_add(session_hash, &session[n].node, (unsigned long)ac);
+	spin_unlock_irqrestore(&session_id_lock, flags);
+
+	return n;
+}
+
+static void q6asm_session_release(int n)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&session_id_lock, flags);
+	if (session[n].ac) {
+		hash_del(&session[n].node);
+		session[n].ac = NULL;
+		__clear_bit(n, session_map);
 	}
-	pr_err("%s: session not available\n", __func__);
-	return -ENOMEM;
+	spin_unlock_irqrestore(&session_id_lock, flags);
 }
 
 static int q6asm_get_session_id_from_audio_client(struct audio_client *ac)
 {
-	int n;
+	struct audio_session *s;
+	unsigned long flags;
+	int n = 0;
 
-	for (n = 1; n <= ASM_ACTIVE_STREAMS_ALLOWED; n++) {
-		if (session[n].ac == ac)
-			return n;
+	spin_lock_irqsave(&session_id_lock, flags);
+	hash_for_each_possible(session_hash, s, node, (unsigned long)ac) {
+		if (s->ac == ac) {
+			n = s - session;
+			break;
+		}
 	}
+	spin_unlock_irqrestore(&session_id_lock, flags);
 
-	pr_debug("%s: cannot find matching audio client. ac = %pK\n",
-		__func__, ac);
+	if (!n)
+		pr_debug("%s: cannot find matching audio client. ac = %pK\n",
+			__func__, ac);
 
-	return 0;
+	return n;
 }
 
 static bool q6asm_is_valid_audio_client(struct audio_client *ac)
@@ -617,7 +669,7 @@ static void q6asm_session_free(struct audio_client *ac)
 	mutex_lock(&session[session_id].mutex_lock_per_session);
 	rtac_remove_popp_from_adm_devices(ac->session);
 	spin_lock_irqsave(&(session[session_id].session_lock), flags);
-	session[ac->session].ac = NULL;
+	q6asm_session_release(session_id);
 	ac->session = 0;
 	ac->perf_mode = LEGACY_PCM_MODE;
 	ac->fptr_cache_ops = NULL;
@@ -811,6 +863,12 @@ int send_asm_custom_topology(struct audio_client *ac)
 	if (cal_block == NULL || cal_utils_is_cal_stale(cal_block))
 		goto unlock;
 
+	if (custom_top_version &&
+	    cal_block->cal_version == custom_top_version) {
+		pr_debug("%s: custom topology unchanged\n", __func__);
+		goto unlock;
+	}
+
 	if (cal_block->cal_data.size == 0) {
 		pr_debug("%s: No cal to send!\n", __func__);
 		goto unlock;
@@ -866,6 +924,7 @@ int send_asm_custom_topology(struct audio_client *ac)
 			atomic_read(&ac->mem_state));
 		goto unmap;
 	}
+	custom_top_version = cal_block->cal_version;
 
 unmap:
 	result1 = q6asm_unmap_cal_memory(ASM_CUST_TOPOLOGY_CAL_TYPE,
@@ -1334,14 +1393,14 @@ struct audio_client *q6asm_audio_client_alloc(app_cb cb, void *priv)
 	if (!ac)
 		return NULL;
 
-	mutex_lock(&session_lock);
 	n = q6asm_session_alloc(ac);
 	if (n <= 0) {
 		pr_err("%s: ASM Session alloc fail n=%d\n", __func__, n);
-		mutex_unlock(&session_lock);
 		kfree(ac);
 		goto fail_session;
 	}
+
+	mutex_lock(&session_lock);
 	ac->session = n;
 	ac->cb = cb;
 	ac->path_delay = UINT_MAX;
@@ -1372,6 +1431,12 @@ struct audio_client *q6asm_audio_client_alloc(app_cb cb, void *priv)
 		goto fail_apr2;
 	}
 
+	if (asm_cb_deferred &&
+	    apr_set_cb_mode(ac->apr, APR_CB_MODE_DEFERRED |
+				     APR_CB_MODE_INLINE_DATA))
+		pr_debug("%s: session %d callbacks stay inline\n",
+			 __func__, n);
+
 	rtac_set_asm_handle(n, ac->apr);
 
 	pr_debug("%s: Registering the common port with APR\n", __func__);
@@ -1716,6 +1781,7 @@ static int32_t q6asm_srvc_callback(struct apr_client_data *data, void *priv)
 		common_client.mmap_apr = NULL;
 		mutex_lock(&cal_data[ASM_CUSTOM_TOP_CAL]->lock);
 		set_custom_topology = 1;
+		custom_top_version = 0;
 		mutex_unlock(&cal_data[ASM_CUSTOM_TOP_CAL]->lock);
 		topology_map_handle = 0;
 		rtac_clear_mapping(ASM_RTAC_CAL);
@@ -1904,6 +1970,20 @@ static void q6asm_process_mtmx_get_param_rsp(struct audio_client *ac,
 	}
 }
 
+static void q6asm_batch_ack(struct audio_client *ac, uint32_t *payload,
+			    uint32_t payload_size)
+{
+	if (payload_size >= 2 * sizeof(uint32_t) && payload[1] != 0) {
+		pr_err("%s: cmd = 0x%x returned error = 0x%x\n",
+			__func__, payload[0], payload[1]);
+		/* Keep the first error of the batch and its command */
+		if (!atomic_cmpxchg(&ac->batch_state, 0, payload[1]))
+			ac->batch_err_opcode = payload[0];
+	}
+	if (atomic_dec_return(&ac->batch_pending) <= 0)
+		wake_up(&ac->cmd_wait);
+}
+
 static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 {
 	int i = 0;
@@ -2001,6 +2081,16 @@ static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 				__func__, data->payload_size);
 	}
 	if (data->opcode == APR_BASIC_RSP_RESULT) {
+		if (q6asm_get_flag_from_token(&asm_token,
+					      ASM_CMD_BATCH_OFFSET)) {
+			q6asm_batch_ack(ac, payload, data->payload_size);
+			if (ac->cb)
+				ac->cb(data->opcode, data->token,
+					(uint32_t *)data->payload, ac->priv);
+			spin_unlock_irqrestore(
+				&(session[session_id].session_lock), flags);
+			return 0;
+		}
 		switch (payload[0]) {
 		case ASM_STREAM_CMD_SET_PP_PARAMS_V2:
 		case ASM_STREAM_CMD_SET_PP_PARAMS_V3:
@@ -2183,6 +2273,10 @@ static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 	switch (data->opcode) {
 	case ASM_DATA_EVENT_WRITE_DONE_V2:{
 		struct audio_port_data *port = &ac->port[IN];
+
+		/* async buffers are not tracked, match on q6asm_async_write */
+		if (!(ac->io_mode & SYNC_IO_MODE))
+			trace_q6asm_write_done(ac->session, data->token, 0, 0);
 		if (data->payload_size >= 2 * sizeof(uint32_t))
 			dev_vdbg(ac->dev, "%s: Rxed opcode[0x%x] status[0x%x] token[%d]",
 					__func__, payload[0], payload[1],
@@ -2228,6 +2322,9 @@ static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 				return -EINVAL;
 			}
 			port->buf[buf_index].used = 1;
+			trace_q6asm_write_done(ac->session, buf_index,
+					       port->buf[buf_index].write_len,
+					       port->buf[buf_index].write_ts);
 			spin_unlock_irqrestore(&port->dsp_lock, dsp_flags);
 
 			config_debug_fs_write_cb();
@@ -2288,6 +2385,12 @@ static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 		struct audio_port_data *port = &ac->port[OUT];
 
 		config_debug_fs_read_cb();
+		trace_q6asm_read_done(ac->session,
+			(ac->io_mode & SYNC_IO_MODE) ?
+			asm_token._token.buf_index : data->token,
+			payload[READDONE_IDX_SIZE],
+			((uint64_t)payload[READDONE_IDX_MSW_TS] << 32) |
+			payload[READDONE_IDX_LSW_TS]);
 
 		dev_vdbg(ac->dev, "%s: ReadDone: status=%d buff_add=0x%x act_size=%d offset=%d\n",
 				__func__, payload[READDONE_IDX_STATUS],
@@ -2565,6 +2668,7 @@ void *q6asm_is_cpu_buf_avail(int dir, struct audio_client *ac, uint32_t *size,
 						ac->session,
 						port->cpu_buf,
 						data, *size);
+		trace_q6asm_cpu_buf_avail(ac->session, dir, idx, *size);
 		/* By default increase the cpu_buf cnt
 		 * user accesses this function,increase cpu
 		 * buf(to avoid another api)
@@ -2616,6 +2720,8 @@ int q6asm_cpu_buf_release(int dir, struct audio_client *ac)
 			goto exit;
 		}
 		port->buf[port->cpu_buf].used = dir ^ 1;
+		trace_q6asm_cpu_buf_release(ac->session, dir, port->cpu_buf,
+					    port->buf[port->cpu_buf].size);
 		mutex_unlock(&port->lock);
 	}
 exit:
@@ -2905,7 +3011,7 @@ int q6asm_set_pp_params(struct audio_client *ac,
 	/* Add param size to packet size when sending in-band only */
 	if (param_data != NULL)
 		pkt_size += param_size;
-	asm_set_param = kzalloc(pkt_size, GFP_KERNEL);
+	asm_set_param = q6common_pkt_alloc(pkt_size);
 	if (!asm_set_param)
 		return -ENOMEM;
 
@@ -2975,7 +3081,7 @@ int q6asm_set_pp_params(struct audio_client *ac,
 	ret = 0;
 done:
 	mutex_unlock(&session[session_id].mutex_lock_per_session);
-	kfree(asm_set_param);
+	q6common_pkt_free(asm_set_param);
 	return ret;
 }
 EXPORT_SYMBOL(q6asm_set_pp_params);
@@ -3003,7 +3109,7 @@ int q6asm_pack_and_set_pp_param_in_band(struct audio_client *ac,
                 return -EINVAL;
         }
 
-	packed_data = kzalloc(packed_size, GFP_KERNEL);
+	packed_data = q6common_pkt_alloc(packed_size);
 	if (packed_data == NULL)
 		return -ENOMEM;
 
@@ -3016,7 +3122,7 @@ int q6asm_pack_and_set_pp_param_in_band(struct audio_client *ac,
 
 	ret = q6asm_set_pp_params(ac, NULL, packed_data, packed_size);
 done:
-	kfree(packed_data);
+	q6common_pkt_free(packed_data);
 	return ret;
 }
 EXPORT_SYMBOL(q6asm_pack_and_set_pp_param_in_band);
@@ -3457,36 +3563,25 @@ fail_cmd:
 }
 EXPORT_SYMBOL(q6asm_open_write_compressed);
 
-static int __q6asm_open_write(struct audio_client *ac, uint32_t format,
-			      uint16_t bits_per_sample, uint32_t stream_id,
-			      bool is_gapless_mode,
-			      uint32_t pcm_format_block_ver)
+static int q6asm_prep_open_write(struct audio_client *ac,
+				 struct asm_stream_cmd_open_write_v3 *open,
+				 uint32_t format, uint16_t bits_per_sample,
+				 uint32_t stream_id, bool is_gapless_mode,
+				 uint32_t pcm_format_block_ver)
 {
-	int rc = 0x00;
-	struct asm_stream_cmd_open_write_v3 open;
 	struct q6asm_cal_info cal_info;
 
-	if (ac == NULL) {
-		pr_err("%s: APR handle NULL\n", __func__);
-		return -EINVAL;
-	}
-	if (ac->apr == NULL) {
-		pr_err("%s: AC APR handle NULL\n", __func__);
-		return -EINVAL;
-	}
-
 	dev_vdbg(ac->dev, "%s: session[%d] wr_format[0x%x]\n",
 		__func__, ac->session, format);
 
-	q6asm_stream_add_hdr(ac, &open.hdr, sizeof(open), TRUE, stream_id);
-	atomic_set(&ac->cmd_state, -1);
+	q6asm_stream_add_hdr(ac, &open->hdr, sizeof(*open), TRUE, stream_id);
 	/*
 	 * Updated the token field with stream/session for compressed playback
 	 * Platform driver must know the the stream with which the command is
 	 * associated
 	 */
 	if (ac->io_mode & COMPRESSED_STREAM_IO)
-		q6asm_update_token(&open.hdr.token,
+		q6asm_update_token(&open->hdr.token,
 				   ac->session,
 				   stream_id,
 				   0, /* Buffer index is NA */
@@ -3494,105 +3589,132 @@ static int __q6asm_open_write(struct audio_client *ac, uint32_t format,
 				   WAIT_CMD);
 
 	dev_vdbg(ac->dev, "%s: token = 0x%x, stream_id  %d, session 0x%x\n",
-			__func__, open.hdr.token, stream_id, ac->session);
-	open.hdr.opcode = ASM_STREAM_CMD_OPEN_WRITE_V3;
-	open.mode_flags = 0x00;
+			__func__, open->hdr.token, stream_id, ac->session);
+	open->hdr.opcode = ASM_STREAM_CMD_OPEN_WRITE_V3;
+	open->mode_flags = 0x00;
 	if (ac->perf_mode == ULL_POST_PROCESSING_PCM_MODE)
-		open.mode_flags |= ASM_ULL_POST_PROCESSING_STREAM_SESSION;
+		open->mode_flags |= ASM_ULL_POST_PROCESSING_STREAM_SESSION;
 	else if (ac->perf_mode == ULTRA_LOW_LATENCY_PCM_MODE)
-		open.mode_flags |= ASM_ULTRA_LOW_LATENCY_STREAM_SESSION;
+		open->mode_flags |= ASM_ULTRA_LOW_LATENCY_STREAM_SESSION;
 	else if (ac->perf_mode == LOW_LATENCY_PCM_MODE)
-		open.mode_flags |= ASM_LOW_LATENCY_STREAM_SESSION;
+		open->mode_flags |= ASM_LOW_LATENCY_STREAM_SESSION;
 	else {
-		open.mode_flags |= ASM_LEGACY_STREAM_SESSION;
+		open->mode_flags |= ASM_LEGACY_STREAM_SESSION;
 		if (is_gapless_mode)
-			open.mode_flags |= 1 << ASM_SHIFT_GAPLESS_MODE_FLAG;
+			open->mode_flags |= 1 << ASM_SHIFT_GAPLESS_MODE_FLAG;
 	}
 
 	/* source endpoint : matrix */
-	open.sink_endpointype = ASM_END_POINT_DEVICE_MATRIX;
-	open.bits_per_sample = bits_per_sample;
+	open->sink_endpointype = ASM_END_POINT_DEVICE_MATRIX;
+	open->bits_per_sample = bits_per_sample;
 
-	rc = q6asm_get_asm_topology_apptype(&cal_info);
-	open.postprocopo_id = cal_info.topology_id;
+	q6asm_get_asm_topology_apptype(&cal_info);
+	open->postprocopo_id = cal_info.topology_id;
 
 	if (ac->perf_mode != LEGACY_PCM_MODE)
-		open.postprocopo_id = ASM_STREAM_POSTPROCOPO_ID_NONE;
+		open->postprocopo_id = ASM_STREAM_POSTPROCOPO_ID_NONE;
 
 	pr_debug("%s: perf_mode %d asm_topology 0x%x bps %d\n", __func__,
-		 ac->perf_mode, open.postprocopo_id, open.bits_per_sample);
+		 ac->perf_mode, open->postprocopo_id, open->bits_per_sample);
 
 	/*
 	 * For Gapless playback it will use the same session for next stream,
 	 * So use the same topology
 	 */
 	if (!ac->topology) {
-		ac->topology = open.postprocopo_id;
+		ac->topology = open->postprocopo_id;
 		ac->app_type = cal_info.app_type;
 	}
 	switch (format) {
 	case FORMAT_LINEAR_PCM:
-		open.dec_fmt_id = q6asm_get_pcm_format_id(pcm_format_block_ver);
+		open->dec_fmt_id =
+			q6asm_get_pcm_format_id(pcm_format_block_ver);
 		break;
 	case FORMAT_MPEG4_AAC:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AAC_V2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AAC_V2;
 		break;
 	case FORMAT_MPEG4_MULTI_AAC:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AAC_V2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AAC_V2;
 		break;
 	case FORMAT_WMA_V9:
-		open.dec_fmt_id = ASM_MEDIA_FMT_WMA_V9_V2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_WMA_V9_V2;
 		break;
 	case FORMAT_WMA_V10PRO:
-		open.dec_fmt_id = ASM_MEDIA_FMT_WMA_V10PRO_V2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_WMA_V10PRO_V2;
 		break;
 	case FORMAT_AMRNB:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AMRNB_FS;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AMRNB_FS;
 		break;
 	case FORMAT_AMRWB:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AMRWB_FS;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AMRWB_FS;
 		break;
 	case FORMAT_AMR_WB_PLUS:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AMR_WB_PLUS_V2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AMR_WB_PLUS_V2;
 		break;
 	case FORMAT_MP3:
-		open.dec_fmt_id = ASM_MEDIA_FMT_MP3;
+		open->dec_fmt_id = ASM_MEDIA_FMT_MP3;
 		break;
 	case FORMAT_AC3:
-		open.dec_fmt_id = ASM_MEDIA_FMT_AC3;
+		open->dec_fmt_id = ASM_MEDIA_FMT_AC3;
 		break;
 	case FORMAT_EAC3:
-		open.dec_fmt_id = ASM_MEDIA_FMT_EAC3;
+		open->dec_fmt_id = ASM_MEDIA_FMT_EAC3;
 		break;
 	case FORMAT_MP2:
-		open.dec_fmt_id = ASM_MEDIA_FMT_MP2;
+		open->dec_fmt_id = ASM_MEDIA_FMT_MP2;
 		break;
 	case FORMAT_FLAC:
-		open.dec_fmt_id = ASM_MEDIA_FMT_FLAC;
+		open->dec_fmt_id = ASM_MEDIA_FMT_FLAC;
 		break;
 	case FORMAT_ALAC:
-		open.dec_fmt_id = ASM_MEDIA_FMT_ALAC;
+		open->dec_fmt_id = ASM_MEDIA_FMT_ALAC;
 		break;
 	case FORMAT_VORBIS:
-		open.dec_fmt_id = ASM_MEDIA_FMT_VORBIS;
+		open->dec_fmt_id = ASM_MEDIA_FMT_VORBIS;
 		break;
 	case FORMAT_APE:
-		open.dec_fmt_id = ASM_MEDIA_FMT_APE;
+		open->dec_fmt_id = ASM_MEDIA_FMT_APE;
 		break;
 	case FORMAT_DSD:
-		open.dec_fmt_id = ASM_MEDIA_FMT_DSD;
+		open->dec_fmt_id = ASM_MEDIA_FMT_DSD;
 		break;
 	case FORMAT_APTX:
-		open.dec_fmt_id = ASM_MEDIA_FMT_APTX;
+		open->dec_fmt_id = ASM_MEDIA_FMT_APTX;
 		break;
 	case FORMAT_GEN_COMPR:
-		open.dec_fmt_id = ASM_MEDIA_FMT_GENERIC_COMPRESSED;
+		open->dec_fmt_id = ASM_MEDIA_FMT_GENERIC_COMPRESSED;
 		break;
 	default:
 		pr_err("%s: Invalid format 0x%x\n", __func__, format);
-		rc = -EINVAL;
-		goto fail_cmd;
+		return -EINVAL;
 	}
+
+	return 0;
+}
+
+static int __q6asm_open_write(struct audio_client *ac, uint32_t format,
+			      uint16_t bits_per_sample, uint32_t stream_id,
+			      bool is_gapless_mode,
+			      uint32_t pcm_format_block_ver)
+{
+	int rc = 0x00;
+	struct asm_stream_cmd_open_write_v3 open;
+
+	if (ac == NULL) {
+		pr_err("%s: APR handle NULL\n", __func__);
+		return -EINVAL;
+	}
+	if (ac->apr == NULL) {
+		pr_err("%s: AC APR handle NULL\n", __func__);
+		return -EINVAL;
+	}
+
+	rc = q6asm_prep_open_write(ac, &open, format, bits_per_sample,
+				   stream_id, is_gapless_mode,
+				   pcm_format_block_ver);
+	if (rc)
+		goto fail_cmd;
+	atomic_set(&ac->cmd_state, -1);
 	rc = apr_send_pkt(ac->apr, (uint32_t *) &open);
 	if (rc < 0) {
 		pr_err("%s: open failed op[0x%x]rc[%d]\n",
@@ -7013,19 +7135,14 @@ fail_cmd:
 	return rc;
 }
 
-static int __q6asm_media_format_block_multi_ch_pcm_v5(struct audio_client *ac,
-						      uint32_t rate,
-						      uint32_t channels,
-						      bool use_default_chmap,
-						      char *channel_map,
-						      uint16_t bits_per_sample,
-						      uint16_t sample_word_size,
-						      uint16_t endianness,
-						      uint16_t mode)
+static int q6asm_prep_fmt_pcm_v5(struct audio_client *ac,
+			struct asm_multi_channel_pcm_fmt_blk_param_v5 *fmt,
+			uint32_t rate, uint32_t channels,
+			bool use_default_chmap, char *channel_map,
+			uint16_t bits_per_sample, uint16_t sample_word_size,
+			uint16_t endianness, uint16_t mode)
 {
-	struct asm_multi_channel_pcm_fmt_blk_param_v5 fmt;
 	u8 *channel_mapping;
-	int rc;
 
 	if (channels > PCM_FORMAT_MAX_NUM_CHANNEL_V8) {
 		pr_err("%s: Invalid channel count %d\n", __func__, channels);
@@ -7036,21 +7153,20 @@ static int __q6asm_media_format_block_multi_ch_pcm_v5(struct audio_client *ac,
 		 ac->session, rate, channels,
 		 bits_per_sample, sample_word_size);
 
-	memset(&fmt, 0, sizeof(fmt));
-	q6asm_add_hdr(ac, &fmt.hdr, sizeof(fmt), TRUE);
-	atomic_set(&ac->cmd_state, -1);
-
-	fmt.hdr.opcode = ASM_DATA_CMD_MEDIA_FMT_UPDATE_V2;
-	fmt.fmt_blk.fmt_blk_size = sizeof(fmt) - sizeof(fmt.hdr) -
-					sizeof(fmt.fmt_blk);
-	fmt.param.num_channels = channels;
-	fmt.param.bits_per_sample = bits_per_sample;
-	fmt.param.sample_rate = rate;
-	fmt.param.is_signed = 1;
-	fmt.param.sample_word_size = sample_word_size;
-	fmt.param.endianness = endianness;
-	fmt.param.mode = mode;
-	channel_mapping = fmt.param.channel_mapping;
+	memset(fmt, 0, sizeof(*fmt));
+	q6asm_add_hdr(ac, &fmt->hdr, sizeof(*fmt), TRUE);
+
+	fmt->hdr.opcode = ASM_DATA_CMD_MEDIA_FMT_UPDATE_V2;
+	fmt->fmt_blk.fmt_blk_size = sizeof(*fmt) - sizeof(fmt->hdr) -
+					sizeof(fmt->fmt_blk);
+	fmt->param.num_channels = channels;
+	fmt->param.bits_per_sample = bits_per_sample;
+	fmt->param.sample_rate = rate;
+	fmt->param.is_signed = 1;
+	fmt->param.sample_word_size = sample_word_size;
+	fmt->param.endianness = endianness;
+	fmt->param.mode = mode;
+	channel_mapping = fmt->param.channel_mapping;
 
 	memset(channel_mapping, 0, PCM_FORMAT_MAX_NUM_CHANNEL_V8);
 
@@ -7058,14 +7174,37 @@ static int __q6asm_media_format_block_multi_ch_pcm_v5(struct audio_client *ac,
 		if (q6asm_map_channels(channel_mapping, channels, false)) {
 			pr_err("%s: map channels failed %d\n",
 			       __func__, channels);
-			rc = -EINVAL;
-			goto fail_cmd;
+			return -EINVAL;
 		}
 	} else {
 		memcpy(channel_mapping, channel_map,
 			 PCM_FORMAT_MAX_NUM_CHANNEL_V8);
 	}
 
+	return 0;
+}
+
+static int __q6asm_media_format_block_multi_ch_pcm_v5(struct audio_client *ac,
+						      uint32_t rate,
+						      uint32_t channels,
+						      bool use_default_chmap,
+						      char *channel_map,
+						      uint16_t bits_per_sample,
+						      uint16_t sample_word_size,
+						      uint16_t endianness,
+						      uint16_t mode)
+{
+	struct asm_multi_channel_pcm_fmt_blk_param_v5 fmt;
+	int rc;
+
+	rc = q6asm_prep_fmt_pcm_v5(ac, &fmt, rate, channels,
+				   use_default_chmap, channel_map,
+				   bits_per_sample, sample_word_size,
+				   endianness, mode);
+	if (rc)
+		goto fail_cmd;
+	atomic_set(&ac->cmd_state, -1);
+
 	rc = apr_send_pkt(ac->apr, (uint32_t *) &fmt);
 	if (rc < 0) {
 		pr_err("%s: Comamnd open failed %d\n", __func__, rc);
@@ -9333,6 +9472,7 @@ static int __q6asm_read(struct audio_client *ac, bool is_custom_len_reqd,
 		dev_vdbg(ac->dev, "%s: buf add[%pK] token[0x%x] uid[%d]\n",
 				__func__, &ab->phys, read.hdr.token,
 				read.seq_id);
+		trace_q6asm_read(ac->session, read.seq_id, read.buf_size, 0);
 		rc = apr_send_pkt(ac->apr, (uint32_t *) &read);
 		if (rc < 0) {
 			pr_err("%s: read op[0x%x]rc[%d]\n",
@@ -9446,6 +9586,7 @@ int q6asm_read_nolock(struct audio_client *ac)
 		dev_vdbg(ac->dev, "%s: buf add[%pK] token[0x%x] uid[%d]\n",
 				__func__, &ab->phys, read.hdr.token,
 				read.seq_id);
+		trace_q6asm_read(ac->session, read.seq_id, read.buf_size, 0);
 		rc = apr_send_pkt(ac->apr, (uint32_t *) &read);
 		if (rc < 0) {
 			pr_err("%s: read op[0x%x]rc[%d]\n",
@@ -9542,6 +9683,9 @@ int q6asm_async_write(struct audio_client *ac,
 		}
 	}
 
+	trace_q6asm_async_write(ac->session, param->uid, write.buf_size,
+				((uint64_t)write.timestamp_msw << 32) |
+				write.timestamp_lsw);
 	rc = apr_send_pkt(ac->apr, (uint32_t *) &write);
 	if (rc < 0) {
 		pr_err("%s: write op[0x%x]rc[%d]\n", __func__,
@@ -9688,6 +9832,8 @@ int q6asm_write(struct audio_client *ac, uint32_t len, uint32_t msw_ts,
 		write.seq_id = port->dsp_buf;
 		write.timestamp_lsw = lsw_ts;
 		write.timestamp_msw = msw_ts;
+		ab->write_len = len;
+		ab->write_ts = ((uint64_t)msw_ts << 32) | lsw_ts;
 		/* Use 0xFF00 for disabling timestamps */
 		if (flags == 0xFF00)
 			write.flags = (0x00000000 | (flags & 0x800000FF));
@@ -9711,6 +9857,7 @@ int q6asm_write(struct audio_client *ac, uint32_t len, uint32_t msw_ts,
 		mutex_unlock(&port->lock);
 
 		config_debug_fs_write(ab);
+		trace_q6asm_write(ac->session, dsp_buf, len, ab->write_ts);
 
 		rc = apr_send_pkt(ac->apr, (uint32_t *) &write);
 		if (rc < 0) {
@@ -9782,6 +9929,8 @@ int q6asm_write_nolock(struct audio_client *ac, uint32_t len, uint32_t msw_ts,
 		write.seq_id = port->dsp_buf;
 		write.timestamp_lsw = lsw_ts;
 		write.timestamp_msw = msw_ts;
+		ab->write_len = len;
+		ab->write_ts = ((uint64_t)msw_ts << 32) | lsw_ts;
 		buf_node = list_first_entry(&ac->port[IN].mem_map_handle,
 				struct asm_buffer_node,
 				list);
@@ -9803,6 +9952,7 @@ int q6asm_write_nolock(struct audio_client *ac, uint32_t len, uint32_t msw_ts,
 				write.buf_size,
 				write.mem_map_handle);
 
+		trace_q6asm_write(ac->session, dsp_buf, len, ab->write_ts);
 		rc = apr_send_pkt(ac->apr, (uint32_t *) &write);
 		if (rc < 0) {
 			pr_err("%s: write op[0x%x]rc[%d]\n",
@@ -11202,6 +11352,173 @@ done:
 }
 EXPORT_SYMBOL(q6asm_send_cal);
 
+/* Returns the number of commands sent or error */
+static int q6asm_send_batch(struct audio_client *ac, struct apr_hdr **pkts,
+			    int cnt)
+{
+	union asm_token_struct asm_token;
+	int i, sent;
+
+	for (i = 0; i < cnt; i++) {
+		asm_token.token = pkts[i]->token;
+		q6asm_set_flag_in_token(&asm_token, 1, ASM_CMD_BATCH_OFFSET);
+		pkts[i]->token = asm_token.token;
+	}
+
+	atomic_set(&ac->batch_state, 0);
+	ac->batch_err_opcode = 0;
+	atomic_set(&ac->batch_pending, cnt);
+	sent = apr_send_pkt_batch(ac->apr, (uint32_t **)pkts, cnt);
+	if (sent < 0) {
+		pr_err("%s: batch send failed rc %d\n", __func__, sent);
+		atomic_set(&ac->batch_pending, 0);
+		return -EINVAL;
+	}
+	/* Only wait for the acks of what actually went out */
+	if (sent < cnt)
+		atomic_sub(cnt - sent, &ac->batch_pending);
+
+	return sent;
+}
+
+static int q6asm_wait_batch(struct audio_client *ac, int cnt, int sent)
+{
+	int rc;
+
+	rc = wait_event_timeout(ac->cmd_wait,
+			(atomic_read(&ac->batch_pending) <= 0 ||
+			 atomic_read(&ac->reset)),
+			msecs_to_jiffies(TIMEOUT_MS));
+	if (!rc) {
+		pr_err("%s: timeout, %d of %d cmds pending\n", __func__,
+		       atomic_read(&ac->batch_pending), sent);
+		atomic_set(&ac->batch_pending, 0);
+		return -ETIMEDOUT;
+	}
+	if (atomic_read(&ac->reset))
+		return -ENETRESET;
+	if (atomic_read(&ac->batch_state) > 0) {
+		pr_err("%s: DSP returned error[%s]\n", __func__,
+		       adsp_err_get_err_str(atomic_read(&ac->batch_state)));
+		return adsp_err_get_lnx_err_code(
+				atomic_read(&ac->batch_state));
+	}
+	if (sent < cnt) {
+		pr_err("%s: only %d of %d cmds sent\n", __func__, sent, cnt);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * q6asm_open_write_batch -
+ *       open a PCM playback stream and send its stream
+ *       calibration with a single APR round trip
+ *
+ * @ac: Audio client handle
+ * @setup: stream configuration
+ *
+ * Sends ASM_STREAM_CMD_OPEN_WRITE_V3 and the stream calibration back
+ * to back and waits once for both acks. The media format still has to
+ * be sent by the caller once the session is routed. As with
+ * q6asm_send_cal(), a calibration failure is only logged.
+ *
+ * Returns 0 on success or error on failure
+ */
+int q6asm_open_write_batch(struct audio_client *ac,
+			   struct q6asm_write_setup *setup)
+{
+	struct asm_stream_cmd_open_write_v3 open;
+	struct asm_stream_cmd_set_pp_params cal;
+	struct cal_block_data *cal_block = NULL;
+	struct apr_hdr *pkts[2];
+	bool cal_locked = false;
+	int cal_idx = -1;
+	int cnt = 0, sent;
+	int rc;
+
+	if (ac == NULL || setup == NULL) {
+		pr_err("%s: %s is NULL\n", __func__,
+		       ac == NULL ? "APR handle" : "setup");
+		return -EINVAL;
+	}
+	if (ac->apr == NULL) {
+		pr_err("%s: AC APR handle NULL\n", __func__);
+		return -EINVAL;
+	}
+
+	rc = q6asm_prep_open_write(ac, &open, FORMAT_LINEAR_PCM,
+				   setup->bits_per_sample, ac->stream_id,
+				   false /*gapless*/, PCM_MEDIA_FORMAT_V5);
+	if (rc)
+		return rc;
+	pkts[cnt++] = &open.hdr;
+
+	if (setup->send_cal && !(ac->io_mode & NT_MODE) &&
+	    ac->perf_mode != ULTRA_LOW_LATENCY_PCM_MODE &&
+	    cal_data[ASM_AUDSTRM_CAL] != NULL) {
+		mutex_lock(&cal_data[ASM_AUDSTRM_CAL]->lock);
+		cal_locked = true;
+		cal_block = cal_utils_get_only_cal_block(
+					cal_data[ASM_AUDSTRM_CAL]);
+		if (cal_block && (cal_utils_is_cal_stale(cal_block) ||
+		    cal_block->cal_data.size == 0 ||
+		    remap_cal_data(ASM_AUDSTRM_CAL_TYPE, cal_block)))
+			cal_block = NULL;
+		if (cal_block) {
+			memset(&cal, 0, sizeof(cal));
+			q6asm_add_hdr_async(ac, &cal.apr_hdr, sizeof(cal),
+					    TRUE);
+			if (q6common_is_instance_id_supported())
+				cal.apr_hdr.opcode =
+					ASM_STREAM_CMD_SET_PP_PARAMS_V3;
+			else
+				cal.apr_hdr.opcode =
+					ASM_STREAM_CMD_SET_PP_PARAMS_V2;
+			cal.mem_hdr.data_payload_addr_lsw =
+				lower_32_bits(cal_block->cal_data.paddr);
+			cal.mem_hdr.data_payload_addr_msw =
+				msm_audio_populate_upper_32_bits(
+					cal_block->cal_data.paddr);
+			cal.mem_hdr.mem_map_handle =
+				cal_block->map_data.q6map_handle;
+			cal.payload_size = cal_block->cal_data.size;
+			cal_idx = cnt;
+			pkts[cnt++] = &cal.apr_hdr;
+		}
+	}
+
+	sent = q6asm_send_batch(ac, pkts, cnt);
+	if (cal_locked) {
+		if (cal_idx >= 0 && sent > cal_idx)
+			cal_utils_mark_cal_used(cal_block);
+		mutex_unlock(&cal_data[ASM_AUDSTRM_CAL]->lock);
+	}
+	if (sent <= 0)
+		return sent < 0 ? sent : -EINVAL;
+
+	rc = q6asm_wait_batch(ac, cnt, sent);
+	if (rc && cal_idx >= 0) {
+		if (atomic_read(&ac->batch_state) > 0 &&
+		    (ac->batch_err_opcode == ASM_STREAM_CMD_SET_PP_PARAMS_V2 ||
+		     ac->batch_err_opcode == ASM_STREAM_CMD_SET_PP_PARAMS_V3)) {
+			/* the open went through, only the stream cal failed */
+			pr_debug("%s: stream cal failed %d\n", __func__, rc);
+			rc = 0;
+		} else if (rc == -EINVAL && !atomic_read(&ac->batch_state) &&
+			   sent == cal_idx) {
+			/* the open was acked, the stream cal never went out */
+			pr_debug("%s: stream cal not sent\n", __func__);
+			rc = 0;
+		}
+	}
+	if (!rc)
+		ac->io_mode |= TUN_WRITE_IO_MODE;
+	return rc;
+}
+EXPORT_SYMBOL(q6asm_open_write_batch);
+
 static int get_cal_type_index(int32_t cal_type)
 {
 	int ret = -EINVAL;
@@ -11381,8 +11698,11 @@ int __init q6asm_init(void)
 
 	pr_debug("%s:\n", __func__);
 
+	BUILD_BUG_ON(ASM_CONTROL_SESSION > U8_MAX);
 	memset(session, 0, sizeof(struct audio_session) *
 		(ASM_ACTIVE_STREAMS_ALLOWED + 1));
+	bitmap_zero(session_map, ASM_ACTIVE_STREAMS_ALLOWED + 1);
+	hash_init(session_hash);
 	for (lcnt = 0; lcnt <= ASM_ACTIVE_STREAMS_ALLOWED; lcnt++) {
 		spin_lock_init(&(session[lcnt].session_lock));
 		mutex_init(&(session[lcnt].mutex_lock_per_session));
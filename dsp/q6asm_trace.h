@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM q6asm
+
+#if !defined(_Q6ASM_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _Q6ASM_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Data buffer handoff between the CPU and the DSP. @buf is the buffer
+ * index in sync IO mode and the client buffer id in async IO mode, @ts
+ * is the DSP session timestamp in microseconds where one is carried.
+ * Sync mode write done events repeat the size and timestamp of the
+ * write they complete; in async mode they carry 0 for both.
+ */
+DECLARE_EVENT_CLASS(q6asm_buf,
+
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+
+	TP_ARGS(session, buf, size, ts),
+
+	TP_STRUCT__entry(
+		__field(int, session)
+		__field(uint32_t, buf)
+		__field(uint32_t, size)
+		__field(uint64_t, ts)
+	),
+
+	TP_fast_assign(
+		__entry->session = session;
+		__entry->buf = buf;
+		__entry->size = size;
+		__entry->ts = ts;
+	),
+
+	TP_printk("session=%d buf=%u size=%u ts=%llu",
+		  __entry->session, __entry->buf, __entry->size,
+		  __entry->ts)
+);
+
+DEFINE_EVENT(q6asm_buf, q6asm_write,
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+	TP_ARGS(session, buf, size, ts)
+);
+
+DEFINE_EVENT(q6asm_buf, q6asm_async_write,
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+	TP_ARGS(session, buf, size, ts)
+);
+
+DEFINE_EVENT(q6asm_buf, q6asm_read,
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+	TP_ARGS(session, buf, size, ts)
+);
+
+DEFINE_EVENT(q6asm_buf, q6asm_write_done,
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+	TP_ARGS(session, buf, size, ts)
+);
+
+DEFINE_EVENT(q6asm_buf, q6asm_read_done,
+	TP_PROTO(int session, uint32_t buf, uint32_t size, uint64_t ts),
+	TP_ARGS(session, buf, size, ts)
+);
+
+/* CPU side buffer ownership in sync IO mode, @dir is IN or OUT */
+DECLARE_EVENT_CLASS(q6asm_cpu_buf,
+
+	TP_PROTO(int session, int dir, uint32_t buf, uint32_t size),
+
+	TP_ARGS(session, dir, buf, size),
+
+	TP_STRUCT__entry(
+		__field(int, session)
+		__field(int, dir)
+		__field(uint32_t, buf)
+		__field(uint32_t, size)
+	),
+
+	TP_fast_assign(
+		__entry->session = session;
+		__entry->dir = dir;
+		__entry->buf = buf;
+		__entry->size = size;
+	),
+
+	TP_printk("session=%d dir=%d buf=%u size=%u",
+		  __entry->session, __entry->dir, __entry->buf,
+		  __entry->size)
+);
+
+DEFINE_EVENT(q6asm_cpu_buf, q6asm_cpu_buf_avail,
+	TP_PROTO(int session, int dir, uint32_t buf, uint32_t size),
+	TP_ARGS(session, dir, buf, size)
+);
+
+DEFINE_EVENT(q6asm_cpu_buf, q6asm_cpu_buf_release,
+	TP_PROTO(int session, int dir, uint32_t buf, uint32_t size),
+	TP_ARGS(session, dir, buf, size)
+);
+
+#endif /* _Q6ASM_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE q6asm_trace
+
+#include <trace/define_trace.h>
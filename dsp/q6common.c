@@ -3,6 +3,11 @@
  * Copyright (c) 2017-2019, The Linux Foundation. All rights reserved.
  */
 
+#include <linux/slab.h>
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <sound/audio_effects.h>
 #include <dsp/q6common.h>
 
 struct q6common_ctl {
@@ -175,3 +180,265 @@ int q6common_pack_pp_params_v2(u8 *dest, struct param_hdr_v3 *v3_hdr,
 	return 0;
 }
 EXPORT_SYMBOL(q6common_pack_pp_params_v2);
+
+/**
+ * q6common_pack_pp_params_append
+ *
+ * Pack one more parameter (header + payload) at @offset in a buffer
+ * holding several packed parameters, and advance @offset past it.
+ *
+ * @dest: start of the packed parameter buffer
+ * @dest_size: size of the buffer at @dest
+ * @offset: current fill level of @dest, updated on success
+ * @v3_hdr: param header v3
+ * @param_data: param payload, may be NULL
+ *
+ * Returns 0 on success or error on failure
+ */
+int q6common_pack_pp_params_append(u8 *dest, u32 dest_size, u32 *offset,
+				   struct param_hdr_v3 *v3_hdr,
+				   u8 *param_data)
+{
+	u32 needed = 0;
+	u32 packed_size = 0;
+	int ret = 0;
+
+	if (dest == NULL || offset == NULL || v3_hdr == NULL) {
+		pr_err("%s: Received NULL pointer\n", __func__);
+		return -EINVAL;
+	}
+
+	needed = q6common_is_instance_id_supported() ?
+			sizeof(struct param_hdr_v3) :
+			sizeof(struct param_hdr_v1);
+	if (param_data != NULL)
+		needed += v3_hdr->param_size;
+	if (*offset > dest_size || needed > dest_size - *offset) {
+		pr_err("%s: No room for param 0x%x, offset %u need %u size %u\n",
+		       __func__, v3_hdr->param_id, *offset, needed, dest_size);
+		return -ENOSPC;
+	}
+
+	ret = q6common_pack_pp_params(dest + *offset, v3_hdr, param_data,
+				      &packed_size);
+	if (ret)
+		return ret;
+
+	*offset += packed_size;
+	return 0;
+}
+EXPORT_SYMBOL(q6common_pack_pp_params_append);
+
+/*
+ * Set param packets are built, sent and freed on every volume step and
+ * effect update. Serve them from a small set of preallocated buffers
+ * instead of the page allocator; a request that does not fit, or that
+ * finds its size class busy, falls back to kzalloc.
+ */
+#define Q6COMMON_PKT_SMALL_SIZE		512
+#define Q6COMMON_PKT_SMALL_NUM		16
+#define Q6COMMON_PKT_LARGE_SIZE		(MAX_INBAND_PARAM_SZ + 256)
+#define Q6COMMON_PKT_LARGE_NUM		4
+
+struct q6common_pkt_pool {
+	u8 *base;
+	u32 buf_size;
+	u32 num_bufs;
+	unsigned long in_use;
+};
+
+struct q6common_pkt_stats {
+	atomic_t allocs;
+	atomic_t pool_hits;
+	atomic_t oversize;
+	atomic_t exhausted;
+	atomic_t in_use;
+	atomic_t in_use_max;
+};
+
+static struct q6common_pkt_pool pkt_pools[] = {
+	{ .buf_size = Q6COMMON_PKT_SMALL_SIZE,
+	  .num_bufs = Q6COMMON_PKT_SMALL_NUM },
+	{ .buf_size = Q6COMMON_PKT_LARGE_SIZE,
+	  .num_bufs = Q6COMMON_PKT_LARGE_NUM },
+};
+
+static struct q6common_pkt_stats pkt_stats;
+
+static bool q6common_pkt_in_pool(struct q6common_pkt_pool *pool, void *pkt)
+{
+	u8 *p = pkt;
+
+	return pool->base && p >= pool->base &&
+	       p < pool->base + pool->buf_size * pool->num_bufs;
+}
+
+static void q6common_pkt_track_in_use(void)
+{
+	int cur = atomic_inc_return(&pkt_stats.in_use);
+	int max = atomic_read(&pkt_stats.in_use_max);
+
+	while (cur > max) {
+		int old = atomic_cmpxchg(&pkt_stats.in_use_max, max, cur);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+/**
+ * q6common_pkt_alloc
+ *
+ * Get a zeroed buffer for a set param packet of @size bytes. Must be
+ * released with q6common_pkt_free().
+ *
+ * @size: number of bytes needed
+ *
+ * Returns buffer pointer or NULL on allocation failure
+ */
+void *q6common_pkt_alloc(u32 size)
+{
+	struct q6common_pkt_pool *pool = NULL;
+	bool fits = false;
+	void *pkt = NULL;
+	int i, bit;
+
+	atomic_inc(&pkt_stats.allocs);
+	for (i = 0; i < ARRAY_SIZE(pkt_pools); i++) {
+		pool = &pkt_pools[i];
+		if (!pool->base || size > pool->buf_size)
+			continue;
+		fits = true;
+		for (;;) {
+			bit = find_first_zero_bit(&pool->in_use,
+						  pool->num_bufs);
+			if (bit >= pool->num_bufs)
+				break;
+			if (test_and_set_bit(bit, &pool->in_use))
+				continue;
+			pkt = pool->base + bit * pool->buf_size;
+			memset(pkt, 0, size);
+			atomic_inc(&pkt_stats.pool_hits);
+			q6common_pkt_track_in_use();
+			return pkt;
+		}
+	}
+
+	if (fits)
+		atomic_inc(&pkt_stats.exhausted);
+	else
+		atomic_inc(&pkt_stats.oversize);
+
+	pkt = kzalloc(size, GFP_KERNEL);
+	if (pkt)
+		q6common_pkt_track_in_use();
+	return pkt;
+}
+EXPORT_SYMBOL(q6common_pkt_alloc);
+
+/**
+ * q6common_pkt_free
+ *
+ * Release a buffer obtained from q6common_pkt_alloc().
+ *
+ * @pkt: buffer to release, may be NULL
+ */
+void q6common_pkt_free(void *pkt)
+{
+	struct q6common_pkt_pool *pool = NULL;
+	int i;
+
+	if (!pkt)
+		return;
+
+	atomic_dec(&pkt_stats.in_use);
+	for (i = 0; i < ARRAY_SIZE(pkt_pools); i++) {
+		pool = &pkt_pools[i];
+		if (q6common_pkt_in_pool(pool, pkt)) {
+			clear_bit(((u8 *) pkt - pool->base) / pool->buf_size,
+				  &pool->in_use);
+			return;
+		}
+	}
+	kfree(pkt);
+}
+EXPORT_SYMBOL(q6common_pkt_free);
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *debugfs_pkt_stats;
+
+static ssize_t q6common_pkt_stats_read(struct file *file,
+				       char __user *ubuf, size_t count,
+				       loff_t *ppos)
+{
+	char buf[256];
+	int len = 0;
+
+	len = scnprintf(buf, sizeof(buf),
+			"allocs: %d\npool_hits: %d\noversize: %d\n"
+			"exhausted: %d\nin_use: %d\nin_use_max: %d\n",
+			atomic_read(&pkt_stats.allocs),
+			atomic_read(&pkt_stats.pool_hits),
+			atomic_read(&pkt_stats.oversize),
+			atomic_read(&pkt_stats.exhausted),
+			atomic_read(&pkt_stats.in_use),
+			atomic_read(&pkt_stats.in_use_max));
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static ssize_t q6common_pkt_stats_write(struct file *file,
+					const char __user *ubuf,
+					size_t count, loff_t *ppos)
+{
+	atomic_set(&pkt_stats.allocs, 0);
+	atomic_set(&pkt_stats.pool_hits, 0);
+	atomic_set(&pkt_stats.oversize, 0);
+	atomic_set(&pkt_stats.exhausted, 0);
+	atomic_set(&pkt_stats.in_use_max, atomic_read(&pkt_stats.in_use));
+	return count;
+}
+
+static const struct file_operations q6common_pkt_stats_ops = {
+	.read = q6common_pkt_stats_read,
+	.write = q6common_pkt_stats_write,
+};
+#endif
+
+int __init q6common_init(void)
+{
+	struct q6common_pkt_pool *pool = NULL;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(pkt_pools); i++) {
+		pool = &pkt_pools[i];
+		pool->base = kcalloc(pool->num_bufs, pool->buf_size,
+				     GFP_KERNEL);
+		if (!pool->base)
+			pr_err("%s: no pool for %u byte packets, using kzalloc\n",
+			       __func__, pool->buf_size);
+	}
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_pkt_stats = debugfs_create_file("msm_q6common_pkt_stats",
+						0644, NULL, NULL,
+						&q6common_pkt_stats_ops);
+#endif
+	return 0;
+}
+
+void q6common_exit(void)
+{
+	int i;
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(debugfs_pkt_stats);
+	debugfs_pkt_stats = NULL;
+#endif
+	for (i = 0; i < ARRAY_SIZE(pkt_pools); i++) {
+		kfree(pkt_pools[i].base);
+		pkt_pools[i].base = NULL;
+		pkt_pools[i].in_use = 0;
+	}
+}
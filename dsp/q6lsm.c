@@ -558,7 +558,7 @@ static int q6lsm_set_params_v2(struct lsm_client *client,
 	if (param_data != NULL)
 		pkt_size += param_size;
 
-	lsm_set_param = kzalloc(pkt_size, GFP_KERNEL);
+	lsm_set_param = q6common_pkt_alloc(pkt_size);
 	if (!lsm_set_param)
 		return -ENOMEM;
 
@@ -580,7 +580,7 @@ static int q6lsm_set_params_v2(struct lsm_client *client,
 	ret = q6lsm_apr_send_pkt(client, client->apr, lsm_set_param, true,
 				 NULL);
 done:
-	kfree(lsm_set_param);
+	q6common_pkt_free(lsm_set_param);
 	return ret;
 }
 
@@ -597,7 +597,7 @@ static int q6lsm_set_params_v3(struct lsm_client *client,
 	if (param_data != NULL)
 		pkt_size += param_size;
 
-	lsm_set_param = kzalloc(pkt_size, GFP_KERNEL);
+	lsm_set_param = q6common_pkt_alloc(pkt_size);
 	if (!lsm_set_param)
 		return -ENOMEM;
 
@@ -619,7 +619,7 @@ static int q6lsm_set_params_v3(struct lsm_client *client,
 	ret = q6lsm_apr_send_pkt(client, client->apr, lsm_set_param, true,
 				 NULL);
 done:
-	kfree(lsm_set_param);
+	q6common_pkt_free(lsm_set_param);
 	return ret;
 }
 
@@ -648,7 +648,7 @@ static int q6lsm_pack_and_set_params(struct lsm_client *client,
 	int ret = 0;
 
 	total_size = sizeof(union param_hdrs) + param_info->param_size;
-	packed_data = kzalloc(total_size, GFP_KERNEL);
+	packed_data = q6common_pkt_alloc(total_size);
 	if (!packed_data)
 		return -ENOMEM;
 
@@ -661,7 +661,7 @@ static int q6lsm_pack_and_set_params(struct lsm_client *client,
 			       set_param_opcode);
 
 done:
-	kfree(packed_data);
+	q6common_pkt_free(packed_data);
 	return ret;
 }
 
@@ -32,6 +32,9 @@ struct cal_block_data {
 	bool			cal_stale;
 	struct mem_map_data	map_data;
 	int32_t			buffer_number;
+	/* changes only with the content, unique across all blocks, never 0 */
+	uint32_t		cal_version;
+	uint32_t		cal_hash;
 };
 
 struct cal_util_callbacks {
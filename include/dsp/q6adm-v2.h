@@ -40,7 +40,7 @@ enum {
 };
 
 enum {
-	ADM_MEM_MAP_INDEX_SOURCE_TRACKING = ADM_MAX_CAL_TYPES,
+	ADM_MEM_MAP_INDEX_PARAM_POOL = ADM_MAX_CAL_TYPES,
 	ADM_MEM_MAP_INDEX_MAX
 };
 
@@ -66,6 +66,27 @@ struct route_payload {
 	unsigned int session_id;
 };
 
+/* One COPP to open through adm_open_batch(), same fields as adm_open() */
+struct adm_open_req {
+	int port_id;
+	int path;
+	int rate;
+	int channel_mode;
+	int topology;
+	int perf_mode;
+	uint16_t bit_width;
+	int app_type;
+	int acdb_id;
+	int session_type;
+	uint32_t passthr_mode;
+	/* copp_idx on success, error code on failure */
+	int copp_idx;
+	/* private to q6adm */
+	int port_idx;
+	int num_ec_ref_rx_chans;
+	bool pending;
+};
+
 struct default_chmixer_param_id_coeff {
 	uint32_t index;
 	uint16_t num_output_channels;
@@ -122,6 +143,10 @@ int adm_open(int port, int path, int rate, int mode, int topology,
 			   int app_type, int acdbdev_id, int session_type,
 			   uint32_t pass_thr);
 
+int adm_open_batch(struct adm_open_req *reqs, int num_reqs);
+
+u64 adm_get_cmd_count(void);
+
 int adm_map_rtac_block(struct rtac_cal_block_data *cal_block);
 
 int adm_unmap_rtac_block(uint32_t *mem_map_handle);
@@ -95,7 +95,15 @@
 #define SOFT_PAUSE_ENABLE	1
 #define SOFT_PAUSE_DISABLE	0
 
+/*
+ * Session ids travel in the high byte of the APR port and in a u8 of the
+ * command token, so a build can raise the limit up to 0xFE.
+ */
+#ifdef CONFIG_SND_SOC_QDSP6V2_ASM_MAX_SESSIONS
+#define ASM_ACTIVE_STREAMS_ALLOWED	CONFIG_SND_SOC_QDSP6V2_ASM_MAX_SESSIONS
+#else
 #define ASM_ACTIVE_STREAMS_ALLOWED	0xF
+#endif
 /* Control session is used for mapping calibration memory */
 #define ASM_CONTROL_SESSION	(ASM_ACTIVE_STREAMS_ALLOWED + 1)
 
@@ -165,6 +173,9 @@ struct audio_buffer {
 	uint32_t   size;/* size of buffer */
 	uint32_t   actual_size; /* actual number of bytes read by DSP */
 	struct      dma_buf *dma_buf;
+	/* length and timestamp of the last sync mode write */
+	uint32_t   write_len;
+	uint64_t   write_ts;
 };
 
 struct audio_aio_write_param {
@@ -248,6 +259,16 @@ struct audio_client {
 	/* shared io */
 	struct audio_buffer shared_pos_buf;
 	struct shared_io_config config;
+	/* acks outstanding for the current batch and its first error */
+	atomic_t               batch_pending;
+	atomic_t               batch_state;
+	uint32_t               batch_err_opcode;
+};
+
+/* PCM playback stream setup for q6asm_open_write_batch() */
+struct q6asm_write_setup {
+	uint16_t bits_per_sample;
+	bool send_cal;
 };
 
 struct q6asm_cal_info {
@@ -321,6 +342,9 @@ int q6asm_open_write_v4(struct audio_client *ac, uint32_t format,
 int q6asm_open_write_v5(struct audio_client *ac, uint32_t format,
 			uint16_t bits_per_sample);
 
+int q6asm_open_write_batch(struct audio_client *ac,
+			   struct q6asm_write_setup *setup);
+
 int q6asm_stream_open_write_v2(struct audio_client *ac, uint32_t format,
 			       uint16_t bits_per_sample, int32_t stream_id,
 			       bool is_gapless_mode);
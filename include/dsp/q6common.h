@@ -15,4 +15,9 @@ int q6common_pack_pp_params(u8 *dest, struct param_hdr_v3 *v3_hdr,
 int q6common_pack_pp_params_v2(u8 *dest, struct param_hdr_v3 *v3_hdr,
 			    u8 *param_data, u32 *total_size,
 			    bool iid_supported);
+int q6common_pack_pp_params_append(u8 *dest, u32 dest_size, u32 *offset,
+				   struct param_hdr_v3 *v3_hdr,
+				   u8 *param_data);
+void *q6common_pkt_alloc(u32 size);
+void q6common_pkt_free(void *pkt);
 #endif /* __Q6COMMON_H__ */
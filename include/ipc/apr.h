@@ -6,6 +6,8 @@
 #define __APR_H_
 
 #include <linux/mutex.h>
+#include <linux/llist.h>
+#include <linux/atomic.h>
 #include <soc/qcom/subsystem_notif.h>
 
 enum apr_subsys_state {
@@ -87,7 +89,12 @@ struct apr_hdr {
 #define APR_SVC_SRD		0x7
 
 /* APR Port IDs */
+/* ASM ports are indexed as (session << 3) + stream */
+#ifdef CONFIG_SND_SOC_QDSP6V2_ASM_MAX_SESSIONS
+#define APR_MAX_PORTS	((CONFIG_SND_SOC_QDSP6V2_ASM_MAX_SESSIONS + 1) * 8)
+#else
 #define APR_MAX_PORTS		0x80
+#endif
 
 #define APR_NAME_MAX		0x40
 
@@ -113,13 +120,44 @@ struct apr_client_data {
 
 typedef int32_t (*apr_fn)(struct apr_client_data *data, void *priv);
 
+/* Transmit ring counters, reported through debugfs */
+struct apr_tx_stats {
+	atomic_t pkts;
+	atomic_t batches;
+	atomic_t contended;
+	atomic_t depth;
+	atomic_t max_depth;
+};
+
+/*
+ * Receive dispatch counters, updated from the transport rx context and
+ * the deferred callback thread
+ */
+struct apr_rx_stats {
+	atomic64_t pkts;
+	atomic64_t bytes;
+	atomic64_t cb_time_ns;
+	atomic64_t cb_max_ns;
+	atomic64_t deferred;
+	atomic64_t overflow;
+};
+
+/* Callback modes for apr_set_cb_mode() */
+/* Run service callbacks from a dedicated RT thread */
+#define APR_CB_MODE_DEFERRED		0x1
+/* With APR_CB_MODE_DEFERRED, keep data buffer done events inline */
+#define APR_CB_MODE_INLINE_DATA		0x2
+
+struct apr_cb_queue;
+struct apr_lat;
+
 struct apr_svc {
 	uint16_t id;
 	uint16_t dest_id;
 	uint16_t client_id;
 	uint16_t dest_domain;
 	uint8_t rvd;
-	uint8_t port_cnt;
+	uint16_t port_cnt;
 	uint8_t svc_cnt;
 	uint8_t need_reset;
 	apr_fn port_fn[APR_MAX_PORTS];
@@ -129,6 +167,21 @@ struct apr_svc {
 	struct mutex m_lock;
 	spinlock_t w_lock;
 	uint8_t pkt_owner;
+	/*
+	 * When tx_ring is set, senders enqueue on tx_queue without taking
+	 * w_lock. Whichever sender wins tx_busy moves the queue to
+	 * tx_pending and sends from it one packet per tx_busy hold. Fixed
+	 * at first registration from apr_tx_ring_default.
+	 */
+	bool tx_ring;
+	struct llist_head tx_queue;
+	struct llist_node *tx_pending;
+	atomic_t tx_busy;
+	struct apr_tx_stats tx_stats;
+	struct apr_rx_stats rx_stats;
+	uint32_t cb_mode;
+	struct apr_cb_queue *cb_queue;
+	struct apr_lat *lat;
 #ifdef CONFIG_MSM_QDSP6_APRV2_VM
 	uint16_t vm_dest_svc;
 	uint32_t vm_handle;
@@ -167,6 +220,8 @@ inline int apr_fill_hdr(void *handle, uint32_t *buf, uint16_t src_port,
 			uint32_t token, uint32_t opcode, uint16_t len);
 
 int apr_send_pkt(void *handle, uint32_t *buf);
+int apr_send_pkt_batch(void *handle, uint32_t **bufs, int cnt);
+int apr_set_cb_mode(void *handle, uint32_t mode);
 int apr_deregister(void *handle);
 void subsys_notif_register(char *client_name, int domain,
 			   struct notifier_block *nb);
@@ -125,6 +125,20 @@ struct swr_reg {
 	u32 len;
 };
 
+/*
+ * struct swr_cmd - one register access in a soundwire command batch
+ * @dev_num: logical device number of the soundwire slave
+ * @read: read regaddr into val instead of writing val to it
+ * @reg_addr: 16 bit regaddr of soundwire slave
+ * @val: value to be written, or value read back
+ */
+struct swr_cmd {
+	u8 dev_num;
+	bool read;
+	u16 reg_addr;
+	u8 val;
+};
+
 /*
  * struct swr_master - Interface to the soundwire master controller
  * @dev: device interface to this driver
@@ -145,6 +159,9 @@ struct swr_reg {
  * @disconnect_port: callback for disable of soundwire port(s)
  * @read: callback for soundwire slave register read
  * @write: callback for soundwire slave register write
+ * @bulk_write: callback for soundwire slave register bulk write
+ * @batch: callback for a batch of register reads and writes, possibly
+ * to several slave devices, issued in order
  * @get_logical_dev_num: callback to get soundwire slave logical
  * device number
  * @port_en_mask: bit mask of active ports on soundwire master
@@ -170,6 +187,7 @@ struct swr_master {
 			const void *buf);
 	int (*bulk_write)(struct swr_master *master, u8 dev_num, void *reg,
 			  const void *buf, size_t len);
+	int (*batch)(struct swr_master *mstr, struct swr_cmd *cmds, size_t len);
 	int (*get_logical_dev_num)(struct swr_master *mstr, u64 dev_id,
 				u8 *dev_num);
 	int (*slvdev_datapath_control)(struct swr_master *mstr, bool enable);
@@ -305,6 +323,9 @@ extern int swr_write(struct swr_device *dev, u8 dev_num, u16 reg_addr,
 extern int swr_bulk_write(struct swr_device *dev, u8 dev_num, void *reg_addr,
 			  const void *buf, size_t len);
 
+extern int swr_batch(struct swr_device *dev, struct swr_cmd *cmds,
+		     size_t len);
+
 extern int swr_connect_port(struct swr_device *dev, u8 *port_id, u8 num_port,
 				u8 *ch_mask, u32 *ch_rate, u8 *num_ch,
 				u8 *port_type);
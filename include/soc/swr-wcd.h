@@ -24,6 +24,7 @@ enum {
 	SWR_REQ_CLK_SWITCH,
 	SWR_REGISTER_WAKEUP,
 	SWR_DEREGISTER_WAKEUP,
+	SWR_PORT_CFG_COMMIT,
 };
 
 struct swr_mstr_port {
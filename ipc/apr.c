@@ -22,6 +22,12 @@
 #include <linux/slab.h>
 #include <linux/ipc_logging.h>
 #include <linux/of_platform.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kthread.h>
+#include <linux/hash.h>
+#include <linux/mm.h>
+#include <uapi/linux/sched/types.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/scm.h>
 #include <soc/snd_event.h>
@@ -31,9 +37,20 @@
 #include <ipc/apr_tal.h>
 
 #define APR_PKT_IPC_LOG_PAGE_CNT 2
+/* Deferred callback queue depth, must be a power of 2 */
+#define APR_CB_QUEUE_DEPTH 32
+/* Larger packets are always dispatched inline */
+#define APR_CB_PAYLOAD_MAX 512
+#define APR_CB_THREAD_PRIO 1
 
 static struct apr_q6 q6;
 static struct apr_client client[APR_DEST_MAX][APR_CLIENT_MAX];
+/*
+ * Receive dispatch table indexed by source domain and destination
+ * service of an incoming packet. Entries are published by
+ * apr_register() and cleared by apr_deregister().
+ */
+static struct apr_svc *apr_rx_svc[APR_DOMAIN_MAX][APR_SVC_MAX];
 static void *apr_pkt_ctx;
 static wait_queue_head_t modem_wait;
 static bool is_modem_up;
@@ -62,6 +79,148 @@ struct apr_private {
 static struct apr_private *apr_priv;
 static bool apr_cf_debug;
 
+/* Services registered while this is set use the lock-free transmit ring */
+static bool apr_tx_ring_default;
+module_param(apr_tx_ring_default, bool, 0664);
+MODULE_PARM_DESC(apr_tx_ring_default, "Use transmit ring for new services");
+
+/* Command round trip latency, matched from response to command by token */
+static bool apr_lat_enable = true;
+module_param(apr_lat_enable, bool, 0664);
+MODULE_PARM_DESC(apr_lat_enable, "Track command round trip latency");
+
+#define APR_LAT_PEND_BITS 6
+#define APR_LAT_OPCODES_MAX 48
+/* Bucket n counts latencies in [2^(n-1), 2^n) us, the last is open ended */
+#define APR_LAT_BUCKETS 20
+
+struct apr_lat_hist {
+	uint32_t opcode;
+	uint32_t count;
+	u64 total_ns;
+	u64 max_ns;
+	uint32_t bucket[APR_LAT_BUCKETS];
+};
+
+struct apr_lat_pend {
+	uint32_t opcode;
+	uint32_t token;
+	uint16_t port;
+	bool valid;
+	u64 start_ns;
+};
+
+struct apr_lat {
+	spinlock_t lock;
+	struct apr_lat_pend pend[1 << APR_LAT_PEND_BITS];
+	struct apr_lat_hist svc;
+	struct apr_lat_hist op[APR_LAT_OPCODES_MAX];
+	int op_cnt;
+};
+
+static struct apr_lat_pend *apr_lat_slot(struct apr_lat *lat, uint16_t port,
+					 uint32_t token)
+{
+	return &lat->pend[hash_32(((uint32_t)port << 16) ^ token,
+				  APR_LAT_PEND_BITS)];
+}
+
+static void apr_lat_hist_add(struct apr_lat_hist *hist, u64 delta)
+{
+	u64 us = div_u64(delta, NSEC_PER_USEC);
+
+	hist->count++;
+	hist->total_ns += delta;
+	if (delta > hist->max_ns)
+		hist->max_ns = delta;
+	hist->bucket[min_t(int, fls64(us), APR_LAT_BUCKETS - 1)]++;
+}
+
+static struct apr_lat_hist *apr_lat_op(struct apr_lat *lat, uint32_t opcode)
+{
+	int i;
+
+	for (i = 0; i < lat->op_cnt; i++)
+		if (lat->op[i].opcode == opcode)
+			return &lat->op[i];
+
+	if (lat->op_cnt == APR_LAT_OPCODES_MAX)
+		return NULL;
+
+	lat->op[lat->op_cnt].opcode = opcode;
+	return &lat->op[lat->op_cnt++];
+}
+
+static void apr_lat_tx(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	struct apr_lat *lat = svc->lat;
+	struct apr_lat_pend *pend;
+	unsigned long flags;
+
+	if (!lat || !READ_ONCE(apr_lat_enable))
+		return;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	/* An unanswered command in the same slot is simply replaced */
+	pend = apr_lat_slot(lat, hdr->src_port, hdr->token);
+	pend->opcode = hdr->opcode;
+	pend->token = hdr->token;
+	pend->port = hdr->src_port;
+	pend->valid = true;
+	pend->start_ns = ktime_get_ns();
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+/* Forget a command that never made it to the transport */
+static void apr_lat_tx_cancel(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	struct apr_lat *lat = svc->lat;
+	struct apr_lat_pend *pend;
+	unsigned long flags;
+
+	if (!lat)
+		return;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	pend = apr_lat_slot(lat, hdr->src_port, hdr->token);
+	if (pend->valid && pend->port == hdr->src_port &&
+	    pend->token == hdr->token && pend->opcode == hdr->opcode)
+		pend->valid = false;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+static void apr_lat_rx(struct apr_svc *svc, struct apr_client_data *data)
+{
+	struct apr_lat *lat = svc->lat;
+	struct apr_lat_pend *pend;
+	struct apr_lat_hist *hist;
+	unsigned long flags;
+	u64 delta;
+
+	if (!lat || !READ_ONCE(apr_lat_enable))
+		return;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	pend = apr_lat_slot(lat, data->dest_port, data->token);
+	if (!pend->valid || pend->port != data->dest_port ||
+	    pend->token != data->token)
+		goto unlock;
+	/* A basic response names the command it acknowledges */
+	if (data->opcode == APR_BASIC_RSP_RESULT &&
+	    (data->payload_size < sizeof(uint32_t) ||
+	     ((uint32_t *)data->payload)[0] != pend->opcode))
+		goto unlock;
+
+	pend->valid = false;
+	delta = ktime_get_ns() - pend->start_ns;
+	apr_lat_hist_add(&lat->svc, delta);
+	hist = apr_lat_op(lat, pend->opcode);
+	if (hist)
+		apr_lat_hist_add(hist, delta);
+unlock:
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static struct dentry *debugfs_apr_debug;
 static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
@@ -80,6 +239,251 @@ static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
 static const struct file_operations apr_debug_ops = {
 	.write = apr_debug_write,
 };
+
+#define APR_STATS_BUF_SIZE 4096
+static struct dentry *debugfs_apr_tx_stats;
+static ssize_t apr_tx_stats_read(struct file *filp, char __user *ubuf,
+				 size_t cnt, loff_t *ppos)
+{
+	struct apr_svc *svc;
+	char *buf;
+	int i, j, k, len = 0;
+	ssize_t ret;
+
+	buf = kzalloc(APR_STATS_BUF_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	len += scnprintf(buf + len, APR_STATS_BUF_SIZE - len,
+			 "dest clnt svc ring pkts batches contended depth max_depth\n");
+	for (i = 0; i < APR_DEST_MAX; i++) {
+		for (j = 0; j < APR_CLIENT_MAX; j++) {
+			for (k = 0; k < APR_SVC_MAX; k++) {
+				svc = &client[i][j].svc[k];
+				if (!svc->id)
+					continue;
+				len += scnprintf(buf + len,
+					APR_STATS_BUF_SIZE - len,
+					"%d %d 0x%x %d %d %d %d %d %d\n",
+					i, j, svc->id, svc->tx_ring,
+					atomic_read(&svc->tx_stats.pkts),
+					atomic_read(&svc->tx_stats.batches),
+					atomic_read(&svc->tx_stats.contended),
+					atomic_read(&svc->tx_stats.depth),
+					atomic_read(&svc->tx_stats.max_depth));
+			}
+		}
+	}
+
+	ret = simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t apr_tx_stats_write(struct file *filp, const char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	struct apr_tx_stats *stats;
+	int i, j, k;
+
+	/* Any write clears the counters, queue depth is left alone */
+	for (i = 0; i < APR_DEST_MAX; i++) {
+		for (j = 0; j < APR_CLIENT_MAX; j++) {
+			for (k = 0; k < APR_SVC_MAX; k++) {
+				stats = &client[i][j].svc[k].tx_stats;
+				atomic_set(&stats->pkts, 0);
+				atomic_set(&stats->batches, 0);
+				atomic_set(&stats->contended, 0);
+				atomic_set(&stats->max_depth, 0);
+			}
+		}
+	}
+
+	return cnt;
+}
+
+static const struct file_operations apr_tx_stats_ops = {
+	.read = apr_tx_stats_read,
+	.write = apr_tx_stats_write,
+};
+
+static struct dentry *debugfs_apr_rx_stats;
+static ssize_t apr_rx_stats_read(struct file *filp, char __user *ubuf,
+				 size_t cnt, loff_t *ppos)
+{
+	struct apr_rx_stats *stats;
+	struct apr_svc *svc;
+	u64 pkts, cb_time_ns;
+	char *buf;
+	int i, j, len = 0;
+	ssize_t ret;
+
+	buf = kzalloc(APR_STATS_BUF_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	len += scnprintf(buf + len, APR_STATS_BUF_SIZE - len,
+			 "domain svc pkts bytes cb_total_us cb_avg_us cb_max_us deferred overflow\n");
+	for (i = 0; i < APR_DOMAIN_MAX; i++) {
+		for (j = 0; j < APR_SVC_MAX; j++) {
+			svc = READ_ONCE(apr_rx_svc[i][j]);
+			if (!svc)
+				continue;
+			stats = &svc->rx_stats;
+			pkts = atomic64_read(&stats->pkts);
+			cb_time_ns = atomic64_read(&stats->cb_time_ns);
+			len += scnprintf(buf + len,
+				APR_STATS_BUF_SIZE - len,
+				"%d 0x%x %llu %llu %llu %llu %llu %llu %llu\n",
+				i, j, pkts, atomic64_read(&stats->bytes),
+				div_u64(cb_time_ns, NSEC_PER_USEC),
+				pkts ? div64_u64(cb_time_ns,
+					pkts * NSEC_PER_USEC) : 0,
+				div_u64(atomic64_read(&stats->cb_max_ns),
+					NSEC_PER_USEC),
+				atomic64_read(&stats->deferred),
+				atomic64_read(&stats->overflow));
+		}
+	}
+
+	ret = simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t apr_rx_stats_write(struct file *filp, const char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	struct apr_rx_stats *stats;
+	struct apr_svc *svc;
+	int i, j;
+
+	for (i = 0; i < APR_DOMAIN_MAX; i++) {
+		for (j = 0; j < APR_SVC_MAX; j++) {
+			svc = READ_ONCE(apr_rx_svc[i][j]);
+			if (!svc)
+				continue;
+			stats = &svc->rx_stats;
+			atomic64_set(&stats->pkts, 0);
+			atomic64_set(&stats->bytes, 0);
+			atomic64_set(&stats->cb_time_ns, 0);
+			atomic64_set(&stats->cb_max_ns, 0);
+			atomic64_set(&stats->deferred, 0);
+			atomic64_set(&stats->overflow, 0);
+		}
+	}
+
+	return cnt;
+}
+
+static const struct file_operations apr_rx_stats_ops = {
+	.read = apr_rx_stats_read,
+	.write = apr_rx_stats_write,
+};
+
+#define APR_LAT_BUF_SIZE (128 * 1024)
+static struct dentry *debugfs_apr_latency;
+static int apr_lat_hist_print(char *buf, int len, int domain, int svc_id,
+			      const char *name, struct apr_lat_hist *hist)
+{
+	int i;
+
+	len += scnprintf(buf + len, APR_LAT_BUF_SIZE - len,
+			 "%d 0x%x %s %u %llu %llu", domain, svc_id, name,
+			 hist->count,
+			 hist->count ? div64_u64(hist->total_ns,
+				(u64)hist->count * NSEC_PER_USEC) : 0,
+			 div_u64(hist->max_ns, NSEC_PER_USEC));
+	for (i = 0; i < APR_LAT_BUCKETS; i++)
+		len += scnprintf(buf + len, APR_LAT_BUF_SIZE - len, " %u",
+				 hist->bucket[i]);
+	len += scnprintf(buf + len, APR_LAT_BUF_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t apr_latency_read(struct file *filp, char __user *ubuf,
+				size_t cnt, loff_t *ppos)
+{
+	struct apr_lat_hist *hist;
+	struct apr_lat *lat;
+	struct apr_svc *svc;
+	char name[16];
+	char *buf;
+	int i, j, k, n, len = 0;
+	ssize_t ret;
+
+	hist = kmalloc_array(APR_LAT_OPCODES_MAX + 1, sizeof(*hist),
+			     GFP_KERNEL);
+	buf = kvzalloc(APR_LAT_BUF_SIZE, GFP_KERNEL);
+	if (!hist || !buf) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	len += scnprintf(buf + len, APR_LAT_BUF_SIZE - len,
+			 "domain svc opcode count avg_us max_us buckets[<1us <2us <4us ... >=%dus]\n",
+			 1 << (APR_LAT_BUCKETS - 2));
+	for (i = 0; i < APR_DOMAIN_MAX; i++) {
+		for (j = 0; j < APR_SVC_MAX; j++) {
+			svc = READ_ONCE(apr_rx_svc[i][j]);
+			if (!svc || !svc->lat)
+				continue;
+			/* Snapshot so the rx path is not held up by printing */
+			lat = svc->lat;
+			spin_lock_irq(&lat->lock);
+			hist[0] = lat->svc;
+			memcpy(&hist[1], lat->op, lat->op_cnt * sizeof(*hist));
+			n = lat->op_cnt;
+			spin_unlock_irq(&lat->lock);
+
+			len = apr_lat_hist_print(buf, len, i, j, "all",
+						 &hist[0]);
+			for (k = 1; k <= n; k++) {
+				snprintf(name, sizeof(name), "0x%x",
+					 hist[k].opcode);
+				len = apr_lat_hist_print(buf, len, i, j, name,
+							 &hist[k]);
+			}
+		}
+	}
+
+	ret = simple_read_from_buffer(ubuf, cnt, ppos, buf, len);
+done:
+	kvfree(buf);
+	kfree(hist);
+	return ret;
+}
+
+static ssize_t apr_latency_write(struct file *filp, const char __user *ubuf,
+				 size_t cnt, loff_t *ppos)
+{
+	struct apr_lat *lat;
+	struct apr_svc *svc;
+	int i, j;
+
+	/* Any write clears the histograms, pending commands are kept */
+	for (i = 0; i < APR_DOMAIN_MAX; i++) {
+		for (j = 0; j < APR_SVC_MAX; j++) {
+			svc = READ_ONCE(apr_rx_svc[i][j]);
+			if (!svc || !svc->lat)
+				continue;
+			lat = svc->lat;
+			spin_lock_irq(&lat->lock);
+			memset(&lat->svc, 0, sizeof(lat->svc));
+			memset(lat->op, 0, sizeof(lat->op));
+			lat->op_cnt = 0;
+			spin_unlock_irq(&lat->lock);
+		}
+	}
+
+	return cnt;
+}
+
+static const struct file_operations apr_latency_ops = {
+	.read = apr_latency_read,
+	.write = apr_latency_write,
+};
 #endif
 
 #define APR_PKT_INFO(x...) \
@@ -343,6 +747,205 @@ struct apr_client *apr_get_client(int dest_id, int client_id)
 	return &client[dest_id][client_id];
 }
 
+static void apr_stamp_hdr(struct apr_svc *svc, uint32_t *buf)
+{
+	struct apr_hdr *hdr = (struct apr_hdr *)buf;
+
+	hdr->src_domain = APR_DOMAIN_APPS;
+	hdr->src_svc = svc->id;
+	hdr->dest_domain = svc->dest_domain;
+	hdr->dest_svc = svc->id;
+
+	if (unlikely(apr_cf_debug)) {
+		APR_PKT_INFO(
+		"Tx: src_addr[0x%X] dest_addr[0x%X] opcode[0x%X] token[0x%X]",
+		(hdr->src_domain << 8) | hdr->src_svc,
+		(hdr->dest_domain << 8) | hdr->dest_svc, hdr->opcode,
+		hdr->token);
+	}
+}
+
+static int __apr_send_pkt(struct apr_svc *svc, struct apr_client *clnt,
+			  uint32_t *buf)
+{
+	struct apr_hdr *hdr = (struct apr_hdr *)buf;
+	uint16_t w_len;
+	int rc;
+
+	/* Stamp before the write, the response may arrive before it returns */
+	apr_lat_tx(svc, hdr);
+	rc = apr_tal_write(clnt->handle, buf,
+			(struct apr_pkt_priv *)&svc->pkt_owner,
+			hdr->pkt_size);
+	if (rc >= 0) {
+		w_len = rc;
+		if (w_len != hdr->pkt_size) {
+			pr_err("%s: Unable to write whole APR pkt successfully: %d\n",
+			       __func__, rc);
+			rc = -EINVAL;
+		}
+	} else {
+		apr_lat_tx_cancel(svc, hdr);
+		pr_err_ratelimited("%s: Write APR pkt failed with error %d\n",
+			__func__, rc);
+		if (rc == -ECONNRESET) {
+			pr_err_ratelimited("%s: Received reset error from tal\n",
+					__func__);
+			rc = -ENETRESET;
+		}
+	}
+
+	return rc;
+}
+
+struct apr_tx_req {
+	struct llist_node node;
+	uint32_t *buf;
+	int rc;
+	int done;
+	/* set by the first failed packet of a batch, the rest are dropped */
+	int *abort;
+};
+
+/*
+ * Sends the oldest queued request. Called with IRQs off and tx_busy
+ * owned, so each hold is bounded by a single transport write; tx_busy
+ * is released between sends so that a sender interrupting this CPU can
+ * drain on its own.
+ */
+static void apr_tx_send_one(struct apr_svc *svc, struct apr_client *clnt)
+{
+	struct llist_node *node = svc->tx_pending;
+	struct apr_tx_req *req;
+
+	if (!node) {
+		node = llist_del_all(&svc->tx_queue);
+		if (!node)
+			return;
+		node = llist_reverse_order(node);
+		atomic_inc(&svc->tx_stats.batches);
+	}
+	req = llist_entry(node, struct apr_tx_req, node);
+	svc->tx_pending = node->next;
+
+	if (req->abort && READ_ONCE(*req->abort)) {
+		req->rc = -ECANCELED;
+	} else {
+		req->rc = __apr_send_pkt(svc, clnt, req->buf);
+		if (req->rc < 0 && req->abort)
+			WRITE_ONCE(*req->abort, 1);
+	}
+	atomic_dec(&svc->tx_stats.depth);
+	/* req lives on the sender's stack, do not touch it after */
+	smp_store_release(&req->done, 1);
+}
+
+/* Sends queued requests, oldest first, until @req has been sent */
+static void apr_tx_wait(struct apr_svc *svc, struct apr_client *clnt,
+			struct apr_tx_req *req)
+{
+	unsigned long flags;
+	bool contended = false;
+
+	while (!smp_load_acquire(&req->done)) {
+		local_irq_save(flags);
+		if (atomic_cmpxchg(&svc->tx_busy, 0, 1) == 0) {
+			apr_tx_send_one(svc, clnt);
+			atomic_set_release(&svc->tx_busy, 0);
+			local_irq_restore(flags);
+			continue;
+		}
+		local_irq_restore(flags);
+		if (!contended) {
+			atomic_inc(&svc->tx_stats.contended);
+			contended = true;
+		}
+		cpu_relax();
+	}
+}
+
+static void apr_tx_queued(struct apr_svc *svc, int cnt)
+{
+	int depth, max;
+
+	depth = atomic_add_return(cnt, &svc->tx_stats.depth);
+	max = atomic_read(&svc->tx_stats.max_depth);
+	while (depth > max) {
+		int old = atomic_cmpxchg(&svc->tx_stats.max_depth, max, depth);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+	atomic_add(cnt, &svc->tx_stats.pkts);
+}
+
+static int apr_send_pkt_ring(struct apr_svc *svc, struct apr_client *clnt,
+			     uint32_t *buf)
+{
+	struct apr_tx_req req = { .buf = buf, .rc = 0, .done = 0 };
+
+	apr_stamp_hdr(svc, buf);
+	apr_tx_queued(svc, 1);
+	llist_add(&req.node, &svc->tx_queue);
+	apr_tx_wait(svc, clnt, &req);
+
+	return req.rc;
+}
+
+/*
+ * Queues the batch as one chain so no other sender's packet can land in
+ * between, then waits for its last packet.
+ */
+static int apr_send_pkt_batch_ring(struct apr_svc *svc,
+				   struct apr_client *clnt,
+				   uint32_t **bufs, int cnt)
+{
+	struct apr_tx_req *reqs;
+	int i, rc, abort = 0;
+
+	reqs = kcalloc(cnt, sizeof(*reqs), GFP_ATOMIC);
+	if (!reqs)
+		return -ENOMEM;
+
+	/* llist is LIFO, link newest first so the drainer sees bufs[0] first */
+	for (i = 0; i < cnt; i++) {
+		apr_stamp_hdr(svc, bufs[i]);
+		reqs[i].buf = bufs[i];
+		reqs[i].abort = &abort;
+		reqs[i].node.next = i ? &reqs[i - 1].node : NULL;
+	}
+	apr_tx_queued(svc, cnt);
+	llist_add_batch(&reqs[cnt - 1].node, &reqs[0].node, &svc->tx_queue);
+	apr_tx_wait(svc, clnt, &reqs[cnt - 1]);
+
+	for (i = 0; i < cnt && reqs[i].rc >= 0; i++)
+		;
+	rc = i ? i : reqs[0].rc;
+	kfree(reqs);
+	return rc;
+}
+
+static int apr_send_pkt_check(struct apr_svc *svc)
+{
+	if (svc->need_reset) {
+		pr_err_ratelimited("apr: send_pkt service need reset\n");
+		return -ENETRESET;
+	}
+
+	if ((svc->dest_id == APR_DEST_QDSP6) &&
+	    (apr_get_q6_state() != APR_SUBSYS_LOADED)) {
+		pr_err_ratelimited("%s: Still dsp is not Up\n", __func__);
+		return -ENETRESET;
+	} else if ((svc->dest_id == APR_DEST_MODEM) &&
+		   (apr_get_modem_state() == APR_SUBSYS_DOWN)) {
+		pr_err("apr: Still Modem is not Up\n");
+		return -ENETRESET;
+	}
+
+	return 0;
+}
+
 /**
  * apr_send_pkt - Clients call to send packet
  * to destination processor.
@@ -356,10 +959,8 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 {
 	struct apr_svc *svc = handle;
 	struct apr_client *clnt;
-	struct apr_hdr *hdr;
 	uint16_t dest_id;
 	uint16_t client_id;
-	uint16_t w_len;
 	int rc;
 	unsigned long flags;
 
@@ -368,70 +969,105 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 				!handle ? "handle" : "buf");
 		return -EINVAL;
 	}
-	if (svc->need_reset) {
-		pr_err_ratelimited("apr: send_pkt service need reset\n");
-		return -ENETRESET;
-	}
-
-	if ((svc->dest_id == APR_DEST_QDSP6) &&
-	    (apr_get_q6_state() != APR_SUBSYS_LOADED)) {
-		pr_err_ratelimited("%s: Still dsp is not Up\n", __func__);
-		return -ENETRESET;
-	} else if ((svc->dest_id == APR_DEST_MODEM) &&
-		   (apr_get_modem_state() == APR_SUBSYS_DOWN)) {
-		pr_err("apr: Still Modem is not Up\n");
-		return -ENETRESET;
-	}
+	rc = apr_send_pkt_check(svc);
+	if (rc)
+		return rc;
 
-	spin_lock_irqsave(&svc->w_lock, flags);
 	dest_id = svc->dest_id;
 	client_id = svc->client_id;
 	clnt = &client[dest_id][client_id];
 
-	if (!client[dest_id][client_id].handle) {
+	if (READ_ONCE(svc->tx_ring)) {
+		if (!clnt->handle) {
+			pr_err_ratelimited("APR: Still service is not yet opened\n");
+			return -EINVAL;
+		}
+		return apr_send_pkt_ring(svc, clnt, buf);
+	}
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	if (!clnt->handle) {
 		pr_err_ratelimited("APR: Still service is not yet opened\n");
 		spin_unlock_irqrestore(&svc->w_lock, flags);
 		return -EINVAL;
 	}
-	hdr = (struct apr_hdr *)buf;
 
-	hdr->src_domain = APR_DOMAIN_APPS;
-	hdr->src_svc = svc->id;
-	hdr->dest_domain = svc->dest_domain;
-	hdr->dest_svc = svc->id;
+	apr_stamp_hdr(svc, buf);
+	rc = __apr_send_pkt(svc, clnt, buf);
+	spin_unlock_irqrestore(&svc->w_lock, flags);
 
-	if (unlikely(apr_cf_debug)) {
-		APR_PKT_INFO(
-		"Tx: src_addr[0x%X] dest_addr[0x%X] opcode[0x%X] token[0x%X]",
-		(hdr->src_domain << 8) | hdr->src_svc,
-		(hdr->dest_domain << 8) | hdr->dest_svc, hdr->opcode,
-		hdr->token);
+	return rc;
+}
+EXPORT_SYMBOL(apr_send_pkt);
+
+static int __apr_send_pkt_batch(struct apr_svc *svc, struct apr_client *clnt,
+				uint32_t **bufs, int cnt)
+{
+	int i, rc = 0;
+
+	for (i = 0; i < cnt; i++) {
+		apr_stamp_hdr(svc, bufs[i]);
+		rc = __apr_send_pkt(svc, clnt, bufs[i]);
+		if (rc < 0)
+			break;
 	}
 
-	rc = apr_tal_write(clnt->handle, buf,
-			(struct apr_pkt_priv *)&svc->pkt_owner,
-			hdr->pkt_size);
-	if (rc >= 0) {
-		w_len = rc;
-		if (w_len != hdr->pkt_size) {
-			pr_err("%s: Unable to write whole APR pkt successfully: %d\n",
-			       __func__, rc);
-			rc = -EINVAL;
-		}
-	} else {
-		pr_err_ratelimited("%s: Write APR pkt failed with error %d\n",
-			__func__, rc);
-		if (rc == -ECONNRESET) {
-			pr_err_ratelimited("%s: Received reset error from tal\n",
-					__func__);
-			rc = -ENETRESET;
+	return i ? i : rc;
+}
+
+/**
+ * apr_send_pkt_batch - Clients call to send several packets
+ * to destination processor in one transport transaction.
+ *
+ * @handle: APR service handle
+ * @bufs: packets to send, in order
+ * @cnt: number of packets in @bufs
+ *
+ * The transmit path of the service is held for the whole batch, so no
+ * other sender can interleave packets with it. Sending stops at the
+ * first packet the transport rejects. Responses are delivered to the
+ * service callback as usual and are matched by the client on token.
+ *
+ * Returns number of packets sent on success or error if none was sent.
+ */
+int apr_send_pkt_batch(void *handle, uint32_t **bufs, int cnt)
+{
+	struct apr_svc *svc = handle;
+	struct apr_client *clnt;
+	unsigned long flags;
+	int rc;
+
+	if (!handle || !bufs || cnt <= 0) {
+		pr_err("APR: Wrong parameters for %s\n",
+				!handle ? "handle" : "bufs");
+		return -EINVAL;
+	}
+	rc = apr_send_pkt_check(svc);
+	if (rc)
+		return rc;
+
+	clnt = &client[svc->dest_id][svc->client_id];
+
+	if (READ_ONCE(svc->tx_ring)) {
+		if (!clnt->handle) {
+			pr_err_ratelimited("APR: Still service is not yet opened\n");
+			return -EINVAL;
 		}
+		return apr_send_pkt_batch_ring(svc, clnt, bufs, cnt);
+	}
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	if (!clnt->handle) {
+		pr_err_ratelimited("APR: Still service is not yet opened\n");
+		spin_unlock_irqrestore(&svc->w_lock, flags);
+		return -EINVAL;
 	}
+	rc = __apr_send_pkt_batch(svc, clnt, bufs, cnt);
 	spin_unlock_irqrestore(&svc->w_lock, flags);
 
 	return rc;
 }
-EXPORT_SYMBOL(apr_send_pkt);
+EXPORT_SYMBOL(apr_send_pkt_batch);
 
 int apr_pkt_config(void *handle, struct apr_pkt_cfg *cfg)
 {
@@ -535,6 +1171,15 @@ struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
 		goto done;
 	}
 
+	if (src_port != 0xFFFFFFFF) {
+		temp_port = ((src_port >> 8) * 8) + (src_port & 0xFF);
+		pr_debug("port = %d t_port = %d\n", src_port, temp_port);
+		if (temp_port >= APR_MAX_PORTS || temp_port < 0) {
+			pr_err("APR: temp_port out of bounds\n");
+			return NULL;
+		}
+	}
+
 	clnt = &client[dest_id][client_id];
 	mutex_lock(&clnt->m_lock);
 	if (!clnt->handle && can_open_channel) {
@@ -562,15 +1207,16 @@ struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
 	svc->client_id = client_id;
 	svc->dest_domain = domain_id;
 	svc->pkt_owner = APR_PKT_OWNER_DRIVER;
+	if (!svc->svc_cnt)
+		WRITE_ONCE(svc->tx_ring, apr_tx_ring_default);
+	/* Kept across re-registration so histograms survive SSR */
+	if (!svc->lat) {
+		svc->lat = kzalloc(sizeof(*svc->lat), GFP_KERNEL);
+		if (svc->lat)
+			spin_lock_init(&svc->lat->lock);
+	}
 
 	if (src_port != 0xFFFFFFFF) {
-		temp_port = ((src_port >> 8) * 8) + (src_port & 0xFF);
-		pr_debug("port = %d t_port = %d\n", src_port, temp_port);
-		if (temp_port >= APR_MAX_PORTS || temp_port < 0) {
-			pr_err("APR: temp_port out of bounds\n");
-			mutex_unlock(&svc->m_lock);
-			return NULL;
-		}
 		if (!svc->svc_cnt)
 			clnt->svc_cnt++;
 		svc->port_cnt++;
@@ -586,6 +1232,8 @@ struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
 			svc->svc_cnt++;
 		}
 	}
+	/* visible to the rx path only once it is fully set up */
+	smp_store_release(&apr_rx_svc[domain_id][svc_id], svc);
 
 	mutex_unlock(&svc->m_lock);
 done:
@@ -594,10 +1242,273 @@ done:
 EXPORT_SYMBOL(apr_register);
 
 
+struct apr_cb_entry {
+	struct apr_client_data data;
+	apr_fn fn;
+	void *priv;
+	uint32_t payload[APR_CB_PAYLOAD_MAX / sizeof(uint32_t)];
+};
+
+/* Packet that did not fit the ring, queued behind it in arrival order */
+struct apr_cb_ovf {
+	struct list_head list;
+	struct apr_client_data data;
+	apr_fn fn;
+	void *priv;
+	uint32_t payload[];
+};
+
+/*
+ * Single producer, single consumer ring. The producer is the transport
+ * rx context, which is serialized per channel, the consumer is the
+ * service callback thread. Once a packet goes to the overflow list, the
+ * ones after it follow until the thread has emptied it, so callbacks
+ * run in arrival order.
+ */
+struct apr_cb_queue {
+	struct apr_svc *svc;
+	struct apr_cb_entry ring[APR_CB_QUEUE_DEPTH];
+	unsigned int head;
+	unsigned int tail;
+	spinlock_t ovf_lock;
+	struct list_head ovf;
+	wait_queue_head_t wait;
+	struct task_struct *thread;
+};
+
+static void apr_rx_stats_update(struct apr_svc *svc, u64 cb_time,
+				uint16_t pkt_size)
+{
+	struct apr_rx_stats *stats = &svc->rx_stats;
+	u64 max = atomic64_read(&stats->cb_max_ns);
+	u64 old;
+
+	atomic64_inc(&stats->pkts);
+	atomic64_add(pkt_size, &stats->bytes);
+	atomic64_add(cb_time, &stats->cb_time_ns);
+	while (cb_time > max) {
+		old = atomic64_cmpxchg(&stats->cb_max_ns, max, cb_time);
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+/* An entry stays on the list while its callback runs, see apr_cb_defer */
+static void apr_cb_run_ovf(struct apr_cb_queue *q)
+{
+	struct apr_cb_ovf *o;
+	unsigned long flags;
+	u64 cb_start;
+
+	spin_lock_irqsave(&q->ovf_lock, flags);
+	while (!list_empty(&q->ovf)) {
+		o = list_first_entry(&q->ovf, struct apr_cb_ovf, list);
+		spin_unlock_irqrestore(&q->ovf_lock, flags);
+
+		cb_start = ktime_get_ns();
+		o->fn(&o->data, o->priv);
+		apr_rx_stats_update(q->svc, ktime_get_ns() - cb_start,
+				    o->data.payload_size + APR_HDR_SIZE);
+
+		spin_lock_irqsave(&q->ovf_lock, flags);
+		list_del(&o->list);
+		kfree(o);
+	}
+	spin_unlock_irqrestore(&q->ovf_lock, flags);
+}
+
+static int apr_cb_thread(void *data)
+{
+	struct apr_cb_queue *q = data;
+	struct apr_cb_entry *e;
+	unsigned int tail;
+	bool stop;
+	u64 cb_start;
+
+	for (;;) {
+		wait_event_interruptible(q->wait,
+			q->tail != smp_load_acquire(&q->head) ||
+			!list_empty_careful(&q->ovf) ||
+			kthread_should_stop());
+
+		/*
+		 * The producer is gone before the stop is requested, so one
+		 * more pass runs every callback still queued.
+		 */
+		stop = kthread_should_stop();
+		smp_rmb();
+		tail = q->tail;
+		while (tail != smp_load_acquire(&q->head)) {
+			e = &q->ring[tail & (APR_CB_QUEUE_DEPTH - 1)];
+			cb_start = ktime_get_ns();
+			e->fn(&e->data, e->priv);
+			apr_rx_stats_update(q->svc, ktime_get_ns() - cb_start,
+					    e->data.payload_size + APR_HDR_SIZE);
+			smp_store_release(&q->tail, ++tail);
+		}
+		/* overflow entries are newer than anything left in the ring */
+		apr_cb_run_ovf(q);
+		if (stop)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Queue a callback to the service thread. Returns false when the packet
+ * has to be dispatched inline instead.
+ */
+static bool apr_cb_defer(struct apr_svc *svc, struct apr_client_data *data,
+			 apr_fn fn, void *priv)
+{
+	struct apr_cb_queue *q = READ_ONCE(svc->cb_queue);
+	struct apr_cb_entry *e;
+	struct apr_cb_ovf *o;
+	unsigned int head, tail;
+	unsigned long flags;
+
+	if (!q || !(READ_ONCE(svc->cb_mode) & APR_CB_MODE_DEFERRED))
+		return false;
+
+	if ((READ_ONCE(svc->cb_mode) & APR_CB_MODE_INLINE_DATA) &&
+	    (data->opcode == ASM_DATA_EVENT_WRITE_DONE_V2 ||
+	     data->opcode == ASM_DATA_EVENT_READ_DONE_V2))
+		return false;
+
+	head = q->head;
+	tail = smp_load_acquire(&q->tail);
+	spin_lock_irqsave(&q->ovf_lock, flags);
+	if (!list_empty(&q->ovf) ||
+	    data->payload_size > APR_CB_PAYLOAD_MAX ||
+	    head - tail >= APR_CB_QUEUE_DEPTH) {
+		/* inline only when it cannot overtake a queued callback */
+		if (head == tail && list_empty(&q->ovf)) {
+			spin_unlock_irqrestore(&q->ovf_lock, flags);
+			return false;
+		}
+		o = kmalloc(sizeof(*o) + data->payload_size, GFP_ATOMIC);
+		if (!o) {
+			spin_unlock_irqrestore(&q->ovf_lock, flags);
+			pr_err_ratelimited("%s: svc 0x%x callback run out of order\n",
+					   __func__, svc->id);
+			return false;
+		}
+		o->data = *data;
+		if (data->payload_size) {
+			memcpy(o->payload, data->payload, data->payload_size);
+			o->data.payload = o->payload;
+		}
+		o->fn = fn;
+		o->priv = priv;
+		list_add_tail(&o->list, &q->ovf);
+		spin_unlock_irqrestore(&q->ovf_lock, flags);
+		atomic64_inc(&svc->rx_stats.overflow);
+		wake_up(&q->wait);
+		return true;
+	}
+	spin_unlock_irqrestore(&q->ovf_lock, flags);
+
+	e = &q->ring[head & (APR_CB_QUEUE_DEPTH - 1)];
+	e->data = *data;
+	if (data->payload_size) {
+		memcpy(e->payload, data->payload, data->payload_size);
+		e->data.payload = e->payload;
+	}
+	e->fn = fn;
+	e->priv = priv;
+	smp_store_release(&q->head, head + 1);
+	atomic64_inc(&svc->rx_stats.deferred);
+	wake_up(&q->wait);
+
+	return true;
+}
+
+static void apr_cb_queue_destroy(struct apr_svc *svc)
+{
+	struct apr_cb_queue *q = svc->cb_queue;
+	struct apr_cb_ovf *o, *tmp;
+
+	if (!q)
+		return;
+
+	WRITE_ONCE(svc->cb_queue, NULL);
+	/* Let an in-flight rx dispatch finish with the queue */
+	synchronize_rcu();
+	/* the thread runs what is still queued before it exits */
+	kthread_stop(q->thread);
+	WARN_ON(q->tail != q->head);
+	list_for_each_entry_safe(o, tmp, &q->ovf, list)
+		kfree(o);
+	kfree(q);
+}
+
+/**
+ * apr_set_cb_mode - Select how callbacks of a service are run.
+ *
+ * @handle: APR service handle
+ * @mode: 0 for inline dispatch from the transport rx context, or
+ *   APR_CB_MODE_DEFERRED optionally with APR_CB_MODE_INLINE_DATA
+ *
+ * In deferred mode packets are copied to a bounded per-service queue
+ * and the callback runs from a dedicated RT thread. Packets that do not
+ * fit the queue are dispatched inline when nothing is queued, otherwise
+ * they are queued behind it. Reset events are always inline.
+ *
+ * Returns 0 on success or error on failure.
+ */
+int apr_set_cb_mode(void *handle, uint32_t mode)
+{
+	struct sched_param param = { .sched_priority = APR_CB_THREAD_PRIO };
+	struct apr_svc *svc = handle;
+	struct apr_cb_queue *q;
+	int rc = 0;
+
+	if (!svc) {
+		pr_err("%s: Invalid handle\n", __func__);
+		return -EINVAL;
+	}
+
+	mutex_lock(&svc->m_lock);
+	if (!(mode & APR_CB_MODE_DEFERRED)) {
+		WRITE_ONCE(svc->cb_mode, mode);
+		apr_cb_queue_destroy(svc);
+		goto done;
+	}
+
+	if (!svc->cb_queue) {
+		q = kzalloc(sizeof(*q), GFP_KERNEL);
+		if (!q) {
+			rc = -ENOMEM;
+			goto done;
+		}
+		q->svc = svc;
+		spin_lock_init(&q->ovf_lock);
+		INIT_LIST_HEAD(&q->ovf);
+		init_waitqueue_head(&q->wait);
+		q->thread = kthread_run(apr_cb_thread, q, "apr_cb_%d_%d",
+					svc->dest_domain, svc->id);
+		if (IS_ERR(q->thread)) {
+			rc = PTR_ERR(q->thread);
+			pr_err("%s: kthread_run failed %d\n", __func__, rc);
+			kfree(q);
+			goto done;
+		}
+		sched_setscheduler(q->thread, SCHED_FIFO, &param);
+		WRITE_ONCE(svc->cb_queue, q);
+	}
+	WRITE_ONCE(svc->cb_mode, mode);
+
+done:
+	mutex_unlock(&svc->m_lock);
+	return rc;
+}
+EXPORT_SYMBOL(apr_set_cb_mode);
+
 void apr_cb_func(void *buf, int len, void *priv)
 {
 	struct apr_client_data data;
-	struct apr_client *apr_client;
 	struct apr_svc *c_svc;
 	struct apr_hdr *hdr;
 	uint16_t hdr_size;
@@ -605,10 +1516,13 @@ void apr_cb_func(void *buf, int len, void *priv)
 	uint16_t ver;
 	uint16_t src;
 	uint16_t svc;
-	uint16_t clnt;
 	int i;
 	int temp_port = 0;
 	uint32_t *ptr;
+	apr_fn fn;
+	void *fn_priv;
+	bool deferred;
+	u64 cb_start;
 
 	pr_debug("APR2: len = %d\n", len);
 	ptr = buf;
@@ -664,32 +1578,10 @@ void apr_cb_func(void *buf, int len, void *priv)
 	}
 
 	svc = hdr->dest_svc;
-	if (hdr->src_domain == APR_DOMAIN_MODEM) {
-		if (svc == APR_SVC_MVS || svc == APR_SVC_MVM ||
-		    svc == APR_SVC_CVS || svc == APR_SVC_CVP ||
-		    svc == APR_SVC_TEST_CLIENT)
-			clnt = APR_CLIENT_VOICE;
-		else {
-			pr_err("APR: Wrong svc :%d\n", svc);
-			return;
-		}
-	} else if (hdr->src_domain == APR_DOMAIN_ADSP) {
-		if (svc == APR_SVC_AFE || svc == APR_SVC_ASM ||
-		    svc == APR_SVC_VSM || svc == APR_SVC_VPM ||
-		    svc == APR_SVC_ADM || svc == APR_SVC_ADSP_CORE ||
-		    svc == APR_SVC_USM ||
-		    svc == APR_SVC_TEST_CLIENT || svc == APR_SVC_ADSP_MVM ||
-		    svc == APR_SVC_ADSP_CVS || svc == APR_SVC_ADSP_CVP ||
-		    svc == APR_SVC_LSM)
-			clnt = APR_CLIENT_AUDIO;
-		else if (svc == APR_SVC_VIDC)
-			clnt = APR_CLIENT_AUDIO;
-		else {
-			pr_err("APR: Wrong svc :%d\n", svc);
-			return;
-		}
-	} else {
-		pr_err("APR: Pkt from wrong source: %d\n", hdr->src_domain);
+	c_svc = READ_ONCE(apr_rx_svc[hdr->src_domain][svc]);
+	if (!c_svc) {
+		pr_err("APR: service %d from domain %d is not registered\n",
+			svc, hdr->src_domain);
 		return;
 	}
 
@@ -697,20 +1589,6 @@ void apr_cb_func(void *buf, int len, void *priv)
 	if (src == APR_DEST_MAX)
 		return;
 
-	pr_debug("src =%d clnt = %d\n", src, clnt);
-	apr_client = &client[src][clnt];
-	for (i = 0; i < APR_SVC_MAX; i++)
-		if (apr_client->svc[i].id == svc) {
-			pr_debug("%d\n", apr_client->svc[i].id);
-			c_svc = &apr_client->svc[i];
-			break;
-		}
-
-	if (i == APR_SVC_MAX) {
-		pr_err("APR: service is not registered\n");
-		return;
-	}
-	pr_debug("svc_idx = %d\n", i);
 	pr_debug("%x %x %x %pK %pK\n", c_svc->id, c_svc->dest_id,
 		 c_svc->client_id, c_svc->fn, c_svc->priv);
 	data.payload_size = hdr->pkt_size - hdr_size;
@@ -744,13 +1622,28 @@ void apr_cb_func(void *buf, int len, void *priv)
 
 	temp_port = ((data.dest_port >> 8) * 8) + (data.dest_port & 0xFF);
 	if (((temp_port >= 0) && (temp_port < APR_MAX_PORTS))
-		&& (c_svc->port_cnt && c_svc->port_fn[temp_port]))
-		c_svc->port_fn[temp_port](&data,
-			c_svc->port_priv[temp_port]);
-	else if (c_svc->fn)
-		c_svc->fn(&data, c_svc->priv);
-	else
+		&& (c_svc->port_cnt && c_svc->port_fn[temp_port])) {
+		fn = c_svc->port_fn[temp_port];
+		fn_priv = c_svc->port_priv[temp_port];
+	} else if (c_svc->fn) {
+		fn = c_svc->fn;
+		fn_priv = c_svc->priv;
+	} else {
 		pr_err("APR: Rxed a packet for NULL callback\n");
+		return;
+	}
+
+	apr_lat_rx(c_svc, &data);
+
+	rcu_read_lock();
+	deferred = apr_cb_defer(c_svc, &data, fn, fn_priv);
+	rcu_read_unlock();
+	if (deferred)
+		return;
+
+	cb_start = ktime_get_ns();
+	fn(&data, fn_priv);
+	apr_rx_stats_update(c_svc, ktime_get_ns() - cb_start, hdr->pkt_size);
 }
 
 int apr_get_svc(const char *svc_name, int domain_id, int *client_id,
@@ -942,6 +1835,11 @@ int apr_deregister(void *handle)
 	}
 
 	if (!svc->svc_cnt) {
+		svc->cb_mode = 0;
+		apr_cb_queue_destroy(svc);
+		if (svc->dest_domain < APR_DOMAIN_MAX && svc->id < APR_SVC_MAX &&
+		    apr_rx_svc[svc->dest_domain][svc->id] == svc)
+			WRITE_ONCE(apr_rx_svc[svc->dest_domain][svc->id], NULL);
 		svc->priv = NULL;
 		svc->id = 0;
 		svc->fn = NULL;
@@ -1113,6 +2011,15 @@ static int __init apr_debug_init(void)
 	debugfs_apr_debug = debugfs_create_file("msm_apr_debug",
 						 S_IFREG | 0444, NULL, NULL,
 						 &apr_debug_ops);
+	debugfs_apr_tx_stats = debugfs_create_file("msm_apr_tx_stats",
+						 S_IFREG | 0644, NULL, NULL,
+						 &apr_tx_stats_ops);
+	debugfs_apr_rx_stats = debugfs_create_file("msm_apr_rx_stats",
+						 S_IFREG | 0644, NULL, NULL,
+						 &apr_rx_stats_ops);
+	debugfs_apr_latency = debugfs_create_file("msm_apr_latency",
+						 S_IFREG | 0644, NULL, NULL,
+						 &apr_latency_ops);
 	return 0;
 }
 #else
@@ -1141,8 +2048,19 @@ static void apr_cleanup(void)
 		}
 	}
 #ifdef CONFIG_DEBUG_FS
+	debugfs_remove(debugfs_apr_latency);
+	debugfs_remove(debugfs_apr_rx_stats);
+	debugfs_remove(debugfs_apr_tx_stats);
 	debugfs_remove(debugfs_apr_debug);
 #endif
+	for (i = 0; i < APR_DEST_MAX; i++) {
+		for (j = 0; j < APR_CLIENT_MAX; j++) {
+			for (k = 0; k < APR_SVC_MAX; k++) {
+				kfree(client[i][j].svc[k].lat);
+				client[i][j].svc[k].lat = NULL;
+			}
+		}
+	}
 }
 
 static int apr_probe(struct platform_device *pdev)
@@ -1165,6 +2083,9 @@ static int apr_probe(struct platform_device *pdev)
 			for (k = 0; k < APR_SVC_MAX; k++) {
 				mutex_init(&client[i][j].svc[k].m_lock);
 				spin_lock_init(&client[i][j].svc[k].w_lock);
+				init_llist_head(&client[i][j].svc[k].tx_queue);
+				client[i][j].svc[k].tx_pending = NULL;
+				atomic_set(&client[i][j].svc[k].tx_busy, 0);
 			}
 		}
 	apr_set_subsys_state();
@@ -1204,7 +2125,13 @@ static int apr_probe(struct platform_device *pdev)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_MSM_QDSP6_APR_LOOPBACK
+	/* No remote processor, the loopback transport is up immediately */
+	if (!apr_tal_init() && !strcmp(subsys_name, "apr_adsp"))
+		apr_adsp_up();
+#else
 	apr_tal_init();
+#endif
 
 	ret = snd_event_client_register(&pdev->dev, &apr_ssr_ops, NULL);
 	if (ret) {
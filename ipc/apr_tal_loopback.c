@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2017-2019 The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Loopback APR transport. Commands written to the channel are answered
+ * locally, emulating the ADSP services closely enough for q6asm, q6adm,
+ * q6afe and q6core to run their command and data paths without a remote
+ * processor. Response latency, jitter and the pace of ASM data buffer
+ * done events are module parameters.
+ */
+
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
+#include <ipc/apr.h>
+#include <ipc/apr_tal.h>
+#include <dsp/apr_audio-v2.h>
+#include <dsp/q6core.h>
+
+enum apr_channel_state {
+	APR_CH_DISCONNECTED,
+	APR_CH_CONNECTED,
+};
+
+#define APR_LB_THREAD_NAME "apr_lb_thread"
+#define APR_LB_RSP_PAYLOAD_MAX 12
+#define APR_LB_SESSION_MAX 256
+
+/* Command to response latency in microseconds */
+static int lb_latency_us = 100;
+module_param(lb_latency_us, int, 0664);
+MODULE_PARM_DESC(lb_latency_us, "Response latency in us");
+
+/* Random extra latency in [0, lb_jitter_us] added to each response */
+static int lb_jitter_us;
+module_param(lb_jitter_us, int, 0664);
+MODULE_PARM_DESC(lb_jitter_us, "Maximum response jitter in us");
+
+/* Minimum spacing of write/read done events within one ASM session */
+static int lb_data_done_us = 5000;
+module_param(lb_data_done_us, int, 0664);
+MODULE_PARM_DESC(lb_data_done_us, "Data buffer done period in us");
+
+struct apr_lb_rsp {
+	struct list_head list;
+	struct apr_svc_ch_dev *apr_ch;
+	u64 due_ns;
+	int len;
+	struct apr_hdr hdr;
+	uint32_t payload[APR_LB_RSP_PAYLOAD_MAX];
+};
+
+static struct apr_svc_ch_dev
+	apr_svc_ch[APR_DL_MAX][APR_DEST_MAX][APR_CLIENT_MAX];
+
+static LIST_HEAD(apr_lb_rsp_list);
+static DEFINE_SPINLOCK(apr_lb_lock);
+static struct task_struct *apr_lb_thread_task;
+static u64 apr_lb_next_data_ns[APR_LB_SESSION_MAX];
+static atomic_t apr_lb_mem_handle = ATOMIC_INIT(0);
+
+static u64 apr_lb_due(struct apr_hdr *cmd, bool data_done)
+{
+	u64 due = ktime_get_ns() + (u64)READ_ONCE(lb_latency_us) *
+		  NSEC_PER_USEC;
+	int jitter = READ_ONCE(lb_jitter_us);
+	u64 *next;
+
+	if (jitter > 0)
+		due += (u64)prandom_u32_max(jitter + 1) * NSEC_PER_USEC;
+
+	if (data_done) {
+		/* Called with apr_lb_lock held */
+		next = &apr_lb_next_data_ns[(cmd->dest_port >> 8) &
+					    (APR_LB_SESSION_MAX - 1)];
+		if (due < *next)
+			due = *next;
+		*next = due + (u64)READ_ONCE(lb_data_done_us) *
+			NSEC_PER_USEC;
+	}
+
+	return due;
+}
+
+static void apr_lb_queue(struct apr_lb_rsp *rsp, bool data_done)
+{
+	struct apr_lb_rsp *pos;
+	unsigned long flags;
+
+	spin_lock_irqsave(&apr_lb_lock, flags);
+	rsp->due_ns = apr_lb_due(&rsp->hdr, data_done);
+	/* Keep the list sorted by due time, most entries go to the tail */
+	list_for_each_entry_reverse(pos, &apr_lb_rsp_list, list) {
+		if (pos->due_ns <= rsp->due_ns)
+			break;
+	}
+	list_add(&rsp->list, &pos->list);
+	spin_unlock_irqrestore(&apr_lb_lock, flags);
+
+	wake_up_process(apr_lb_thread_task);
+}
+
+static int apr_lb_basic_rsp(struct apr_lb_rsp *rsp, struct apr_hdr *cmd,
+			    uint32_t status)
+{
+	rsp->hdr.opcode = APR_BASIC_RSP_RESULT;
+	rsp->payload[0] = cmd->opcode;
+	rsp->payload[1] = status;
+	return 2;
+}
+
+/*
+ * Build the response for a command. Returns the payload size in words
+ * and sets @data_done for ASM data buffer events.
+ */
+static int apr_lb_build_rsp(struct apr_lb_rsp *rsp, struct apr_hdr *cmd,
+			    int len, bool *data_done)
+{
+	uint32_t *payload = (uint32_t *)(cmd + 1);
+	int words = (len - APR_HDR_SIZE) / sizeof(uint32_t);
+
+	*data_done = false;
+	switch (cmd->opcode) {
+	case ADM_CMD_DEVICE_OPEN_V5:
+	case ADM_CMD_DEVICE_OPEN_V6:
+	case ADM_CMD_DEVICE_OPEN_V8:
+		rsp->hdr.opcode = cmd->opcode == ADM_CMD_DEVICE_OPEN_V5 ?
+				  ADM_CMDRSP_DEVICE_OPEN_V5 :
+				  cmd->opcode == ADM_CMD_DEVICE_OPEN_V6 ?
+				  ADM_CMDRSP_DEVICE_OPEN_V6 :
+				  ADM_CMDRSP_DEVICE_OPEN_V8;
+		rsp->payload[0] = 0;
+		/* COPP id, echo the copp index carried in the token */
+		rsp->payload[1] = cmd->token & 0xFF;
+		return 2;
+	case ASM_CMD_SHARED_MEM_MAP_REGIONS:
+	case ADM_CMD_SHARED_MEM_MAP_REGIONS:
+	case AFE_SERVICE_CMD_SHARED_MEM_MAP_REGIONS:
+	case AVCS_CMD_SHARED_MEM_MAP_REGIONS:
+		/* All map responses are the map command opcode + 1 */
+		rsp->hdr.opcode = cmd->opcode + 1;
+		rsp->payload[0] = atomic_inc_return(&apr_lb_mem_handle);
+		return 1;
+	case AVCS_CMD_ADSP_EVENT_GET_STATE:
+		rsp->hdr.opcode = AVCS_CMDRSP_ADSP_EVENT_GET_STATE;
+		rsp->payload[0] = 1;
+		return 1;
+	case AVCS_CMD_GET_FWK_VERSION:
+		return apr_lb_basic_rsp(rsp, cmd, ADSP_EUNSUPPORTED);
+	case ASM_DATA_CMD_WRITE_V2:
+		if (words < 3)
+			break;
+		*data_done = true;
+		rsp->hdr.opcode = ASM_DATA_EVENT_WRITE_DONE_V2;
+		rsp->payload[0] = payload[0];
+		rsp->payload[1] = payload[1];
+		rsp->payload[2] = payload[2];
+		rsp->payload[3] = 0;
+		return 4;
+	case ASM_DATA_CMD_READ_V2:
+		if (words < 5)
+			break;
+		*data_done = true;
+		rsp->hdr.opcode = ASM_DATA_EVENT_READ_DONE_V2;
+		rsp->payload[0] = 0;
+		rsp->payload[1] = payload[0];
+		rsp->payload[2] = payload[1];
+		rsp->payload[3] = payload[2];
+		/* Whole buffer filled with one frame at offset 0 */
+		rsp->payload[4] = payload[3];
+		rsp->payload[5] = 0;
+		rsp->payload[6] = 0;
+		rsp->payload[7] = 0;
+		rsp->payload[8] = 0;
+		rsp->payload[9] = 1;
+		rsp->payload[10] = payload[4];
+		return 11;
+	default:
+		break;
+	}
+
+	return apr_lb_basic_rsp(rsp, cmd, 0);
+}
+
+static int apr_lb_thread(void *data)
+{
+	struct apr_svc_ch_dev *apr_ch;
+	struct apr_lb_rsp *rsp;
+	unsigned long flags;
+	ktime_t due;
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&apr_lb_lock, flags);
+		rsp = list_first_entry_or_null(&apr_lb_rsp_list,
+					       struct apr_lb_rsp, list);
+		if (!rsp) {
+			spin_unlock_irqrestore(&apr_lb_lock, flags);
+			schedule();
+			continue;
+		}
+		if (rsp->due_ns > ktime_get_ns()) {
+			spin_unlock_irqrestore(&apr_lb_lock, flags);
+			due = ns_to_ktime(rsp->due_ns);
+			schedule_hrtimeout(&due, HRTIMER_MODE_ABS);
+			continue;
+		}
+		list_del(&rsp->list);
+		spin_unlock_irqrestore(&apr_lb_lock, flags);
+		__set_current_state(TASK_RUNNING);
+
+		apr_ch = rsp->apr_ch;
+		spin_lock_irqsave(&apr_ch->r_lock, flags);
+		if (apr_ch->func)
+			apr_ch->func(&rsp->hdr, rsp->len, apr_ch->priv);
+		spin_unlock_irqrestore(&apr_ch->r_lock, flags);
+		kfree(rsp);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+/**
+ * apr_tal_write() - Write a message across to the remote processor
+ * @apr_ch: apr channel handle
+ * @data: buffer that needs to be transferred over the channel
+ * @pkt_priv: private data of the packet
+ * @len: length of the buffer
+ *
+ * The packet is consumed locally and its response queued for delivery
+ * after the configured latency.
+ *
+ * Returns len of buffer successfully transferred on success
+ * and an appropriate error value on failure.
+ */
+int apr_tal_write(struct apr_svc_ch_dev *apr_ch, void *data,
+			   struct apr_pkt_priv *pkt_priv, int len)
+{
+	struct apr_hdr *cmd = data;
+	struct apr_lb_rsp *rsp;
+	bool data_done;
+	int words;
+
+	if (!apr_ch || len > APR_MAX_BUF || len < APR_HDR_SIZE ||
+	    apr_ch->channel_state != APR_CH_CONNECTED)
+		return -EINVAL;
+
+	/* May be called with interrupts disabled from the APR tx ring */
+	rsp = kzalloc(sizeof(*rsp), GFP_ATOMIC);
+	if (!rsp)
+		return -ENOMEM;
+
+	rsp->apr_ch = apr_ch;
+	words = apr_lb_build_rsp(rsp, cmd, len, &data_done);
+	rsp->len = APR_HDR_SIZE + words * sizeof(uint32_t);
+	rsp->hdr.hdr_field = APR_HDR_FIELD(APR_MSG_TYPE_CMD_RSP,
+					   APR_HDR_LEN(APR_HDR_SIZE),
+					   APR_PKT_VER);
+	rsp->hdr.pkt_size = rsp->len;
+	rsp->hdr.src_domain = cmd->dest_domain;
+	rsp->hdr.src_svc = cmd->dest_svc;
+	rsp->hdr.src_port = cmd->dest_port;
+	rsp->hdr.dest_domain = cmd->src_domain;
+	rsp->hdr.dest_svc = cmd->src_svc;
+	rsp->hdr.dest_port = cmd->src_port;
+	rsp->hdr.token = cmd->token;
+
+	apr_lb_queue(rsp, data_done);
+
+	return len;
+}
+EXPORT_SYMBOL(apr_tal_write);
+
+/**
+ * apr_tal_rx_intents_config() - Configure glink intents for remote processor
+ * @apr_ch: apr channel handle
+ * @num_of_intents: number of intents
+ * @size: size of the intents
+ *
+ * This api is not needed for loopback. Returns 0 to indicate success
+ */
+int apr_tal_rx_intents_config(struct apr_svc_ch_dev *apr_ch,
+			      int num_of_intents, uint32_t size)
+{
+	pr_debug("%s: NO-OP\n", __func__);
+	return 0;
+}
+EXPORT_SYMBOL(apr_tal_rx_intents_config);
+
+/**
+ * apr_tal_start_rx_rt() - Set RT thread priority for APR RX transfer
+ * @apr_ch: apr channel handle
+ *
+ * This api is not needed for loopback. Returns 0 to indicate success.
+ */
+int apr_tal_start_rx_rt(struct apr_svc_ch_dev *apr_ch)
+{
+	pr_debug("%s: NO-OP\n", __func__);
+	return 0;
+}
+EXPORT_SYMBOL(apr_tal_start_rx_rt);
+
+/**
+ * apr_tal_end_rx_rt() - Remove RT thread priority for APR RX transfer
+ * @apr_ch: apr channel handle
+ *
+ * This api is not needed for loopback. Returns 0 to indicate success
+ */
+int apr_tal_end_rx_rt(struct apr_svc_ch_dev *apr_ch)
+{
+	pr_debug("%s: NO-OP\n", __func__);
+	return 0;
+}
+EXPORT_SYMBOL(apr_tal_end_rx_rt);
+
+/**
+ * apr_tal_open() - Open a transport channel for data transfer
+ * on remote processor.
+ * @clnt: apr client, audio or voice
+ * @dest: destination remote processor for which apr channel is requested for.
+ * @dl: type of data link
+ * @func: callback function to handle data transfer from remote processor
+ * @priv: private data of the client
+ *
+ * Returns apr_svc_ch_dev handle on success and NULL on failure.
+ */
+struct apr_svc_ch_dev *apr_tal_open(uint32_t clnt, uint32_t dest, uint32_t dl,
+				    apr_svc_cb_fn func, void *priv)
+{
+	struct apr_svc_ch_dev *apr_ch = NULL;
+
+	if ((clnt != APR_CLIENT_AUDIO) || (dest >= APR_DEST_MAX) ||
+	    (dl != APR_DL_SMD)) {
+		pr_err("%s: Invalid params, clnt:%d, dest:%d, dl:%d\n",
+		       __func__, clnt, dest, dl);
+		return NULL;
+	}
+	apr_ch = &apr_svc_ch[dl][dest][clnt];
+	mutex_lock(&apr_ch->m_lock);
+	apr_ch->func = func;
+	apr_ch->priv = priv;
+	mutex_unlock(&apr_ch->m_lock);
+
+	return apr_ch;
+}
+EXPORT_SYMBOL(apr_tal_open);
+
+/**
+ * apr_tal_close() - Close transport channel on remote processor.
+ * @apr_ch: apr channel handle
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int apr_tal_close(struct apr_svc_ch_dev *apr_ch)
+{
+	unsigned long flags;
+
+	if (!apr_ch)
+		return -EINVAL;
+
+	mutex_lock(&apr_ch->m_lock);
+	spin_lock_irqsave(&apr_ch->r_lock, flags);
+	apr_ch->func = NULL;
+	apr_ch->priv = NULL;
+	spin_unlock_irqrestore(&apr_ch->r_lock, flags);
+	mutex_unlock(&apr_ch->m_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(apr_tal_close);
+
+/**
+ * apr_tal_init() - Bring up the loopback channels.
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int apr_tal_init(void)
+{
+	int i, j, k;
+	int ret = 0;
+
+	memset(apr_svc_ch, 0, sizeof(apr_svc_ch));
+	for (i = 0; i < APR_DL_MAX; i++) {
+		for (j = 0; j < APR_DEST_MAX; j++) {
+			for (k = 0; k < APR_CLIENT_MAX; k++) {
+				init_waitqueue_head(&apr_svc_ch[i][j][k].wait);
+				spin_lock_init(&apr_svc_ch[i][j][k].w_lock);
+				spin_lock_init(&apr_svc_ch[i][j][k].r_lock);
+				mutex_init(&apr_svc_ch[i][j][k].m_lock);
+			}
+		}
+	}
+
+	apr_lb_thread_task = kthread_run(apr_lb_thread, NULL,
+					 APR_LB_THREAD_NAME);
+	if (IS_ERR(apr_lb_thread_task)) {
+		ret = PTR_ERR(apr_lb_thread_task);
+		pr_err("%s: kthread_run failed %d\n", __func__, ret);
+		apr_lb_thread_task = NULL;
+		return ret;
+	}
+
+	for (i = 0; i < APR_DL_MAX; i++)
+		for (j = 0; j < APR_DEST_MAX; j++)
+			for (k = 0; k < APR_CLIENT_MAX; k++)
+				apr_svc_ch[i][j][k].channel_state =
+							APR_CH_CONNECTED;
+	pr_info("%s: APR loopback transport up\n", __func__);
+
+	return ret;
+}
+EXPORT_SYMBOL(apr_tal_init);
+
+/**
+ * apr_tal_exit() - Stop the loopback channels and drop pending responses.
+ */
+void apr_tal_exit(void)
+{
+	struct apr_lb_rsp *rsp, *tmp;
+
+	if (apr_lb_thread_task) {
+		kthread_stop(apr_lb_thread_task);
+		apr_lb_thread_task = NULL;
+	}
+
+	list_for_each_entry_safe(rsp, tmp, &apr_lb_rsp_list, list) {
+		list_del(&rsp->list);
+		kfree(rsp);
+	}
+}
+EXPORT_SYMBOL(apr_tal_exit);
@@ -922,6 +922,49 @@ done:
 }
 EXPORT_SYMBOL(apr_send_pkt);
 
+/**
+ * apr_send_pkt_batch - Clients call to send several packets
+ * to destination processor in one transport transaction.
+ *
+ * @handle: APR service handle
+ * @bufs: packets to send, in order
+ * @cnt: number of packets in @bufs
+ *
+ * HAB has no multi-packet send, packets go out one by one.
+ *
+ * Returns number of packets sent on success or error if none was sent.
+ */
+int apr_send_pkt_batch(void *handle, uint32_t **bufs, int cnt)
+{
+	int i, rc = 0;
+
+	if (!handle || !bufs || cnt <= 0)
+		return -EINVAL;
+
+	for (i = 0; i < cnt; i++) {
+		rc = apr_send_pkt(handle, bufs[i]);
+		if (rc < 0)
+			break;
+	}
+
+	return i ? i : rc;
+}
+EXPORT_SYMBOL(apr_send_pkt_batch);
+
+/**
+ * apr_set_cb_mode - Select how callbacks of a service are run.
+ *
+ * @handle: APR service handle
+ * @mode: requested callback mode
+ *
+ * Callbacks already run from apr_vm_cb_thread, the mode is ignored.
+ */
+int apr_set_cb_mode(void *handle, uint32_t mode)
+{
+	return 0;
+}
+EXPORT_SYMBOL(apr_set_cb_mode);
+
 /**
  * apr_register - Clients call to register
  * to APR.
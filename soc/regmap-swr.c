@@ -12,6 +12,9 @@
 #include <soc/soundwire.h>
 #include <soc/internal.h>
 
+/* registers handed to swr_batch() at a time from a raw regmap buffer */
+#define REGMAP_SWR_BATCH_MAX	32
+
 
 static int regmap_swr_gather_write(void *context,
 				const void *reg, size_t reg_size,
@@ -55,6 +58,33 @@ static int regmap_swr_gather_write(void *context,
 	return ret;
 }
 
+/*
+ * Streams the raw regmap buffer through swr_batch() in chunks of
+ * commands on the stack. Returns -EOPNOTSUPP without writing anything
+ * if the master cannot batch.
+ */
+static int regmap_swr_raw_batch_write(struct swr_device *swr,
+				      struct regmap *map, const u8 *buf,
+				      size_t num_regs)
+{
+	struct swr_cmd cmds[REGMAP_SWR_BATCH_MAX];
+	size_t i, n;
+	int ret = 0;
+
+	for (i = 0; i < num_regs && !ret; i += n) {
+		for (n = 0; n < REGMAP_SWR_BATCH_MAX && i + n < num_regs; n++) {
+			cmds[n].dev_num = swr->dev_num;
+			cmds[n].read = false;
+			cmds[n].reg_addr = *(u16 *)buf;
+			buf += (map->format.reg_bytes + map->format.pad_bytes);
+			cmds[n].val = *buf;
+			buf += map->format.val_bytes;
+		}
+		ret = swr_batch(swr, cmds, n);
+	}
+	return ret;
+}
+
 static int regmap_swr_raw_multi_reg_write(void *context, const void *data,
 					  size_t count)
 {
@@ -91,6 +121,14 @@ static int regmap_swr_raw_multi_reg_write(void *context, const void *data,
 	}
 	num_regs = count / (addr_bytes + val_bytes + pad_bytes);
 
+	ret = regmap_swr_raw_batch_write(swr, map, data, num_regs);
+	if (ret != -EOPNOTSUPP) {
+		if (ret)
+			dev_err(dev, "%s: multi reg write failed\n", __func__);
+		return ret;
+	}
+	ret = 0;
+
 	reg = kcalloc(num_regs, sizeof(u16), GFP_KERNEL);
 	if (!reg)
 		return -ENOMEM;
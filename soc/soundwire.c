@@ -595,6 +595,33 @@ int swr_bulk_write(struct swr_device *dev, u8 dev_num, void *reg,
 }
 EXPORT_SYMBOL(swr_bulk_write);
 
+/**
+ * swr_batch - issue a batch of soundwire slave register accesses
+ * @dev: pointer to soundwire slave device, selects the master
+ * @cmds: caller owned commands, read entries get their val filled in
+ * @len: number of commands
+ *
+ * This API issues the commands in order through the master of @dev.
+ * Entries may address any slave on that master. Returns -EOPNOTSUPP if
+ * the master or the grouping of @dev does not allow batching, callers
+ * then fall back to swr_bulk_write() or single register accesses.
+ */
+int swr_batch(struct swr_device *dev, struct swr_cmd *cmds, size_t len)
+{
+	struct swr_master *master;
+
+	if (!dev || !dev->master || !cmds)
+		return -EINVAL;
+
+	master = dev->master;
+	/* group writes go to one slave only, see swr_bulk_write() */
+	if (dev->group_id || !master->batch)
+		return -EOPNOTSUPP;
+
+	return master->batch(master, cmds, len);
+}
+EXPORT_SYMBOL(swr_batch);
+
 /**
  * swr_write - write soundwire slave device registers
  * @dev: pointer to soundwire slave device
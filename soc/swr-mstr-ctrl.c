@@ -17,6 +17,8 @@
 #include <linux/gpio.h>
 #include <linux/of_gpio.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/of.h>
 #include <soc/soundwire.h>
 #include <soc/swr-common.h>
@@ -26,6 +28,9 @@
 #include "swrm_registers.h"
 #include "swr-mstr-ctrl.h"
 
+#define CREATE_TRACE_POINTS
+#include "swrm_trace.h"
+
 #define SWR_NUM_PORTS    4 /* TODO - Get this info from DT */
 
 #define SWRM_FRAME_SYNC_SEL    4000 /* 4KHz */
@@ -61,6 +66,28 @@ static int auto_suspend_timer = SWR_AUTO_SUSPEND_DELAY * 1000;
 module_param(auto_suspend_timer, int, 0664);
 MODULE_PARM_DESC(auto_suspend_timer, "timer for auto suspend");
 
+/*
+ * Upper bound in msecs for the auto suspend delay, which grows while the
+ * master keeps being resumed shortly after suspending. Not above
+ * auto_suspend_timer keeps the fixed delay.
+ */
+static int auto_suspend_max;
+module_param(auto_suspend_max, int, 0664);
+MODULE_PARM_DESC(auto_suspend_max, "upper bound for adaptive auto suspend");
+
+/* applied on the next master init, 0 keeps the fixed FIFO delays */
+static bool swrm_fifo_poll = true;
+module_param(swrm_fifo_poll, bool, 0664);
+MODULE_PARM_DESC(swrm_fifo_poll, "pace command FIFO by its status");
+
+/*
+ * Port connects from all slaves within this window are programmed with
+ * a single bank switch, 0 applies each one as it comes.
+ */
+static unsigned int port_cfg_defer_ms;
+module_param(port_cfg_defer_ms, uint, 0664);
+MODULE_PARM_DESC(port_cfg_defer_ms, "window to coalesce port connects");
+
 enum {
 	SWR_NOT_PRESENT, /* Device is detached/not present on the bus */
 	SWR_ATTACHED_OK, /* Device is attached */
@@ -92,6 +119,10 @@ enum {
 
 #define MAX_FIFO_RD_FAIL_RETRY 3
 
+/* command FIFO status poll interval and attempts, about 1ms in total */
+#define SWRM_FIFO_POLL_US	10
+#define SWRM_FIFO_POLL_RETRY	100
+
 static bool swrm_lock_sleep(struct swr_mstr_ctrl *swrm);
 static void swrm_unlock_sleep(struct swr_mstr_ctrl *swrm);
 static u32 swr_master_read(struct swr_mstr_ctrl *swrm, unsigned int reg_addr);
@@ -343,6 +374,152 @@ static const struct file_operations swrm_debug_dump_ops = {
 	.open = swrm_debug_open,
 	.read = swrm_debug_reg_dump,
 };
+
+static ssize_t swrm_port_cfg_read(struct file *file, char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct swr_mstr_ctrl *swrm = file->private_data;
+	char buf[112];
+	int len;
+
+	if (!swrm)
+		return -EINVAL;
+
+	len = scnprintf(buf, sizeof(buf),
+			"transitions %u bank_switches %d coalesced %u last %u failed %u\n",
+			swrm->port_cfg_transitions,
+			atomic_read(&swrm->bank_switch_cnt),
+			swrm->port_cfg_coalesced,
+			swrm->port_cfg_last_switches,
+			swrm->port_cfg_failed);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static ssize_t swrm_port_cfg_write(struct file *file,
+				   const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct swr_mstr_ctrl *swrm = file->private_data;
+
+	if (!swrm)
+		return -EINVAL;
+
+	mutex_lock(&swrm->mlock);
+	swrm->port_cfg_transitions = 0;
+	swrm->port_cfg_coalesced = 0;
+	swrm->port_cfg_last_switches = 0;
+	swrm->port_cfg_failed = 0;
+	atomic_set(&swrm->bank_switch_cnt, 0);
+	mutex_unlock(&swrm->mlock);
+
+	return count;
+}
+
+static const struct file_operations swrm_port_cfg_ops = {
+	.open = swrm_debug_open,
+	.read = swrm_port_cfg_read,
+	.write = swrm_port_cfg_write,
+};
+
+#define SWRM_STATS_BUF_LEN	2048
+
+static int swrm_stats_show_hist(char *buf, int size, const char *name,
+				atomic_t *hist)
+{
+	int i, len;
+
+	len = scnprintf(buf, size, "%s_us", name);
+	for (i = 0; i < SWRM_LAT_BUCKETS - 1; i++)
+		len += scnprintf(buf + len, size - len, " <%d:%d",
+				 32 << i, atomic_read(&hist[i]));
+	len += scnprintf(buf + len, size - len, " >=%d:%d\n", 32 << (i - 1),
+			 atomic_read(&hist[i]));
+	return len;
+}
+
+static ssize_t swrm_stats_read(struct file *file, char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct swr_mstr_ctrl *swrm = file->private_data;
+	struct swrm_dev_stats *dev;
+	ssize_t ret;
+	char *buf;
+	int i, len = 0;
+
+	if (!swrm)
+		return -EINVAL;
+
+	buf = kmalloc(SWRM_STATS_BUF_LEN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	/* only device numbers that saw traffic */
+	for (i = 0; i < SWRM_DEV_STATS_NUM; i++) {
+		dev = &swrm->stats.dev[i];
+		if (!atomic_read(&dev->reads) && !atomic_read(&dev->writes) &&
+		    !atomic_read(&dev->bulk_writes))
+			continue;
+		len += scnprintf(buf + len, SWRM_STATS_BUF_LEN - len,
+				 "dev %d rd %d wr %d bulk_wr %d fifo_retry %d\n",
+				 i, atomic_read(&dev->reads),
+				 atomic_read(&dev->writes),
+				 atomic_read(&dev->bulk_writes),
+				 atomic_read(&dev->fifo_retries));
+	}
+	len += scnprintf(buf + len, SWRM_STATS_BUF_LEN - len,
+			 "wr_fifo_overflow %d rd_fifo_overflow %d bank_switches %d\n",
+			 atomic_read(&swrm->stats.wr_fifo_overflow),
+			 atomic_read(&swrm->stats.rd_fifo_overflow),
+			 atomic_read(&swrm->bank_switch_cnt));
+	len += swrm_stats_show_hist(buf + len, SWRM_STATS_BUF_LEN - len,
+				    "rd", swrm->stats.rd_lat);
+	len += swrm_stats_show_hist(buf + len, SWRM_STATS_BUF_LEN - len,
+				    "wr", swrm->stats.wr_lat);
+	len += scnprintf(buf + len, SWRM_STATS_BUF_LEN - len,
+			 "enum_skips %d auto_suspend_ms %d\n",
+			 atomic_read(&swrm->stats.enum_skips),
+			 swrm->auto_suspend_ms);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+	kfree(buf);
+	return ret;
+}
+
+/* Bank switches stay with swrm_port_cfg, which resets them */
+static ssize_t swrm_stats_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct swr_mstr_ctrl *swrm = file->private_data;
+	struct swrm_dev_stats *dev;
+	int i;
+
+	if (!swrm)
+		return -EINVAL;
+
+	for (i = 0; i < SWRM_DEV_STATS_NUM; i++) {
+		dev = &swrm->stats.dev[i];
+		atomic_set(&dev->reads, 0);
+		atomic_set(&dev->writes, 0);
+		atomic_set(&dev->bulk_writes, 0);
+		atomic_set(&dev->fifo_retries, 0);
+	}
+	atomic_set(&swrm->stats.wr_fifo_overflow, 0);
+	atomic_set(&swrm->stats.rd_fifo_overflow, 0);
+	for (i = 0; i < SWRM_LAT_BUCKETS; i++) {
+		atomic_set(&swrm->stats.rd_lat[i], 0);
+		atomic_set(&swrm->stats.wr_lat[i], 0);
+	}
+	atomic_set(&swrm->stats.enum_skips, 0);
+
+	return count;
+}
+
+static const struct file_operations swrm_stats_ops = {
+	.open = swrm_debug_open,
+	.read = swrm_stats_read,
+	.write = swrm_stats_write,
+};
 #endif
 
 static void swrm_reg_dump(struct swr_mstr_ctrl *swrm,
@@ -604,6 +781,76 @@ static void swr_master_write(struct swr_mstr_ctrl *swrm, u16 reg_addr, u32 val)
 		swrm_ahb_write(swrm, reg_addr, &val);
 }
 
+static u32 swrm_wr_fifo_cnt(struct swr_mstr_ctrl *swrm)
+{
+	return (swr_master_read(swrm, SWRM_CMD_FIFO_STATUS) &
+		SWRM_CMD_FIFO_STATUS_WR_CMD_FIFO_CNT_MASK) >>
+		SWRM_CMD_FIFO_STATUS_WR_CMD_FIFO_CNT_SHFT;
+}
+
+/*
+ * Makes room for one write command, reading the FIFO status only once
+ * the entries known to be free are used up. Called with iolock held,
+ * returns false if the FIFO stayed full and the caller has to fall
+ * back to a fixed delay.
+ */
+static bool swrm_wait_for_wr_fifo_avail(struct swr_mstr_ctrl *swrm)
+{
+	int retry = SWRM_FIFO_POLL_RETRY;
+	u32 cnt;
+
+	while (!swrm->wr_fifo_credit) {
+		cnt = swrm_wr_fifo_cnt(swrm);
+		if (cnt < swrm->wr_fifo_depth) {
+			swrm->wr_fifo_credit = swrm->wr_fifo_depth - cnt;
+			break;
+		}
+		if (!--retry) {
+			dev_err_ratelimited(swrm->dev,
+				"%s: write FIFO stuck full\n", __func__);
+			return false;
+		}
+		usleep_range(SWRM_FIFO_POLL_US, SWRM_FIFO_POLL_US + 5);
+	}
+	swrm->wr_fifo_credit--;
+	return true;
+}
+
+/* Waits for queued write commands to go out, called with iolock held */
+static bool swrm_wait_for_wr_fifo_done(struct swr_mstr_ctrl *swrm)
+{
+	int retry = SWRM_FIFO_POLL_RETRY;
+
+	if (swrm->wr_fifo_credit == swrm->wr_fifo_depth)
+		return true;
+
+	while (swrm_wr_fifo_cnt(swrm)) {
+		if (!--retry) {
+			dev_err_ratelimited(swrm->dev,
+				"%s: write FIFO not drained\n", __func__);
+			swrm->wr_fifo_credit = 0;
+			return false;
+		}
+		usleep_range(SWRM_FIFO_POLL_US, SWRM_FIFO_POLL_US + 5);
+	}
+	swrm->wr_fifo_credit = swrm->wr_fifo_depth;
+	return true;
+}
+
+/* Waits for read data to land in the read FIFO, called with iolock held */
+static bool swrm_wait_for_rd_fifo_data(struct swr_mstr_ctrl *swrm)
+{
+	int retry = SWRM_FIFO_POLL_RETRY;
+
+	while (!(swr_master_read(swrm, SWRM_CMD_FIFO_STATUS) &
+		 SWRM_CMD_FIFO_STATUS_RD_FIFO_CNT_MASK)) {
+		if (!--retry)
+			return false;
+		usleep_range(SWRM_FIFO_POLL_US, SWRM_FIFO_POLL_US + 5);
+	}
+	return true;
+}
+
 static int swr_master_bulk_write(struct swr_mstr_ctrl *swrm, u32 *reg_addr,
 				u32 *val, unsigned int length)
 {
@@ -611,7 +858,16 @@ static int swr_master_bulk_write(struct swr_mstr_ctrl *swrm, u32 *reg_addr,
 
 	if (swrm->bulk_write)
 		swrm->bulk_write(swrm->handle, reg_addr, val, length);
-	else {
+	else if (swrm->fifo_poll) {
+		mutex_lock(&swrm->iolock);
+		for (i = 0; i < length; i++) {
+			if (reg_addr[i] == SWRM_CMD_FIFO_WR_CMD &&
+			    !swrm_wait_for_wr_fifo_avail(swrm))
+				usleep_range(50, 55);
+			swr_master_write(swrm, reg_addr[i], val[i]);
+		}
+		mutex_unlock(&swrm->iolock);
+	} else {
 		mutex_lock(&swrm->iolock);
 		for (i = 0; i < length; i++) {
 		/* wait for FIFO WR command to complete to avoid overflow */
@@ -751,9 +1007,18 @@ static int swrm_cmd_fifo_rd_cmd(struct swr_mstr_ctrl *swrm, int *cmd_data,
 
 	mutex_lock(&swrm->iolock);
 	val = swrm_get_packed_reg_val(&swrm->rcmd_id, len, dev_addr, reg_addr);
+	atomic_inc(&swrm->stats.dev[dev_addr & 0xF].reads);
+	trace_swrm_cmd_issue(swrm->master_id, dev_addr, reg_addr, 0, true);
 	if (swrm->read) {
 		/* skip delay if read is handled in platform driver */
 		swr_master_write(swrm, SWRM_CMD_FIFO_RD_CMD, val);
+	} else if (swrm->fifo_poll) {
+		/* earlier writes may target the register being read */
+		if (!swrm_wait_for_wr_fifo_done(swrm))
+			usleep_range(100, 105);
+		swr_master_write(swrm, SWRM_CMD_FIFO_RD_CMD, val);
+		if (!swrm_wait_for_rd_fifo_data(swrm))
+			usleep_range(250, 255);
 	} else {
 		/* wait for FIFO RD to complete to avoid overflow */
 		usleep_range(100, 105);
@@ -775,6 +1040,7 @@ retry_read:
 				swr_master_write(swrm, SWRM_CMD_FIFO_RD_CMD, val);
 			}
 			retry_attempt++;
+			atomic_inc(&swrm->stats.dev[dev_addr & 0xF].fifo_retries);
 			goto retry_read;
 		} else {
 			dev_err_ratelimited(swrm->dev, "%s: reg: 0x%x, cmd_id: 0x%x, \
@@ -786,6 +1052,8 @@ retry_read:
 				"%s: failed to read fifo\n", __func__);
 		}
 	}
+	trace_swrm_cmd_done(swrm->master_id, dev_addr, reg_addr,
+			    *cmd_data & 0xFF, true, retry_attempt);
 	mutex_unlock(&swrm->iolock);
 
 	return 0;
@@ -807,13 +1075,22 @@ static int swrm_cmd_fifo_wr_cmd(struct swr_mstr_ctrl *swrm, u8 cmd_data,
 	dev_dbg(swrm->dev, "%s: reg: 0x%x, cmd_id: 0x%x,wcmd_id: 0x%x, \
 			dev_num: 0x%x, cmd_data: 0x%x\n", __func__,
 			reg_addr, cmd_id, swrm->wcmd_id,dev_addr, cmd_data);
-	swr_master_write(swrm, SWRM_CMD_FIFO_WR_CMD, val);
-	/*
-	 * wait for FIFO WR command to complete to avoid overflow
-	 * skip delay if write is handled in platform driver.
-	 */
-	if(!swrm->write)
-		usleep_range(150, 155);
+	atomic_inc(&swrm->stats.dev[dev_addr & 0xF].writes);
+	trace_swrm_cmd_issue(swrm->master_id, dev_addr, reg_addr, cmd_data,
+			     false);
+	if (!swrm->write && swrm->fifo_poll) {
+		if (!swrm_wait_for_wr_fifo_avail(swrm))
+			usleep_range(150, 155);
+		swr_master_write(swrm, SWRM_CMD_FIFO_WR_CMD, val);
+	} else {
+		swr_master_write(swrm, SWRM_CMD_FIFO_WR_CMD, val);
+		/*
+		 * wait for FIFO WR command to complete to avoid overflow
+		 * skip delay if write is handled in platform driver.
+		 */
+		if (!swrm->write)
+			usleep_range(150, 155);
+	}
 	if (cmd_id == 0xF) {
 		/*
 		 * sleep for 10ms for MSM soundwire variant to allow broadcast
@@ -825,10 +1102,24 @@ static int swrm_cmd_fifo_wr_cmd(struct swr_mstr_ctrl *swrm, u8 cmd_data,
 			wait_for_completion_timeout(&swrm->broadcast,
 						    (2 * HZ/10));
 	}
+	if (cmd_id == 0xF || (!swrm->write && !swrm->fifo_poll))
+		trace_swrm_cmd_done(swrm->master_id, dev_addr, reg_addr,
+				    cmd_data, false, 0);
 	mutex_unlock(&swrm->iolock);
 	return ret;
 }
 
+static void swrm_lat_record(atomic_t *hist, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = 0;
+
+	/* bucket 0 is below 32us, each next one doubles */
+	if (us >= 32)
+		bucket = min_t(int, ilog2(us) - 4, SWRM_LAT_BUCKETS - 1);
+	atomic_inc(&hist[bucket]);
+}
+
 static int swrm_read(struct swr_master *master, u8 dev_num, u16 reg_addr,
 		     void *buf, u32 len)
 {
@@ -836,6 +1127,7 @@ static int swrm_read(struct swr_master *master, u8 dev_num, u16 reg_addr,
 	int ret = 0;
 	int val;
 	u8 *reg_val = (u8 *)buf;
+	ktime_t start;
 
 	if (!swrm) {
 		dev_err(&master->dev, "%s: swrm is NULL\n", __func__);
@@ -852,6 +1144,7 @@ static int swrm_read(struct swr_master *master, u8 dev_num, u16 reg_addr,
 	}
 	mutex_unlock(&swrm->devlock);
 
+	start = ktime_get();
 	pm_runtime_get_sync(swrm->dev);
 	ret = swrm_cmd_fifo_rd_cmd(swrm, &val, dev_num, 0, reg_addr, len);
 
@@ -860,6 +1153,7 @@ static int swrm_read(struct swr_master *master, u8 dev_num, u16 reg_addr,
 
 	pm_runtime_put_autosuspend(swrm->dev);
 	pm_runtime_mark_last_busy(swrm->dev);
+	swrm_lat_record(swrm->stats.rd_lat, start);
 	return ret;
 }
 
@@ -869,6 +1163,7 @@ static int swrm_write(struct swr_master *master, u8 dev_num, u16 reg_addr,
 	struct swr_mstr_ctrl *swrm = swr_get_ctrl_data(master);
 	int ret = 0;
 	u8 reg_val = *(u8 *)buf;
+	ktime_t start;
 
 	if (!swrm) {
 		dev_err(&master->dev, "%s: swrm is NULL\n", __func__);
@@ -885,22 +1180,31 @@ static int swrm_write(struct swr_master *master, u8 dev_num, u16 reg_addr,
 	}
 	mutex_unlock(&swrm->devlock);
 
+	start = ktime_get();
 	pm_runtime_get_sync(swrm->dev);
 	ret = swrm_cmd_fifo_wr_cmd(swrm, reg_val, dev_num, 0, reg_addr);
 
 	pm_runtime_put_autosuspend(swrm->dev);
 	pm_runtime_mark_last_busy(swrm->dev);
+	swrm_lat_record(swrm->stats.wr_lat, start);
 	return ret;
 }
 
+/* Sends the staged write commands, called with batch_lock held */
+static int swrm_batch_flush(struct swr_mstr_ctrl *swrm, int len)
+{
+	if (!len)
+		return 0;
+	return swr_master_bulk_write(swrm, swrm->batch_reg, swrm->batch_val,
+				     len);
+}
+
 static int swrm_bulk_write(struct swr_master *master, u8 dev_num, void *reg,
 			   const void *buf, size_t len)
 {
 	struct swr_mstr_ctrl *swrm = swr_get_ctrl_data(master);
 	int ret = 0;
-	int i;
-	u32 *val;
-	u32 *swr_fifo_reg;
+	int i, n = 0;
 
 	if (!swrm || !swrm->handle) {
 		dev_err(&master->dev, "%s: swrm is NULL\n", __func__);
@@ -908,6 +1212,12 @@ static int swrm_bulk_write(struct swr_master *master, u8 dev_num, void *reg,
 	}
 	if (len <= 0)
 		return -EINVAL;
+	if (!dev_num) {
+		dev_err(&master->dev,
+			"%s: No support of Bulk write for master regs\n",
+			__func__);
+		return -EINVAL;
+	}
 	mutex_lock(&swrm->devlock);
 	if (!swrm->dev_up) {
 		mutex_unlock(&swrm->devlock);
@@ -915,43 +1225,103 @@ static int swrm_bulk_write(struct swr_master *master, u8 dev_num, void *reg,
 	}
 	mutex_unlock(&swrm->devlock);
 
+	atomic_add(len, &swrm->stats.dev[dev_num & 0xF].bulk_writes);
 	pm_runtime_get_sync(swrm->dev);
-	if (dev_num) {
-		swr_fifo_reg = kcalloc(len, sizeof(u32), GFP_KERNEL);
-		if (!swr_fifo_reg) {
-			ret = -ENOMEM;
-			goto err;
-		}
-		val = kcalloc(len, sizeof(u32), GFP_KERNEL);
-		if (!val) {
-			ret = -ENOMEM;
-			goto mem_fail;
+	mutex_lock(&swrm->batch_lock);
+	for (i = 0; i < len; i++) {
+		swrm->batch_val[n] = swrm_get_packed_reg_val(&swrm->wcmd_id,
+							     ((u8 *)buf)[i],
+							     dev_num,
+							     ((u16 *)reg)[i]);
+		swrm->batch_reg[n++] = SWRM_CMD_FIFO_WR_CMD;
+		trace_swrm_cmd_issue(swrm->master_id, dev_num,
+				     ((u16 *)reg)[i], ((u8 *)buf)[i], false);
+		if (n == SWRM_BATCH_MAX) {
+			ret = swrm_batch_flush(swrm, n);
+			n = 0;
+			if (ret)
+				break;
 		}
+	}
+	if (!ret)
+		ret = swrm_batch_flush(swrm, n);
+	mutex_unlock(&swrm->batch_lock);
+	if (ret) {
+		dev_err(&master->dev, "%s: bulk write failed\n", __func__);
+		ret = -EINVAL;
+	}
 
-		for (i = 0; i < len; i++) {
-			val[i] = swrm_get_packed_reg_val(&swrm->wcmd_id,
-							 ((u8 *)buf)[i],
-							 dev_num,
-							 ((u16 *)reg)[i]);
-			swr_fifo_reg[i] = SWRM_CMD_FIFO_WR_CMD;
-		}
-		ret = swr_master_bulk_write(swrm, swr_fifo_reg, val, len);
-		if (ret) {
-			dev_err(&master->dev, "%s: bulk write failed\n",
+	pm_runtime_put_autosuspend(swrm->dev);
+	pm_runtime_mark_last_busy(swrm->dev);
+	return ret;
+}
+
+/*
+ * Issues cmds in order. Runs of writes are staged and streamed through
+ * swr_master_bulk_write(), a read first flushes the writes staged
+ * before it.
+ */
+static int swrm_batch(struct swr_master *master, struct swr_cmd *cmds,
+		      size_t len)
+{
+	struct swr_mstr_ctrl *swrm = swr_get_ctrl_data(master);
+	int ret = 0;
+	int i, n = 0;
+	int val;
+
+	if (!swrm || !swrm->handle) {
+		dev_err(&master->dev, "%s: swrm is NULL\n", __func__);
+		return -EINVAL;
+	}
+	if (!len)
+		return 0;
+	mutex_lock(&swrm->devlock);
+	if (!swrm->dev_up) {
+		mutex_unlock(&swrm->devlock);
+		return 0;
+	}
+	mutex_unlock(&swrm->devlock);
+
+	pm_runtime_get_sync(swrm->dev);
+	mutex_lock(&swrm->batch_lock);
+	for (i = 0; i < len; i++) {
+		if (!cmds[i].dev_num) {
+			dev_err(&master->dev, "%s: invalid slave dev num\n",
 				__func__);
 			ret = -EINVAL;
+			break;
+		}
+		if (cmds[i].read) {
+			ret = swrm_batch_flush(swrm, n);
+			n = 0;
+			if (ret)
+				break;
+			ret = swrm_cmd_fifo_rd_cmd(swrm, &val, cmds[i].dev_num,
+						   0, cmds[i].reg_addr, 1);
+			if (ret)
+				break;
+			cmds[i].val = (u8)val;
+			continue;
+		}
+		swrm->batch_val[n] = swrm_get_packed_reg_val(&swrm->wcmd_id,
+							     cmds[i].val,
+							     cmds[i].dev_num,
+							     cmds[i].reg_addr);
+		swrm->batch_reg[n++] = SWRM_CMD_FIFO_WR_CMD;
+		atomic_inc(&swrm->stats.dev[cmds[i].dev_num & 0xF].bulk_writes);
+		trace_swrm_cmd_issue(swrm->master_id, cmds[i].dev_num,
+				     cmds[i].reg_addr, cmds[i].val, false);
+		if (n == SWRM_BATCH_MAX) {
+			ret = swrm_batch_flush(swrm, n);
+			n = 0;
+			if (ret)
+				break;
 		}
-	} else {
-		dev_err(&master->dev,
-			"%s: No support of Bulk write for master regs\n",
-			__func__);
-		ret = -EINVAL;
-		goto err;
 	}
-	kfree(val);
-mem_fail:
-	kfree(swr_fifo_reg);
-err:
+	if (!ret)
+		ret = swrm_batch_flush(swrm, n);
+	mutex_unlock(&swrm->batch_lock);
+
 	pm_runtime_put_autosuspend(swrm->dev);
 	pm_runtime_mark_last_busy(swrm->dev);
 	return ret;
@@ -966,6 +1336,7 @@ static u8 get_inactive_bank_num(struct swr_mstr_ctrl *swrm)
 static void enable_bank_switch(struct swr_mstr_ctrl *swrm, u8 bank,
 				u8 row, u8 col)
 {
+	atomic_inc(&swrm->bank_switch_cnt);
 	swrm_cmd_fifo_wr_cmd(swrm, ((row << 3) | col), 0xF, 0xF,
 			SWRS_SCP_FRAME_CTRL_BANK(bank));
 }
@@ -1348,7 +1719,8 @@ static void swrm_apply_port_config(struct swr_master *master)
 	swrm_copy_data_port_config(master, bank);
 }
 
-static int swrm_slvdev_datapath_control(struct swr_master *master, bool enable)
+static int __swrm_slvdev_datapath_control(struct swr_master *master,
+					  bool enable)
 {
 	u8 bank;
 	u32 value = 0, n_row = 0, n_col = 0;
@@ -1363,6 +1735,7 @@ static int swrm_slvdev_datapath_control(struct swr_master *master, bool enable)
 		    SWRM_MCP_FRAME_CTRL_BANK_SSP_PERIOD_BMSK);
 	u8 inactive_bank;
 	int frame_sync = SWRM_FRAME_SYNC_SEL;
+	int switches;
 
 	if (!swrm) {
 		pr_err("%s: swrm is null\n", __func__);
@@ -1370,6 +1743,7 @@ static int swrm_slvdev_datapath_control(struct swr_master *master, bool enable)
 	}
 
 	mutex_lock(&swrm->mlock);
+	switches = atomic_read(&swrm->bank_switch_cnt);
 
 	/*
 	 * During disable if master is already down, which implies an ssr/pdr
@@ -1480,6 +1854,9 @@ static int swrm_slvdev_datapath_control(struct swr_master *master, bool enable)
 		swrm_disable_ports(master, inactive_bank);
 		swrm_cleanup_disabled_port_reqs(master);
 	}
+	swrm->port_cfg_transitions++;
+	swrm->port_cfg_last_switches =
+		atomic_read(&swrm->bank_switch_cnt) - switches;
 	if (!swrm_is_port_en(master)) {
 		dev_dbg(&master->dev, "%s: pm_runtime auto suspend triggered\n",
 			__func__);
@@ -1491,6 +1868,68 @@ exit:
 return 0;
 }
 
+/*
+ * Applies a deferred datapath enable. The slave was already told it
+ * succeeded, so a failure here can only be logged and counted.
+ */
+static int swrm_port_cfg_apply(struct swr_mstr_ctrl *swrm)
+{
+	int ret;
+
+	ret = __swrm_slvdev_datapath_control(&swrm->master, true);
+	if (ret) {
+		dev_err(swrm->dev, "%s: deferred port enable failed %d\n",
+			__func__, ret);
+		mutex_lock(&swrm->mlock);
+		swrm->port_cfg_failed++;
+		mutex_unlock(&swrm->mlock);
+	}
+	return ret;
+}
+
+static void swrm_port_cfg_work_fn(struct work_struct *work)
+{
+	struct swr_mstr_ctrl *swrm = container_of(work, struct swr_mstr_ctrl,
+						  port_cfg_work.work);
+
+	swrm_port_cfg_apply(swrm);
+}
+
+/*
+ * With port_cfg_defer_ms set, a datapath enable only arms the port
+ * config work, so connects from other slaves in the window ride on the
+ * same bank switch. Anything else first applies a pending enable to
+ * keep the order slaves asked for.
+ */
+static int swrm_slvdev_datapath_control(struct swr_master *master, bool enable)
+{
+	struct swr_mstr_ctrl *swrm = swr_get_ctrl_data(master);
+	unsigned int ms = READ_ONCE(port_cfg_defer_ms);
+
+	if (!swrm) {
+		pr_err("%s: swrm is null\n", __func__);
+		return -EFAULT;
+	}
+
+	if (enable && ms) {
+		mutex_lock(&swrm->mlock);
+		if (swrm->state != SWR_MSTR_SSR &&
+		    test_bit(ENABLE_PENDING, &swrm->port_req_pending)) {
+			if (!schedule_delayed_work(&swrm->port_cfg_work,
+						   msecs_to_jiffies(ms)))
+				swrm->port_cfg_coalesced++;
+			mutex_unlock(&swrm->mlock);
+			return 0;
+		}
+		mutex_unlock(&swrm->mlock);
+	}
+
+	if (cancel_delayed_work_sync(&swrm->port_cfg_work))
+		swrm_port_cfg_apply(swrm);
+
+	return __swrm_slvdev_datapath_control(master, enable);
+}
+
 static int swrm_connect_port(struct swr_master *master,
 			struct swr_params *portinfo)
 {
@@ -1823,12 +2262,14 @@ handle_irq:
 			break;
 		case SWRM_INTERRUPT_STATUS_RD_FIFO_OVERFLOW:
 			dev_dbg(swrm->dev, "SWR read FIFO overflow\n");
+			atomic_inc(&swrm->stats.rd_fifo_overflow);
 			break;
 		case SWRM_INTERRUPT_STATUS_RD_FIFO_UNDERFLOW:
 			dev_dbg(swrm->dev, "SWR read FIFO underflow\n");
 			break;
 		case SWRM_INTERRUPT_STATUS_WR_CMD_FIFO_OVERFLOW:
 			dev_dbg(swrm->dev, "SWR write FIFO overflow\n");
+			atomic_inc(&swrm->stats.wr_fifo_overflow);
 			break;
 		case SWRM_INTERRUPT_STATUS_CMD_ERROR:
 			value = swr_master_read(swrm, SWRM_CMD_FIFO_STATUS);
@@ -2033,6 +2474,7 @@ handle_irq:
 		case SWRM_INTERRUPT_STATUS_RD_FIFO_OVERFLOW:
 			dev_dbg(swrm->dev, "%s: SWR read FIFO overflow\n",
 				__func__);
+			atomic_inc(&swrm->stats.rd_fifo_overflow);
 			break;
 		case SWRM_INTERRUPT_STATUS_RD_FIFO_UNDERFLOW:
 			dev_dbg(swrm->dev, "%s: SWR read FIFO underflow\n",
@@ -2041,6 +2483,7 @@ handle_irq:
 		case SWRM_INTERRUPT_STATUS_WR_CMD_FIFO_OVERFLOW:
 			dev_dbg(swrm->dev, "%s: SWR write FIFO overflow\n",
 				__func__);
+			atomic_inc(&swrm->stats.wr_fifo_overflow);
 			swr_master_write(swrm, SWRM_CMD_FIFO_CMD, 0x1);
 			break;
 		case SWRM_INTERRUPT_STATUS_CMD_ERROR:
@@ -2225,6 +2668,41 @@ static int swrm_get_device_status(struct swr_mstr_ctrl *swrm, u8 devnum)
 	return val;
 }
 
+/*
+ * Enumeration keeps a device at its logical number across clock stop and
+ * usually across reset, so check the number it had last time before
+ * scanning all of them.
+ */
+static int swrm_check_enum_id(struct swr_mstr_ctrl *swrm, u64 dev_id,
+			      u32 num_dev, u8 *dev_num)
+{
+	struct swr_device *swr_dev;
+	u32 status;
+	u64 id;
+	int i;
+
+	for (i = 1; i < (num_dev + 1); i++)
+		if (swrm->enum_id[i] == dev_id)
+			break;
+	if (i > num_dev)
+		return -ENOENT;
+
+	id = ((u64)(swr_master_read(swrm,
+		    SWRM_ENUMERATOR_SLAVE_DEV_ID_2(i))) << 32);
+	id |= swr_master_read(swrm, SWRM_ENUMERATOR_SLAVE_DEV_ID_1(i));
+	if ((id & SWR_DEV_ID_MASK) != dev_id)
+		return -EAGAIN;
+	status = swrm_get_device_status(swrm, i);
+	if ((status != 0x01) && (status != 0x02))
+		return -EAGAIN;
+
+	list_for_each_entry(swr_dev, &swrm->master.devices, dev_list)
+		if (swr_dev->addr == dev_id)
+			swr_dev->dev_num = i;
+	*dev_num = i;
+	return 0;
+}
+
 static int swrm_get_logical_dev_num(struct swr_master *mstr, u64 dev_id,
 				u8 *dev_num)
 {
@@ -2251,13 +2729,21 @@ static int swrm_get_logical_dev_num(struct swr_master *mstr, u64 dev_id,
 		return ret;
 	}
 	mutex_unlock(&swrm->devlock);
+	if (num_dev > SWRM_NUM_AUTO_ENUM_SLAVES)
+		num_dev = SWRM_NUM_AUTO_ENUM_SLAVES;
 
 	pm_runtime_get_sync(swrm->dev);
+	if (!swrm_check_enum_id(swrm, dev_id, num_dev, dev_num)) {
+		atomic_inc(&swrm->stats.enum_skips);
+		ret = 0;
+		goto done;
+	}
 	for (i = 1; i < (num_dev + 1); i++) {
 		id = ((u64)(swr_master_read(swrm,
 			    SWRM_ENUMERATOR_SLAVE_DEV_ID_2(i))) << 32);
 		id |= swr_master_read(swrm,
 					SWRM_ENUMERATOR_SLAVE_DEV_ID_1(i));
+		swrm->enum_id[i] = id & SWR_DEV_ID_MASK;
 
 		/*
 		 * As pm_runtime_get_sync() brings all slaves out of reset
@@ -2284,6 +2770,7 @@ static int swrm_get_logical_dev_num(struct swr_master *mstr, u64 dev_id,
 		dev_err(swrm->dev, "%s: device 0x%llx is not ready\n",
 			__func__, dev_id);
 
+done:
 	pm_runtime_mark_last_busy(swrm->dev);
 	pm_runtime_put_autosuspend(swrm->dev);
 	return ret;
@@ -2351,6 +2838,22 @@ static int swrm_master_init(struct swr_mstr_ctrl *swrm)
 					SWRM_COL_02, SWRM_FRAME_SYNC_SEL);
 	dev_dbg(swrm->dev, "%s: ssp_period: %d\n", __func__, ssp_period);
 
+	/*
+	 * MSM variant and older masters keep the fixed delays around
+	 * command FIFO accesses.
+	 */
+	mutex_lock(&swrm->iolock);
+	swrm->wr_fifo_depth = (swr_master_read(swrm, SWRM_COMP_PARAMS) &
+			       SWRM_COMP_PARAMS_WR_FIFO_DEPTH) >>
+			       SWRM_COMP_PARAMS_WR_FIFO_DEPTH_SHFT;
+	swrm->wr_fifo_credit = 0;
+	swrm->fifo_poll = swrm_fifo_poll && swrm->wr_fifo_depth &&
+			  !swrm_is_msm_variant(swrm->version) &&
+			  swrm->version >= SWRM_VERSION_1_5;
+	mutex_unlock(&swrm->iolock);
+	dev_dbg(swrm->dev, "%s: wr fifo depth %d, fifo poll %d\n", __func__,
+		swrm->wr_fifo_depth, swrm->fifo_poll);
+
 	/* Clear Rows and Cols */
 	val = ((row_ctrl << SWRM_MCP_FRAME_CTRL_BANK_ROW_CTRL_SHFT) |
 		(col_ctrl << SWRM_MCP_FRAME_CTRL_BANK_COL_CTRL_SHFT) |
@@ -2627,6 +3130,7 @@ static int swrm_probe(struct platform_device *pdev)
 	swrm->master.read = swrm_read;
 	swrm->master.write = swrm_write;
 	swrm->master.bulk_write = swrm_bulk_write;
+	swrm->master.batch = swrm_batch;
 	swrm->master.get_logical_dev_num = swrm_get_logical_dev_num;
 	swrm->master.connect_port = swrm_connect_port;
 	swrm->master.disconnect_port = swrm_disconnect_port;
@@ -2661,6 +3165,7 @@ static int swrm_probe(struct platform_device *pdev)
 	mutex_init(&swrm->clklock);
 	mutex_init(&swrm->devlock);
 	mutex_init(&swrm->pm_lock);
+	mutex_init(&swrm->batch_lock);
 	swrm->wlock_holders = 0;
 	swrm->pm_state = SWRM_PM_SLEEPABLE;
 	init_waitqueue_head(&swrm->pm_wq);
@@ -2759,6 +3264,7 @@ static int swrm_probe(struct platform_device *pdev)
 
 	mutex_unlock(&swrm->mlock);
 	INIT_WORK(&swrm->wakeup_work, swrm_wakeup_work);
+	INIT_DELAYED_WORK(&swrm->port_cfg_work, swrm_port_cfg_work_fn);
 
 	if (pdev->dev.of_node)
 		of_register_swr_devices(&swrm->master);
@@ -2778,6 +3284,16 @@ static int swrm_probe(struct platform_device *pdev)
 				   S_IFREG | 0444, swrm->debugfs_swrm_dent,
 				   (void *) swrm,
 				   &swrm_debug_dump_ops);
+
+		swrm->debugfs_port_cfg = debugfs_create_file("swrm_port_cfg",
+				   S_IFREG | 0644, swrm->debugfs_swrm_dent,
+				   (void *) swrm,
+				   &swrm_port_cfg_ops);
+
+		swrm->debugfs_stats = debugfs_create_file("swrm_stats",
+				   S_IFREG | 0644, swrm->debugfs_swrm_dent,
+				   (void *) swrm,
+				   &swrm_stats_ops);
 	}
 #endif
 	ret = device_init_wakeup(swrm->dev, true);
@@ -2786,6 +3302,7 @@ static int swrm_probe(struct platform_device *pdev)
 		goto err_irq_wakeup_fail;
 	}
 
+	swrm->auto_suspend_ms = auto_suspend_timer;
 	pm_runtime_set_autosuspend_delay(&pdev->dev, auto_suspend_timer);
 	pm_runtime_use_autosuspend(&pdev->dev);
 	pm_runtime_set_active(&pdev->dev);
@@ -2815,6 +3332,7 @@ err_irq_fail:
 	mutex_destroy(&swrm->iolock);
 	mutex_destroy(&swrm->clklock);
 	mutex_destroy(&swrm->pm_lock);
+	mutex_destroy(&swrm->batch_lock);
 	pm_qos_remove_request(&swrm->pm_qos_req);
 
 err_pdata_fail:
@@ -2836,6 +3354,7 @@ static int swrm_remove(struct platform_device *pdev)
 	if (swrm->swr_irq_wakeup_capable)
 		irq_set_irq_wake(swrm->irq, 0);
 	cancel_work_sync(&swrm->wakeup_work);
+	cancel_delayed_work_sync(&swrm->port_cfg_work);
 	pm_runtime_disable(&pdev->dev);
 	pm_runtime_set_suspended(&pdev->dev);
 	swr_unregister_master(&swrm->master);
@@ -2848,6 +3367,7 @@ static int swrm_remove(struct platform_device *pdev)
 	mutex_destroy(&swrm->clklock);
 	mutex_destroy(&swrm->force_down_lock);
 	mutex_destroy(&swrm->pm_lock);
+	mutex_destroy(&swrm->batch_lock);
 	pm_qos_remove_request(&swrm->pm_qos_req);
 	devm_kfree(&pdev->dev, swrm);
 	return 0;
@@ -2867,6 +3387,37 @@ static int swrm_clk_pause(struct swr_mstr_ctrl *swrm)
 }
 
 #ifdef CONFIG_PM
+static int swrm_auto_suspend_delay(struct swr_mstr_ctrl *swrm)
+{
+	if (auto_suspend_max <= auto_suspend_timer)
+		return auto_suspend_timer;
+	return clamp(swrm->auto_suspend_ms, auto_suspend_timer,
+		     auto_suspend_max);
+}
+
+/*
+ * Back in use after less idle time than the delay itself: twice the
+ * delay would have covered the whole gap and saved this resume. Longer
+ * idle periods decay it back towards auto_suspend_timer.
+ */
+static void swrm_adapt_auto_suspend(struct swr_mstr_ctrl *swrm)
+{
+	int delay = swrm_auto_suspend_delay(swrm);
+	s64 gap;
+
+	if (auto_suspend_max <= auto_suspend_timer)
+		return;
+
+	gap = ktime_ms_delta(ktime_get(), swrm->suspend_ts);
+	if (gap < delay)
+		delay = min(delay * 2, auto_suspend_max);
+	else
+		delay = max(delay - delay / 4, auto_suspend_timer);
+	swrm->auto_suspend_ms = delay;
+	dev_dbg(swrm->dev, "%s: idle %lld ms, auto suspend %d ms\n",
+		__func__, gap, delay);
+}
+
 static int swrm_runtime_resume(struct device *dev)
 {
 	struct platform_device *pdev = to_platform_device(dev);
@@ -2896,6 +3447,8 @@ static int swrm_runtime_resume(struct device *dev)
 
 	if ((swrm->state == SWR_MSTR_DOWN) ||
 	    (swrm->state == SWR_MSTR_SSR && swrm->dev_up)) {
+		if (swrm->state == SWR_MSTR_DOWN)
+			swrm_adapt_auto_suspend(swrm);
 		if (swrm->clk_stop_mode0_supp) {
 			if (swrm->wake_irq > 0) {
 				if (unlikely(!irq_get_irq_data
@@ -2989,7 +3542,7 @@ exit:
 				ERR_AUTO_SUSPEND_TIMER_VAL);
 	else
 		pm_runtime_set_autosuspend_delay(&pdev->dev,
-				auto_suspend_timer);
+				swrm_auto_suspend_delay(swrm));
 	mutex_unlock(&swrm->reslock);
 
 	trace_printk("%s: pm_runtime: resume done, state:%d\n",
@@ -3117,8 +3670,10 @@ static int swrm_runtime_suspend(struct device *dev)
 
 	}
 	/* Retain  SSR state until resume */
-	if (current_state != SWR_MSTR_SSR)
+	if (current_state != SWR_MSTR_SSR) {
 		swrm->state = SWR_MSTR_DOWN;
+		swrm->suspend_ts = ktime_get();
+	}
 exit:
 	if (!swrm->aud_core_err)
 		swrm_request_hw_vote(swrm, LPASS_AUDIO_CORE, false);
@@ -3458,6 +4013,11 @@ int swrm_wcd_notify(struct platform_device *pdev, u32 id, void *data)
 					SWR_WAKE_IRQ_DEREGISTER, (void *)swrm);
 		swrm->dmic_sva = 0;
 		break;
+	case SWR_PORT_CFG_COMMIT:
+		/* apply port connects held back by port_cfg_defer_ms now */
+		if (cancel_delayed_work_sync(&swrm->port_cfg_work))
+			ret = swrm_port_cfg_apply(swrm);
+		break;
 	case SWR_SET_PORT_MAP:
 		if (!data) {
 			dev_err(swrm->dev, "%s: data is NULL for id=%d\n",
@@ -45,6 +45,9 @@
 
 #define SWRM_NUM_AUTO_ENUM_SLAVES    6
 
+/* FIFO commands staged per swr_master_bulk_write() of a batch */
+#define SWRM_BATCH_MAX	64
+
 enum {
 	SWR_MSTR_PAUSE,
 	SWR_MSTR_RESUME,
@@ -94,6 +97,30 @@ struct swrm_mports {
 	u32 ch_rate;
 };
 
+/* slave device numbers are 4 bits, 0xF being broadcast */
+#define SWRM_DEV_STATS_NUM	16
+/* log2 latency buckets from below 32us to 2ms and above */
+#define SWRM_LAT_BUCKETS	8
+
+/* register traffic to one slave device number */
+struct swrm_dev_stats {
+	atomic_t reads;
+	atomic_t writes;
+	atomic_t bulk_writes;
+	atomic_t fifo_retries;
+};
+
+struct swrm_stats {
+	struct swrm_dev_stats dev[SWRM_DEV_STATS_NUM];
+	atomic_t wr_fifo_overflow;
+	atomic_t rd_fifo_overflow;
+	/* swrm_read() and swrm_write() latency, pm resume included */
+	atomic_t rd_lat[SWRM_LAT_BUCKETS];
+	atomic_t wr_lat[SWRM_LAT_BUCKETS];
+	/* slave number lookups served by the enumeration cache */
+	atomic_t enum_skips;
+};
+
 struct swrm_port_type {
 	u8 port_type;
 	u8 ch_mask;
@@ -127,11 +154,20 @@ struct swr_mstr_ctrl {
 	struct mutex reslock;
 	struct mutex pm_lock;
 	struct mutex irq_lock;
+	/* guards batch_reg and batch_val */
+	struct mutex batch_lock;
+	u32 batch_reg[SWRM_BATCH_MAX];
+	u32 batch_val[SWRM_BATCH_MAX];
 	u32 swrm_base_reg;
 	char __iomem *swrm_dig_base;
 	char __iomem *swrm_hctl_reg;
 	u8 rcmd_id;
 	u8 wcmd_id;
+	/* pace the command FIFO by its status instead of fixed delays */
+	bool fifo_poll;
+	u8 wr_fifo_depth;
+	/* free write FIFO entries known without reading the status */
+	u8 wr_fifo_credit;
 	u32 master_id;
 	void *handle; /* SWR Master handle from client for read and writes */
 	int (*read)(void *handle, int reg);
@@ -152,6 +188,20 @@ struct swr_mstr_ctrl {
 	struct swrm_mports mport_cfg[SWR_MAX_MSTR_PORT_NUM];
 	struct list_head port_req_list;
 	unsigned long port_req_pending;
+	/* applies port connects collected over port_cfg_defer_ms */
+	struct delayed_work port_cfg_work;
+	struct swrm_stats stats;
+	atomic_t bank_switch_cnt;
+	/* device id last seen at each logical device number */
+	u64 enum_id[SWRM_NUM_AUTO_ENUM_SLAVES + 1];
+	ktime_t suspend_ts;
+	int auto_suspend_ms;
+	u32 port_cfg_transitions;
+	u32 port_cfg_coalesced;
+	/* bank switches done by the last port config transition */
+	u32 port_cfg_last_switches;
+	/* deferred port enables that failed after the slave was told 0 */
+	u32 port_cfg_failed;
 	int state;
 	struct platform_device *pdev;
 	int num_rx_chs;
@@ -190,6 +240,8 @@ struct swr_mstr_ctrl {
 	struct dentry *debugfs_peek;
 	struct dentry *debugfs_poke;
 	struct dentry *debugfs_reg_dump;
+	struct dentry *debugfs_port_cfg;
+	struct dentry *debugfs_stats;
 	unsigned int read_data;
 #endif
 };
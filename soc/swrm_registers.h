@@ -23,7 +23,9 @@
 #define SWRM_COMP_PARAMS_DOUT_PORTS_MASK	0x0000001F
 #define SWRM_COMP_PARAMS_DIN_PORTS_MASK		0x000003E0
 #define SWRM_COMP_PARAMS_WR_FIFO_DEPTH		0x00007C00
+#define SWRM_COMP_PARAMS_WR_FIFO_DEPTH_SHFT	10
 #define SWRM_COMP_PARAMS_RD_FIFO_DEPTH		0x000F8000
+#define SWRM_COMP_PARAMS_RD_FIFO_DEPTH_SHFT	15
 #define SWRM_COMP_PARAMS_AUTO_ENUM_SLAVES	0x00F00000
 #define SWRM_COMP_PARAMS_DATA_LANES		0x07000000
 
@@ -125,6 +127,9 @@
 #define SWRM_CMD_FIFO_STATUS		(SWRM_BASE_ADDRESS + 0x0000030C)
 
 #define SWRM_CMD_FIFO_STATUS_WR_CMD_FIFO_CNT_MASK	0x1F00
+#define SWRM_CMD_FIFO_STATUS_WR_CMD_FIFO_CNT_SHFT	0x8
+#define SWRM_CMD_FIFO_STATUS_RD_FIFO_CNT_MASK		0x1F0000
+#define SWRM_CMD_FIFO_STATUS_RD_FIFO_CNT_SHFT		0x10
 #define SWRM_CMD_FIFO_STATUS_RD_CMD_FIFO_CNT_MASK	0x7C00000
 
 #define SWRM_CMD_FIFO_CFG_ADDR			(SWRM_BASE_ADDRESS+0x00000314)
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM swrm
+
+#if !defined(_SWRM_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SWRM_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Slave register command through the master command FIFO. @master is
+ * the master id, @dev the slave device number (0xF for broadcast).
+ */
+TRACE_EVENT(swrm_cmd_issue,
+
+	TP_PROTO(u32 master, u8 dev, u16 reg, u8 val, bool read),
+
+	TP_ARGS(master, dev, reg, val, read),
+
+	TP_STRUCT__entry(
+		__field(u32, master)
+		__field(u8, dev)
+		__field(u16, reg)
+		__field(u8, val)
+		__field(bool, read)
+	),
+
+	TP_fast_assign(
+		__entry->master = master;
+		__entry->dev = dev;
+		__entry->reg = reg;
+		__entry->val = val;
+		__entry->read = read;
+	),
+
+	TP_printk("master=%u dev=%u %s reg=0x%x val=0x%x",
+		  __entry->master, __entry->dev,
+		  __entry->read ? "rd" : "wr", __entry->reg, __entry->val)
+);
+
+/*
+ * Completion of a command the driver waits for: a read returning data,
+ * or a write followed by a fixed delay or a broadcast completion.
+ * Writes paced by FIFO status complete on the bus without an event.
+ */
+TRACE_EVENT(swrm_cmd_done,
+
+	TP_PROTO(u32 master, u8 dev, u16 reg, u8 val, bool read,
+		 u32 retries),
+
+	TP_ARGS(master, dev, reg, val, read, retries),
+
+	TP_STRUCT__entry(
+		__field(u32, master)
+		__field(u8, dev)
+		__field(u16, reg)
+		__field(u8, val)
+		__field(bool, read)
+		__field(u32, retries)
+	),
+
+	TP_fast_assign(
+		__entry->master = master;
+		__entry->dev = dev;
+		__entry->reg = reg;
+		__entry->val = val;
+		__entry->read = read;
+		__entry->retries = retries;
+	),
+
+	TP_printk("master=%u dev=%u %s reg=0x%x val=0x%x retries=%u",
+		  __entry->master, __entry->dev,
+		  __entry->read ? "rd" : "wr", __entry->reg, __entry->val,
+		  __entry->retries)
+);
+
+#endif /* _SWRM_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE swrm_trace
+
+#include <trace/define_trace.h>